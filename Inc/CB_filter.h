@@ -0,0 +1,32 @@
+/*
+ * CB_filter.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef CB_FILTER_H_
+#define CB_FILTER_H_
+
+#include "Space_Packet_Protocol.h"
+
+#define CB_FILTER_N_CHANNELS        2
+#define CB_FILTER_MAX_TAPS          16 // Even, taps are processed in pairs
+#define CB_FILTER_MAX_DECIMATION    64
+
+typedef enum {
+    CB_FILTER_NONE      = 0, // Every sample passes through
+    CB_FILTER_BOXCAR    = 1, // Mean of every R samples
+    CB_FILTER_FIR       = 2, // FIR evaluated on every R-th sample
+} CB_Filter_Mode_t;
+
+typedef struct {
+    uint16_t seq;                           // FPGA sequence number of the last input sample
+    uint16_t value[CB_FILTER_N_CHANNELS];
+} CB_sample_t;
+
+void CB_filter_reset();
+bool CB_filter_push(CB_sample_t* in, CB_sample_t* out);
+uint8_t CB_filter_decimation();
+SPP_error set_CB_filter(uint8_t N_args, uint8_t* data);
+
+#endif /* CB_FILTER_H_ */
@@ -0,0 +1,38 @@
+/*
+ * CB_trigger.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef CB_TRIGGER_H_
+#define CB_TRIGGER_H_
+
+#include "CB_filter.h"
+
+#define CB_TRIG_MAX_PRE             256 // Pre-trigger ring depth in samples
+#define CB_TRIG_DEF_PRE             64
+#define CB_TRIG_DEF_POST            64
+
+// Trigger conditions, any combination can be enabled. 0 disables the trigger engine.
+#define CB_TRIG_THRESHOLD           0x01 // Selected probe crosses the level, in either direction
+#define CB_TRIG_SLOPE               0x02 // Selected probe changes by at least the slope level between two samples
+#define CB_TRIG_DIFF                0x04 // |probe 0 - probe 1| rises to the differential level
+
+/*  CB event packet data field:
+ *  | event ID (2) | trigger conditions (1) | trigger sample sequence number (2) |
+ *  | trigger sample time (8) | N samples (1) | N x [sequence number (2) | probe 0 (2) | probe 1 (2)] |
+ *  An event is sent as consecutive packets with the same event ID, pre-trigger samples first.
+ *  The trigger sample time is the on-board time in us, see SC_frame_time_us().
+ */
+#define CB_EVENT_HEADER_LEN         14
+#define CB_EVENT_SAMPLE_LEN         6
+#define CB_EVENT_MAX_SAMPLES        36
+
+extern uint32_t CB_trigger_events;
+
+void CB_trigger_reset();
+void CB_trigger_push(CB_sample_t* sample);
+void CB_trigger_flush();
+SPP_error set_CB_trigger(uint8_t N_args, uint8_t* data);
+
+#endif /* CB_TRIGGER_H_ */
@@ -1,32 +1,88 @@
+#ifndef __FPGA_DATA_SAVING_H
+#define __FPGA_DATA_SAVING_H
+
 #include "main.h"
 #include <fatfs.h>
 #include <stdio.h>
 #include <string.h>
+#include "data_block.h"
 
+// Staging pool between the FMC DMA and the SD card, filled FPGA_BUFFER_SIZE bytes per transfer
 #define SD_BUFFERS 6
 #define SD_BUFFER_SIZE 65536
 #define FPGA_BUFFER_SIZE 2048
-#define WRITE_QUEUE_MAX_SIZE SD_BUFFERS
-#define BUFFERS_BEFORE_FLUSH 1
+#define TRANSFERS_BEFORE_SWITCH (SD_BUFFER_SIZE / FPGA_BUFFER_SIZE)
+#define SD_BUFFER_SECTORS (SD_BUFFER_SIZE / _MAX_SS)
+
+// Each staging buffer is preceded by its block header sector and both are written together
+#define SD_BLOCK_LEN (DBLK_HEADER_LEN + SD_BUFFER_SIZE)
+#define SD_BLOCK_SECTORS (SD_BLOCK_LEN / _MAX_SS)
+
+// Interval between f_sync of a file written through f_write. Blocks written since the last
+// sync lie beyond the recorded file size, so a power loss costs at most this much data.
+#define SD_SYNC_INTERVAL 1000 // ms
+// Fast capture blocks are inside the preallocated file as soon as they are written, only the
+// index is synced, so a power loss costs nothing that the block scan cannot rebuild.
+#define SD_FAST_SYNC_INTERVAL 120000 // ms
+
+// Fast capture: the data file is preallocated as one contiguous cluster block with f_expand and
+// buffers are written straight to its sectors with multi-block writes, bypassing FatFs. The FAT
+// and directory entry are only touched when the file is opened and when it is closed.
+#define FAST_CAPTURE_FILE_SIZE (256UL * 1024 * 1024)
+
+// Number of staging buffers written by the SD benchmark
+#define SD_BENCH_BUFFERS 32
+// Run the fast capture benchmark once at boot and log the result on the debug link. Only runs
+// when the volume was mounted during boot, otherwise use the sdbench console command.
+#define SD_BOOT_BENCHMARK 0
+
+// Write error recovery: the card is reinitialised every SD_RECOVERY_INTERVAL until it answers,
+// a buffer is given up after SD_WRITE_MAX_ATTEMPTS failed writes on a card that came back.
+#define SD_WRITER_RUNNING 0
+#define SD_WRITER_REINIT 1
+#define SD_WRITER_REOPEN 2
+#define SD_RECOVERY_INTERVAL 500 // ms
+#define SD_WRITE_MAX_ATTEMPTS 3
+
+// The FPGA is paused when no more than SD_BACKPRESSURE_ON staging buffers are free and resumed
+// once at least SD_BACKPRESSURE_OFF are free again. The buffer being filled is not counted.
+#define SD_BACKPRESSURE_ON 1
+#define SD_BACKPRESSURE_OFF (SD_BUFFERS / 2)
+
+// One slot is kept empty to tell a full queue from an empty one, the buffer being filled
+// is never in the queue, so every other buffer of the pool can be waiting for the SD card.
+#define WRITE_QUEUE_LEN SD_BUFFERS
+
+#if SD_BUFFERS < 2 || SD_BUFFERS > 255
+#error "SD_BUFFERS must be between 2 and 255"
+#endif
+#if SD_BACKPRESSURE_OFF <= SD_BACKPRESSURE_ON || SD_BACKPRESSURE_OFF > SD_BUFFERS - 1
+#error "SD_BACKPRESSURE_OFF must be above SD_BACKPRESSURE_ON and below SD_BUFFERS"
+#endif
+#if FPGA_BUFFER_SIZE % 32 != 0
+#error "FPGA_BUFFER_SIZE must be a multiple of the 32 byte cache line"
+#endif
+#if SD_BUFFER_SIZE % FPGA_BUFFER_SIZE != 0
+#error "SD_BUFFER_SIZE must be a multiple of FPGA_BUFFER_SIZE"
+#endif
 
 extern SRAM_HandleTypeDef hsram1;
 
-extern uint8_t TRANSFERS_BEFORE_SWITCH;
-extern uint8_t SD_buffer_1[SD_BUFFER_SIZE];
-extern uint8_t SD_buffer_2[SD_BUFFER_SIZE];
-extern uint8_t SD_buffer_3[SD_BUFFER_SIZE];
-extern uint8_t SD_buffer_4[SD_BUFFER_SIZE];
-extern uint8_t SD_buffer_5[SD_BUFFER_SIZE];
-extern uint8_t SD_buffer_6[SD_BUFFER_SIZE];
+// Filled buffer handed from the DMA complete interrupt to the writer task
+typedef struct {
+	uint8_t buffer;			// Index in the pool
+	uint64_t timeUs;		// On-board time at which the buffer was completed
+} SD_write_desc_t;
+
 extern uint8_t SD_buffer_selection;
-extern uint8_t SD_buffer_counter;
-extern uint8_t bufferToWrite;
-extern uint32_t fileWrites;
+extern uint16_t SD_buffer_counter;
 
-extern uint8_t writeQueue[WRITE_QUEUE_MAX_SIZE];
-extern uint8_t writeQueueSize;
-extern int8_t writeQueueFirst;
-extern int8_t writeQueueLast;
+extern uint32_t writeQueueOverflows;
+extern uint8_t writeQueueHighWater;
+extern uint8_t FPGAWriterState;
+extern uint8_t FPGABackpressure;
+extern uint32_t FPGAWriteErrors;
+extern uint8_t FPGAFastCapture;
 
 extern uint16_t currentDataRate;
 
@@ -34,10 +90,18 @@ extern FIL FPGADataFile;
 extern uint8_t FPGAFileOpen;
 
 FRESULT openFPGADataFile();
+FRESULT closeFPGADataFile();
 void FPGADMATransferCplt();
 void FPGAStartDMATransfer();
-uint8_t writeBuffer(uint8_t bufferNumber);
-void writeQueueEnqueue(uint8_t bufferno);
-uint8_t writeQueueDequeue(void);
-uint8_t writeQueuePeek(void);
+uint8_t* SD_buffer(uint8_t bufferNumber);
+uint8_t* SD_block(uint8_t bufferNumber);
+uint8_t writeBuffer(SD_write_desc_t* desc);
+uint8_t writeQueueEnqueue(uint8_t bufferno);
+uint8_t writeQueuePeek(SD_write_desc_t* desc);
+void writeQueueRelease(void);
+uint8_t writeQueueCount(void);
+uint32_t FPGALostBytes(void);
 void HandleFPGAStream();
+FRESULT SD_benchmark(uint8_t fast, uint32_t* totalUs, uint32_t* worstUs);
+
+#endif
@@ -6,6 +6,8 @@
 #include "FRAM.h"
 #include "GS_Telemetry.h"
 #include "uC_Data_Saving.h"
+#include "sd_stats.h"
+#include "storage_manager.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -28,6 +30,7 @@
 #define FPGA_MESSAGE_GYRO 0x47
 #define FPGA_MESSAGE_MOTOR_SPEED 0x4D
 #define FPGA_MESSAGE_TELEMETRY 0xA4
+#define FPGA_MESSAGE_FLOW_CONTROL 0x58	// To the FPGA, payload 1 pauses and 0 resumes data streaming
 #define CONSOLE_MAX_CMD_SIZE 256
 
 #define STATE_BOOT 1
@@ -63,7 +66,7 @@ extern float vbat;
 void FPGA_RX_CpltCallback();
 void FPGA_Transmit_DMA(const char* tx_string);
 void FPGA_Transmit(const char* tx_string);
-void FPGA_Transmit_Binary(uint8_t* tx_data, size_t length);
+HAL_StatusTypeDef FPGA_Transmit_Binary(uint8_t* tx_data, size_t length);
 void FPGA_Transmit_Binary_DMA(uint8_t* tx_data, size_t length);
 void HandleFPGAMessage();
 void HandleConsole();
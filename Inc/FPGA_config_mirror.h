@@ -0,0 +1,31 @@
+/*
+ * FPGA_config_mirror.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef FPGA_CONFIG_MIRROR_H_
+#define FPGA_CONFIG_MIRROR_H_
+
+#include "langmuir_probe_bias.h"
+
+#define FPGA_MIRROR_N_PROBES        2
+#define FPGA_MIRROR_N_SWT_STEPS     256
+
+// Period of the background refresh. One scalar register is read back per period, a bulk
+// refresh of the CB voltages and sweep tables reads one register per main loop pass.
+#define FPGA_MIRROR_REFRESH_INTV    2000 // ms
+
+extern bool     FPGA_mirror_verify;
+extern uint32_t FPGA_mirror_mismatch_cnt;
+
+void FPGA_mirror_store(uint8_t reg, FPGA_msg_arg_t* fpgama, uint16_t value);
+void FPGA_mirror_store_set(uint8_t reg, FPGA_msg_arg_t* fpgama);
+bool FPGA_mirror_lookup(uint8_t reg, FPGA_msg_arg_t* fpgama, uint16_t* value);
+bool FPGA_mirror_compare(uint8_t reg, FPGA_msg_arg_t* fpgama, uint16_t FPGA_value);
+void FPGA_mirror_invalidate();
+void FPGA_mirror_request_refresh();
+void FPGA_mirror_stop_refresh();
+bool FPGA_mirror_next_refresh(uint8_t* func_id, FPGA_msg_arg_t* fpgama);
+
+#endif /* FPGA_CONFIG_MIRROR_H_ */
@@ -8,6 +8,17 @@
 #define FRAM_GS_ID_UC 0x0005
 #define FRAM_VHF_TIME_SLOT 0x0006
 
+#define FRAM_CMD_SEQ_SECTION_START 0x0100
+#define FRAM_CMD_SEQ_SIZE   256 // bytes
+#define FRAM_CMD_SEQ_COUNT  8
+
+#define FRAM_SCHEDULE_SECTION_START 0x0900
+#define FRAM_SCHEDULE_SECTION_SIZE  0x0500 // bytes
+
+// Next data file number of each storage series: | number (4) | inverted number (4) |
+#define FRAM_FILE_NO_SECTION_START  0x0E00
+#define FRAM_FILE_NO_SIZE           8 // bytes
+
 #define FRAM_SWEEP_TABLE_SECTION_START 0x0FC0
 #define FRAM_SWEEP_TABLE_FOOTER_SIZE    8 // bytes
 #define FRAM_SWEEP_TABLE_SIZE   512 + FRAM_SWEEP_TABLE_FOOTER_SIZE  // bytes
@@ -0,0 +1,64 @@
+/*
+ * IV_analysis.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef IV_ANALYSIS_H_
+#define IV_ANALYSIS_H_
+
+#include "Space_Packet_Protocol.h"
+
+#define IV_PARAM_APID               0x2AE
+#define IV_MAX_POINTS               256
+
+/*  Default calibration, the nominal values of the probe front end design. A flight unit
+ *  built with measured values defines these on the compiler command line.
+ *  Bias:    the 16-bit bias DAC spans -10 V to +10 V, mid scale is 0 V.
+ *  Current: the transimpedance stage and 16-bit ADC resolve 0.1 nA per LSB, mid scale is
+ *           0 A, so the range is about +-3.3 uA.
+ *  Area:    collecting area of the spherical probe.
+ */
+#ifndef IV_DEFAULT_BIAS_OFFSET_LSB
+#define IV_DEFAULT_BIAS_OFFSET_LSB      32768
+#endif
+#ifndef IV_DEFAULT_BIAS_V_PER_LSB
+#define IV_DEFAULT_BIAS_V_PER_LSB       (20.0f / 65536.0f)
+#endif
+#ifndef IV_DEFAULT_CURRENT_OFFSET_LSB
+#define IV_DEFAULT_CURRENT_OFFSET_LSB   32768
+#endif
+#ifndef IV_DEFAULT_CURRENT_A_PER_LSB
+#define IV_DEFAULT_CURRENT_A_PER_LSB    1.0e-10f
+#endif
+#ifndef IV_DEFAULT_PROBE_AREA_M2
+#define IV_DEFAULT_PROBE_AREA_M2        2.0e-4f
+#endif
+
+// Fit settings
+#define IV_ION_FIT_FRACTION         0.25f   // Lowest part of the bias range used for the ion saturation fit
+#define IV_MIN_FIT_POINTS           3
+
+#define IV_ION_MASS_KG              (16.0f * 1.66054e-27f) // O+
+#define IV_ELEMENTARY_CHARGE        1.602177e-19f
+
+// Status flags, one bit per parameter that could not be derived.
+#define IV_STATUS_NO_VF             0x01
+#define IV_STATUS_NO_ION_FIT        0x02
+#define IV_STATUS_NO_TE             0x04
+#define IV_STATUS_NO_NE             0x08
+
+typedef struct {
+    float    V_f;       // Floating potential [V]
+    float    V_p;       // Plasma potential estimate (knee of the I-V curve) [V]
+    float    I_is;      // Ion saturation current at V_f [A]
+    float    T_e;       // Electron temperature [eV]
+    float    n_e;       // Electron density [m^-3]
+    uint8_t  status;
+    uint32_t cycles;    // CPU cycles spent in the analysis
+} IV_result_t;
+
+uint8_t analyze_IV_curve(const uint16_t* bias, const uint16_t* current, uint16_t N, IV_result_t* result);
+void send_IV_parameters(uint16_t sweep_seq, uint8_t probe_ID, IV_result_t* result);
+
+#endif /* IV_ANALYSIS_H_ */
@@ -76,6 +76,7 @@ typedef enum {
     SPP_PUS8_ERROR                          = -7,
     SPP_PUS17_ERROR                         = -8,
     SPP_MISSING_PUS_HEADER                  = -9,
+    SPP_PUS11_ERROR                         = -10,
     UNDEFINED_ERROR                         = -127,
 } SPP_error;
 
@@ -83,6 +84,7 @@ typedef enum {
     REQUEST_VERIFICATION_SERVICE_ID      = 1,
     HOUSEKEEPING_SERVICE_ID              = 3,
     FUNCTION_MANAGEMNET_ID               = 8,
+    TIME_BASED_SCHEDULING_ID             = 11,
     TEST_SERVICE_ID                      = 17,
 } PUS_Service_ID;
 
@@ -119,6 +121,24 @@ typedef enum {
 } PUS_FM_Subtype_ID;
 
 
+// Time-based Scheduling [11] subtype IDs
+// Release times in the TCs and reports are uint32 on-board time in ms since boot (see
+// on_board_time.h), not an absolute time. The summary report carries the current on-board time.
+typedef enum {
+    TBS_ENABLE                             = 1,  // TC
+    TBS_DISABLE                            = 2,  // TC
+    TBS_RESET                              = 3,  // TC
+    TBS_INSERT_ACTIVITIES                  = 4,  // TC
+    TBS_DELETE_ACTIVITIES                  = 5,  // TC
+    TBS_TIME_SHIFT_ACTIVITIES              = 7,  // TC
+    TBS_DETAIL_REPORT                      = 10, // TM (response to 16)
+    TBS_SUMMARY_REPORT                     = 13, // TM (response to 17)
+    TBS_TIME_SHIFT_ALL                     = 15, // TC
+    TBS_DETAIL_REPORT_ALL                  = 16, // TC
+    TBS_SUMMARY_REPORT_ALL                 = 17, // TC
+} PUS_TBS_Subtype_ID;
+
+
 // Test (Ping) service [17] subtype IDS
 typedef enum {
     T_ARE_YOU_ALIVE_TEST_ID              = 1, // TC
@@ -167,6 +187,7 @@ SPP_error SPP_decode_header(uint8_t* raw_header, SPP_header_t* primary_header);
 SPP_error SPP_validate_checksum(uint8_t* packet, uint16_t packet_length);
 
 SPP_error SPP_handle_incoming_TC(SPP_TC_source);
+SPP_error SPP_process_TC_packet(uint8_t* packet_buffer);
 void SPP_Callback();
 
 SPP_header_t SPP_make_header(uint8_t packet_version_number, uint8_t packet_type, uint8_t secondary_header_flag, uint16_t application_process_id, uint8_t sequence_flags, uint16_t packet_sequence_count, uint16_t packet_data_length);
@@ -208,6 +229,11 @@ void SPP_periodic_HK_send();
 /* PUS_8_service */
 SPP_error SPP_handle_FM_TC(SPP_header_t* SPP_header , PUS_TC_header_t* secondary_header, uint8_t* data);
 
+/* PUS_11_service */
+SPP_error SPP_handle_TBS_TC(SPP_header_t* SPP_header, PUS_TC_header_t* secondary_header, uint8_t* data);
+void SPP_init_TBS_schedule();
+void SPP_execute_scheduled_TCs();
+
 /* PUS_17_service */
 SPP_error SPP_handle_TEST_TC(SPP_header_t* req_SPP_header, PUS_TC_header_t* req_PUS_header);
 
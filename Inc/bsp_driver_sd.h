@@ -53,6 +53,18 @@
 #define SD_NOT_PRESENT           ((uint8_t)0x00)
 #define SD_DATATIMEOUT           ((uint32_t)100000000)
 
+/**
+  * @brief  SD bus speed levels, from SDMMCCLK = 48 MHz
+  */
+#define   BSP_SD_SPEED_SAFE             ((uint8_t)0x00)   /* Default speed mode, SDMMC_CK = 12 MHz        */
+#define   BSP_SD_SPEED_DEFAULT          ((uint8_t)0x01)   /* Default speed mode, SDMMC_CK = 24 MHz        */
+#define   BSP_SD_SPEED_HIGH             ((uint8_t)0x02)   /* High speed mode (CMD6), clock bypass, 48 MHz */
+
+#define   BSP_SD_SAFE_CLOCK_DIV         ((uint32_t)2U)    /* SDMMC_CK = SDMMCCLK / (ClockDiv + 2)         */
+#define   BSP_SD_TEST_BLOCKS            ((uint32_t)4U)    /* Blocks read back to verify each speed step   */
+#define   BSP_SD_TEST_TIMEOUT           ((uint32_t)100U)  /* ms                                           */
+#define   BSP_SD_ERRORS_BEFORE_FALLBACK ((uint8_t)3U)     /* Consecutive CRC/timeout errors               */
+
 #ifdef OLD_API
 /* kept to avoid issue when migrating old projects. */
 /* USER CODE BEGIN 0 */
@@ -72,6 +84,8 @@ uint8_t BSP_SD_Erase(uint32_t StartAddr, uint32_t EndAddr);
 uint8_t BSP_SD_GetCardState(void);
 void    BSP_SD_GetCardInfo(BSP_SD_CardInfo *CardInfo);
 uint8_t BSP_SD_IsDetected(void);
+uint8_t BSP_SD_GetSpeed(void);
+uint32_t BSP_SD_GetFallbacks(void);
 
 /* These functions can be modified in case the current settings (e.g. DMA stream)
    need to be changed for specific application needs */
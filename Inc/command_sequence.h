@@ -0,0 +1,35 @@
+/*
+ * command_sequence.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef COMMAND_SEQUENCE_H_
+#define COMMAND_SEQUENCE_H_
+
+#include "langmuir_probe_bias.h"
+#include "FRAM.h"
+
+/*  Stored FPGA command sequences. Each sequence occupies one FRAM_CMD_SEQ_SIZE slot:
+ *
+ *  | magic (1) | N_cmds (1) | used_len (2) | entries ...                            |
+ *  entry: | delay_ms (2) | cmd_len (1) | func_id (1) | N_args (1) | arguments ... |
+ *
+ *  delay_ms is waited before the command is executed. Executing a sequence only starts it,
+ *  the main loop sends its commands when they are due through cmd_seq_process().
+ */
+#define CMD_SEQ_MAGIC           0xC5
+#define CMD_SEQ_HEADER_LEN      4
+#define CMD_SEQ_ENTRY_HDR_LEN   3
+#define CMD_SEQ_MAX_DATA_LEN    (FRAM_CMD_SEQ_SIZE - CMD_SEQ_HEADER_LEN)
+
+SPP_error cmd_seq_clear(uint8_t seq_id);
+SPP_error cmd_seq_append(uint8_t seq_id, uint16_t delay_ms, uint8_t* cmd, uint8_t cmd_len);
+SPP_error cmd_seq_execute(uint8_t seq_id);
+void cmd_seq_process(uint32_t current_ticks);
+
+SPP_error handle_cmd_seq_clear(uint8_t N_args, uint8_t* data);
+SPP_error handle_cmd_seq_append(uint8_t N_args, uint8_t* data);
+SPP_error handle_cmd_seq_execute(uint8_t N_args, uint8_t* data);
+
+#endif /* COMMAND_SEQUENCE_H_ */
@@ -0,0 +1,101 @@
+/*
+ * data_block.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef DATA_BLOCK_H_
+#define DATA_BLOCK_H_
+
+#include "main.h"
+#include <fatfs.h>
+#include <stdint.h>
+
+/*  Log-structured FPGA data files. Every staging buffer is written as one block:
+ *  | header sector (DBLK_HEADER_LEN) | payload (payload length) |
+ *  The header sector starts with DBLK_header_t, the rest of the sector is zero. Keeping the
+ *  header one sector long keeps every payload sector aligned for raw multi-block writes.
+ *  A file is valid up to the first block whose header is damaged, belongs to another file,
+ *  does not increase the sequence or whose payload CRC does not match. Anything after that is
+ *  left over from a power loss or from whatever the preallocated clusters held before.
+ */
+#define DBLK_MAGIC                  0x424C5044 // "DPLB" on the card
+#define DBLK_VERSION                1
+#define DBLK_HEADER_LEN             512
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_len;
+    uint32_t file_ID;       // Unique per file, blocks of other files are never taken as valid
+    uint32_t sequence;      // Block counter, continues across the files of a boot
+    uint64_t time_us;       // On-board time at which the staging buffer was completed
+    uint32_t payload_len;
+    uint32_t payload_CRC;   // CRC-32 (IEEE 802.3) of the payload
+    uint32_t overflows;     // Staging buffers lost before this one since boot
+    uint32_t sample_seq;    // FPGA sequence number of the first sample, DBLK_NO_SAMPLE_SEQ if none found
+    uint32_t header_CRC;    // CRC-32 of all the preceding header fields
+} DBLK_header_t;
+
+/*  The FMC stream carries the same frames as the science UART (see scientific_data.h). The
+ *  sequence number of the first CB frame within DBLK_SAMPLE_SEARCH_LEN bytes of the payload
+ *  ties the block to the science packets and to the other blocks, across overflows.
+ */
+#define DBLK_NO_SAMPLE_SEQ          0xFFFFFFFF
+#define DBLK_SAMPLE_SEARCH_LEN      256
+
+// Scan stop reasons
+#define DBLK_SCAN_END               0 // Every block of the file is valid
+#define DBLK_SCAN_BAD_HEADER        1
+#define DBLK_SCAN_BAD_SEQUENCE      2 // Other file ID or sequence not above the previous block
+#define DBLK_SCAN_TRUNCATED         3 // Payload extends past the end of the file
+#define DBLK_SCAN_BAD_PAYLOAD       4
+
+typedef struct {
+    uint32_t blocks;            // Valid blocks
+    uint32_t file_ID;
+    uint32_t first_sequence;
+    uint32_t last_sequence;
+    uint32_t missing;           // Sequence numbers skipped between valid blocks, buffers given up
+    FSIZE_t  valid_len;         // Bytes up to the end of the last valid block
+    FSIZE_t  file_len;
+    uint8_t  stop_reason;
+} DBLK_scan_t;
+
+/*  Index sidecar of a data file, written alongside it:
+ *  | DBLK_index_header_t | DBLK_index_entry_t for every DBLK_INDEX_INTERVAL-th block of the file |
+ *  Entries are in block order, so both sequence and time increase along the file and a time
+ *  window is found with a binary search followed by one seek into the data file.
+ */
+#define DBLK_INDEX_MAGIC            0x494C5044 // "DPLI" on the card
+#define DBLK_INDEX_VERSION          1
+#define DBLK_INDEX_INTERVAL         16 // Blocks between entries, 1 MB of 64 KB payloads
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_len;
+    uint32_t file_ID;       // File ID of the blocks of the data file
+    uint32_t interval;      // Blocks between entries
+} DBLK_index_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t sequence;      // Block sequence number
+    uint32_t offset;        // Byte offset of the block header in the data file
+    uint64_t time_us;       // Block time from its header
+    uint32_t overflows;     // Staging buffers lost before the block since boot
+    uint32_t sample_seq;    // FPGA sequence number of the block's first sample from its header
+} DBLK_index_entry_t;
+
+uint32_t DBLK_CRC32(uint32_t crc, const uint8_t* data, uint32_t len);
+void DBLK_fill_header(uint8_t* header, uint32_t file_ID, uint32_t sequence, uint64_t time_us,
+                      const uint8_t* payload, uint32_t payload_len, uint32_t overflows);
+uint32_t DBLK_first_sample_seq(const uint8_t* payload, uint32_t payload_len);
+uint8_t DBLK_check_header(const uint8_t* header, DBLK_header_t* out);
+FRESULT DBLK_scan(FIL* fp, FIL* index, uint8_t verify_all, DBLK_scan_t* scan);
+FRESULT DBLK_recover(const TCHAR* path, const TCHAR* index_path, uint8_t verify_all, DBLK_scan_t* scan);
+FRESULT DBLK_index_create(FIL* index, const TCHAR* path, uint32_t file_ID);
+FRESULT DBLK_index_add(FIL* index, const DBLK_header_t* header, uint32_t offset);
+FRESULT DBLK_index_find(const TCHAR* path, uint64_t time_us, DBLK_index_entry_t* entry, uint32_t* N_entries);
+
+#endif /* DATA_BLOCK_H_ */
@@ -0,0 +1,33 @@
+/*
+ * downlink_scheduler.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef DOWNLINK_SCHEDULER_H_
+#define DOWNLINK_SCHEDULER_H_
+
+#include "Space_Packet_Protocol.h"
+
+#define DL_FRAME_LEN                (COBS_FRAME_LEN + 1) // COBS frame and the 0x00 sentinel
+#define DL_LOSSLESS_TIMEOUT         500 // ms a lossless class producer waits for queue space
+
+// Classes in priority order. Verification has strict priority, the others are budgeted.
+typedef enum {
+    DL_CLASS_VERIF      = 0, // PUS 1 verification and PUS 17 test reports
+    DL_CLASS_HK         = 1, // PUS 3 housekeeping
+    DL_CLASS_READBACK   = 2, // FPGA readbacks and other TC responses
+    DL_CLASS_EVENT      = 3, // CB event windows, lossless
+    DL_CLASS_SCIENCE    = 4, // CB packets and I-V parameters
+    DL_CLASS_BULK       = 5, // Segmented sweep records
+    NOF_DL_CLASSES,
+} DL_Class_ID_t;
+
+void DL_enqueue(uint8_t DL_class, uint8_t* frame, uint16_t frame_len);
+uint8_t DL_classify(SPP_header_t* SPP_header, PUS_TM_header_t* PUS_header);
+void DL_process(uint32_t current_ticks);
+uint8_t DL_occupancy(uint8_t DL_class);
+uint32_t DL_dropped(uint8_t DL_class);
+SPP_error set_DL_budget(uint8_t N_args, uint8_t* data);
+
+#endif /* DOWNLINK_SCHEDULER_H_ */
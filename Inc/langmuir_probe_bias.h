@@ -31,8 +31,91 @@ typedef enum {
     GS_TARGET_ARG_ID            = 0x08, // GS Target = Get Set Target
     FRAM_TABLE_ID_ARG_ID        = 0x09,
     N_SAMPLES_PER_STEP_ARG_ID   = 0x0A,
+    SWEEP_SHAPE_ARG_ID          = 0x0B,
+    START_VOL_LVL_ARG_ID        = 0x0C,
+    STOP_VOL_LVL_ARG_ID         = 0x0D,
+    BREAKPOINT_ARG_ID           = 0x0E, // Step ID (1 byte) followed by voltage level (2 bytes)
+    SEQ_ID_ARG_ID               = 0x0F,
+    DELAY_MS_ARG_ID             = 0x10,
+    SEQ_CMD_ARG_ID              = 0x11, // Function ID, N_args and arguments of a Langmuir function. Must be the last argument.
+    ENABLE_ARG_ID               = 0x12,
+    SC_N_SAMPLES_ARG_ID         = 0x13,
+    FLUSH_TIMEOUT_MS_ARG_ID     = 0x14,
+    APID_ARG_ID                 = 0x15,
+    FILTER_MODE_ARG_ID          = 0x16,
+    DECIMATION_ARG_ID           = 0x17,
+    FIR_TAP_ARG_ID              = 0x18, // Q15, repeated once per tap
+    N_AVG_SWEEPS_ARG_ID         = 0x19,
+    SIGMA_ARG_ID                = 0x1A,
+    TRIGGER_MODE_ARG_ID         = 0x1B,
+    TRIGGER_LEVEL_ARG_ID        = 0x1C,
+    SLOPE_LEVEL_ARG_ID          = 0x1D,
+    DIFF_LEVEL_ARG_ID           = 0x1E,
+    PRE_TRIGGER_ARG_ID          = 0x1F,
+    POST_TRIGGER_ARG_ID         = 0x20,
+    DL_CLASS_ARG_ID             = 0x21,
+    DL_RATE_ARG_ID              = 0x22, // bytes/s
+    DL_BURST_ARG_ID             = 0x23, // bytes
 } FPGA_Arg_ID_t;
 
+// FPGA configuration registers mirrored on the microcontroller.
+typedef enum {
+    FPGA_REG_NONE                   = 0,
+    FPGA_REG_CB_VOL_LVL             = 1,
+    FPGA_REG_SWT_VOL_LVL            = 2,
+    FPGA_REG_SWT_STEPS              = 3,
+    FPGA_REG_SWT_SAMPLES_PER_STEP   = 4,
+    FPGA_REG_SWT_SAMPLE_SKIP        = 5,
+    FPGA_REG_SWT_SAMPLES_PER_POINT  = 6,
+    FPGA_REG_SWT_NPOINTS            = 7,
+    NOF_FPGA_REGS,
+} FPGA_Reg_t;
+
+/*  FPGA Langmuir function list. Single source of truth for every supported FPGA
+ *  function: its opcode, how many readback bytes the FPGA answers with, handling
+ *  flags and the ordered list of arguments that are encoded after the opcode.
+ *  Adding a new FPGA function only requires adding a line here.
+ *
+ *  The register column names the configuration register a SET writes or a GET reads,
+ *  which lets the FPGA configuration mirror answer GETs locally.
+ *
+ *  X(name, opcode, readback_len, flags, register, N_args, (args...))
+ */
+#define FPGA_LANGMUIR_FUNC_LIST(X) \
+    X(FPGA_EN_CB_MODE,                0xCA, 0, FPGA_FUNC_SC_EN,                                FPGA_REG_NONE,                    0, (0))                                         \
+    X(FPGA_DIS_CB_MODE,               0xC0, 0, FPGA_FUNC_SC_DIS,                               FPGA_REG_NONE,                    0, (0))                                         \
+    X(FPGA_SET_CB_VOL_LVL,            0xCB, 0, 0,                                              FPGA_REG_CB_VOL_LVL,              2, (PROBE_ID_ARG_ID, VOL_LVL_ARG_ID))           \
+    X(FPGA_GET_CB_VOL_LVL,            0xCC, 2, FPGA_FUNC_READBACK,                             FPGA_REG_CB_VOL_LVL,              1, (PROBE_ID_ARG_ID))                           \
+    X(FPGA_SWT_ACTIVATE_SWEEP,        0xAA, 0, FPGA_FUNC_SC_EN,                                FPGA_REG_NONE,                    0, (0))                                         \
+    X(FPGA_SET_SWT_VOL_LVL,           0xAB, 0, FPGA_FUNC_FRAM_TARGET,                          FPGA_REG_SWT_VOL_LVL,             3, (PROBE_ID_ARG_ID, STEP_ID_ARG_ID, VOL_LVL_ARG_ID)) \
+    X(FPGA_SET_SWT_STEPS,             0xAC, 0, 0,                                              FPGA_REG_SWT_STEPS,               1, (N_STEPS_ARG_ID))                            \
+    X(FPGA_SET_SWT_SAMPLES_PER_STEP,  0xAD, 0, 0,                                              FPGA_REG_SWT_SAMPLES_PER_STEP,    1, (N_SAMPLES_PER_STEP_ARG_ID))                 \
+    X(FPGA_SET_SWT_SAMPLE_SKIP,       0xAE, 0, 0,                                              FPGA_REG_SWT_SAMPLE_SKIP,         1, (N_SKIP_ARG_ID))                             \
+    X(FPGA_SET_SWT_SAMPLES_PER_POINT, 0xAF, 0, 0,                                              FPGA_REG_SWT_SAMPLES_PER_POINT,   1, (N_F_ARG_ID))                                \
+    X(FPGA_SET_SWT_NPOINTS,           0xB0, 0, 0,                                              FPGA_REG_SWT_NPOINTS,             1, (N_POINTS_ARG_ID))                           \
+    X(FPGA_GET_SWT_SWEEP_CNT,         0xA0, 2, FPGA_FUNC_READBACK,                             FPGA_REG_NONE,                    0, (0))                                         \
+    X(FPGA_GET_SWT_VOL_LVL,           0xA1, 2, FPGA_FUNC_READBACK | FPGA_FUNC_FRAM_TARGET,     FPGA_REG_SWT_VOL_LVL,             2, (PROBE_ID_ARG_ID, STEP_ID_ARG_ID))           \
+    X(FPGA_GET_SWT_STEPS,             0xA2, 1, FPGA_FUNC_READBACK,                             FPGA_REG_SWT_STEPS,               0, (0))                                         \
+    X(FPGA_GET_SWT_SAMPLES_PER_STEP,  0xA3, 2, FPGA_FUNC_READBACK,                             FPGA_REG_SWT_SAMPLES_PER_STEP,    0, (0))                                         \
+    X(FPGA_GET_SWT_SAMPLE_SKIP,       0xA4, 2, FPGA_FUNC_READBACK,                             FPGA_REG_SWT_SAMPLE_SKIP,         0, (0))                                         \
+    X(FPGA_GET_SWT_SAMPLES_PER_POINT, 0xA5, 2, FPGA_FUNC_READBACK,                             FPGA_REG_SWT_SAMPLES_PER_POINT,   0, (0))                                         \
+    X(FPGA_GET_SWT_NPOINTS,           0xA6, 2, FPGA_FUNC_READBACK,                             FPGA_REG_SWT_NPOINTS,             0, (0))
+
+#define FPGA_FUNC_MAX_ARGS      3
+
+#define READBACK_APID           0xABBA
+
+// FPGA function handling flags
+#define FPGA_FUNC_READBACK      0x01 // FPGA answers with readback_len bytes, which are forwarded to ground.
+#define FPGA_FUNC_FRAM_TARGET   0x02 // GS_TARGET_ARG_ID selects a FRAM sweep table instead of the FPGA.
+#define FPGA_FUNC_SC_EN         0x04 // Start receiving scientific data from the FPGA.
+#define FPGA_FUNC_SC_DIS        0x08 // Stop receiving scientific data from the FPGA.
+
+#define FPGA_FUNC_ENUM_ENTRY(name, opcode, ...) name = opcode,
+typedef enum {
+    FPGA_LANGMUIR_FUNC_LIST(FPGA_FUNC_ENUM_ENTRY)
+} FPGA_Func_ID_t;
+
 typedef struct FPGA_msg_arg {
     uint8_t  probe_ID;
     uint8_t  step_ID;
@@ -51,11 +134,16 @@ typedef struct FPGA_msg_arg {
 extern uint8_t FPGA_byte_recv;
 
 
-void send_FPGA_langmuir_msg(uint8_t func_id, FPGA_msg_arg_t* fpgama);
+SPP_error send_FPGA_langmuir_msg(uint8_t func_id, FPGA_msg_arg_t* fpgama);
 bool is_langmuir_func(uint8_t func_id);
+uint8_t FPGA_arg_width(uint8_t arg_ID);
+uint8_t* decode_FPGA_msg_args(uint8_t N_args, uint8_t* data, FPGA_msg_arg_t* fpgama);
+uint16_t FPGA_msg_args_len(uint8_t N_args, uint8_t* data);
 bool FPGA_rx_langmuir_readback(uint8_t recv_byte);
 SPP_error save_sweep_table_value_FRAM(uint8_t save_id, uint8_t step_id, uint16_t value);
+SPP_error save_sweep_table_FRAM(uint8_t table_id, uint16_t* values, uint16_t N_values);
 uint16_t read_sweep_table_value_FRAM(uint8_t save_id, uint8_t step_id);
 void copy_full_sweep_table_FRAM_to_FPGA(uint8_t fram_table_id, uint8_t fpga_table_id);
-void handle_scientific_data_packet();
+void write_sweep_table_FPGA(uint8_t fpga_table_id, uint16_t* values, uint16_t N_values);
+void refresh_FPGA_config_mirror(uint32_t current_ticks);
 #endif /* LANGMUIR_PROBE_BIAS_H_ */
@@ -42,19 +42,23 @@ extern "C" {
 
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
-
+// Enables the I- and D-cache of the Cortex-M7. Set to 0 to compare against the uncached build.
+#define CPU_CACHE_ENABLE 1
 /* USER CODE END EC */
 
 /* Exported macro ------------------------------------------------------------*/
 /* USER CODE BEGIN EM */
-
+// Places a DMA buffer in DTCM, which the D-cache never covers, so it needs no cache maintenance.
+// Buffers too large for DTCM have to be cleaned/invalidated around each transfer instead.
+#define DMA_BUFFER __attribute__((section(".dma_buffer"), aligned(32)))
 /* USER CODE END EM */
 
 /* Exported functions prototypes ---------------------------------------------*/
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
-
+void DCache_clean(const void* addr, uint32_t len);
+void DCache_invalidate(void* addr, uint32_t len);
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
@@ -0,0 +1,23 @@
+/*
+ * on_board_time.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef ON_BOARD_TIME_H_
+#define ON_BOARD_TIME_H_
+
+#include "main.h"
+#include <stdint.h>
+
+/*  On-board time from the DWT cycle counter, extended to 64 bits in software. The 32-bit
+ *  counter wraps every ~20 s at 216 MHz, so OBT_get_cycles() has to be called at least that
+ *  often. The 1 kHz TIM1 HAL time base interrupt does so through OBT_poll(), which keeps the
+ *  time monotonic however long the main loop blocks.
+ */
+uint64_t OBT_get_cycles();
+uint64_t OBT_cycles_to_us(uint64_t cycles);
+uint64_t OBT_get_us();
+void OBT_poll();
+
+#endif /* ON_BOARD_TIME_H_ */
@@ -0,0 +1,35 @@
+/*
+ * rice_compression.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef RICE_COMPRESSION_H_
+#define RICE_COMPRESSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*  Lossless compression after CCSDS 121.0-B (Lossless Data Compression).
+ *  Fixed parameters: n = 16 bit unsigned samples, J = 16 samples per block, unit-delay
+ *  predictor, one reference sample at the start of every encoded stream.
+ *  Options per block: second extension, fundamental sequence, sample splitting
+ *  (k = 1..13) and no compression. Zero-block option is not used.
+ *
+ *  Portable C without HAL dependencies, so the same file builds the ground decoder and the
+ *  host round trip test in Tests/.
+ */
+#define RICE_N_BITS             16
+#define RICE_BLOCK_LEN          16
+#define RICE_ID_BITS            4
+#define RICE_MAX_K              13
+
+#define RICE_ID_SECOND_EXT      0x0 // Followed by a single '1' bit (a '0' would be a zero-block)
+#define RICE_ID_FS              0x1
+#define RICE_ID_NO_COMP         0xF
+
+size_t rice_encode(const uint16_t* samples, size_t N, size_t stride, uint8_t* out, size_t out_max);
+size_t rice_decode(const uint8_t* in, size_t in_len, uint16_t* samples, size_t N, size_t stride);
+size_t rice_decode_channels(const uint8_t* in, size_t in_len, uint16_t* samples, size_t N, size_t N_channels);
+
+#endif /* RICE_COMPRESSION_H_ */
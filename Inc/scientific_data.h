@@ -0,0 +1,72 @@
+/*
+ * scientific_data.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef SCIENTIFIC_DATA_H_
+#define SCIENTIFIC_DATA_H_
+
+#include "Space_Packet_Protocol.h"
+
+#define SCIENTIFIC_DATA_PREAMBLE        0x83
+#define SC_CB_FRAME_LEN                 7 // Preamble, 2 sequence counter bytes and 2 data bytes each probe.
+#define SWT_SC_DATA_PREAMBLE            0x84
+#define SC_SWT_FRAME_LEN                8 // Preamble, 2 sweep counter bytes, step ID and 2 data bytes each probe.
+#define SC_MAX_FRAME_LEN                SC_SWT_FRAME_LEN
+
+/*  CB science packet data field:
+ *  | first sample sequence number (2) | N samples (1) | format (1) | first sample time (8) | samples |
+ *  SC_FORMAT_RAW:  N x [probe 0 (2) | probe 1 (2)]
+ *  SC_FORMAT_RICE: CCSDS 121.0 stream of the N probe 0 values, followed by the probe 1 stream.
+ *  Samples in a packet always have contiguous FPGA sequence numbers. The first sample time is
+ *  the on-board time in us at which the last byte of its frame was received, which correlates
+ *  the FPGA sequence counter with on-board time.
+ */
+#define SC_CB_PACKET_HEADER_LEN         12
+#define SC_CB_SAMPLE_LEN                4
+#define SC_CB_MAX_SAMPLES_PER_PACKET    58 // Keeps the COBS encoded packet within SPP_MAX_PACKET_LEN
+#define SC_CB_DEF_SAMPLES_PER_PACKET    32
+#define SC_CB_DEF_FLUSH_TIMEOUT         500 // ms
+
+// UART5 circular DMA buffer. At 115200 baud the whole buffer lasts ~350 ms.
+#define SC_DMA_BUF_LEN                  4096
+#define SC_DMA_HALF_LEN                 (SC_DMA_BUF_LEN / 2)
+#define SC_DMA_GUARD_LEN                256 // Bytes kept free ahead of the DMA when the consumer falls behind
+#define SC_UART_BAUD                    115200
+#define SC_UART_BITS_PER_BYTE           10 // 8N1
+#define SC_TIME_REFS                    32 // Stream time references kept for the frame parser
+
+#define SC_FORMAT_RAW                   0x00
+#define SC_FORMAT_RICE                  0x01
+#define SC_MAX_COMPRESS_SAMPLES         256
+
+#define CB_SC_DATA_APID                 0x2CB
+#define SWT_SC_DATA_APID                0x2AD
+#define CB_EVENT_APID                   0x2CE
+
+typedef struct {
+    uint32_t samples_in;
+    uint32_t packets_out;
+    uint32_t bytes_dropped;     // Overwritten by DMA before they were processed
+    uint32_t sync_errors;       // Bytes skipped while looking for a preamble
+    uint32_t sweeps_out;
+    uint32_t sweeps_incomplete; // Sweeps with missing or short steps
+} SC_pipeline_stats_t;
+
+extern bool sc_data_en;
+extern SC_pipeline_stats_t SC_stats;
+
+void enable_scientific_data_callback();
+void disable_scientific_data_callback();
+void SC_DMA_half_callback();
+void SC_UART_idle_callback();
+void SC_DMA_error_callback();
+void process_scientific_data(uint32_t current_ticks);
+uint64_t SC_frame_time_us();
+SPP_error set_CB_packing(uint8_t N_args, uint8_t* data);
+bool SC_compression_enabled(uint16_t APID);
+uint16_t SC_compress_samples(uint8_t* raw, uint16_t N, uint8_t* out);
+SPP_error set_SC_compression(uint8_t N_args, uint8_t* data);
+
+#endif /* SCIENTIFIC_DATA_H_ */
@@ -0,0 +1,47 @@
+/*
+ * sd_stats.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef SD_STATS_H_
+#define SD_STATS_H_
+
+#include "main.h"
+#include <stdint.h>
+
+/*  Latency of the SD writer, timed with the DWT cycle counter around every block write and
+ *  every f_sync. Latencies go into log2 buckets: bucket 0 holds everything below
+ *  SDS_HIST_BASE_US, bucket i holds [SDS_HIST_BASE_US << (i - 1), SDS_HIST_BASE_US << i)
+ *  and the last bucket everything from SDS_HIST_BASE_US << (SDS_HIST_BUCKETS - 2) up.
+ *  With a 32 us base the last bucket starts at ~524 ms.
+ */
+#define SDS_HIST_BUCKETS            16
+#define SDS_HIST_BASE_US            32
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[SDS_HIST_BUCKETS];
+} SDS_hist_t;
+
+typedef struct {
+    SDS_hist_t write;           // Block writes, f_write or raw sector writes in fast capture
+    SDS_hist_t sync;            // f_sync of the data file
+} SD_writer_stats_t;
+
+extern SD_writer_stats_t SD_stats;
+
+// Start of a timed operation, handed to SDS_record() once it returns
+static inline uint32_t SDS_start() {
+    return DWT->CYCCNT;
+}
+
+uint8_t SDS_bucket(uint32_t us);
+uint32_t SDS_bucket_floor_us(uint8_t bucket);
+void SDS_record(SDS_hist_t* hist, uint32_t start_cycles);
+uint32_t SDS_mean_us(const SDS_hist_t* hist);
+void SDS_reset();
+
+#endif /* SD_STATS_H_ */
@@ -0,0 +1,67 @@
+/*
+ * storage_manager.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef STORAGE_MANAGER_H_
+#define STORAGE_MANAGER_H_
+
+#include "main.h"
+#include <fatfs.h>
+#include <stdint.h>
+
+/*  Data files on the SD card are numbered series in the root directory:
+ *  /FFU<FFU ID>_<unit name>_<series name>_<file number><extension>
+ *  A new file always takes the number after the highest one on the card, so the lowest
+ *  number of a series is its oldest file even after older files have been deleted.
+ *  The next number of each series is kept in FRAM, so opening a file is a single f_open.
+ *  The FRAM counter is checked against the directory only before the first file of a series
+ *  after boot, and moved past the highest number on the card if it is behind, e.g. after a
+ *  card swap or a FRAM that was never initialised.
+ *
+ *  Files are rotated once they reach their size or age limit (0 means no limit). The free
+ *  space of the card is checked every STOR_POLL_INTERVAL. Below the low watermark the oldest
+ *  closed files are deleted, one per poll, until the high watermark is reached again:
+ *  FPGA files (with their index) first, uC files only once no closed FPGA file is left.
+ */
+#define STOR_SERIES_FPGA            0
+#define STOR_SERIES_UC              1
+#define NOF_STOR_SERIES             2
+
+#define STOR_POLL_INTERVAL          10000 // ms
+
+#define STOR_DEF_FPGA_MAX_SIZE      (256UL * 1024 * 1024) // bytes
+#define STOR_DEF_FPGA_MAX_AGE       (60UL * 60 * 1000) // ms
+#define STOR_DEF_UC_MAX_SIZE        (16UL * 1024 * 1024)
+#define STOR_DEF_UC_MAX_AGE         (6UL * 60 * 60 * 1000)
+#define STOR_DEF_LOW_WATERMARK      (512UL * 1024) // kB free
+#define STOR_DEF_HIGH_WATERMARK     (1024UL * 1024)
+
+typedef struct {
+    uint32_t max_size[NOF_STOR_SERIES];     // bytes
+    uint32_t max_age[NOF_STOR_SERIES];      // ms
+    uint32_t low_watermark;                 // kB
+    uint32_t high_watermark;                // kB
+} STOR_config_t;
+
+typedef struct {
+    uint32_t total_kB;
+    uint32_t free_kB;
+    uint32_t rotations;
+    uint32_t files_deleted;
+    uint32_t kB_reclaimed;
+    uint8_t  reclaiming;                    // Free space went below the low watermark
+} STOR_stats_t;
+
+extern STOR_config_t STOR_config;
+extern STOR_stats_t STOR_stats;
+
+void STOR_file_name(char* out, uint8_t series, uint32_t file_no, const char* ext);
+uint8_t STOR_find_series(uint8_t series, uint32_t* lowest, uint32_t* highest);
+uint32_t STOR_new_file(uint8_t series, uint32_t current_ticks);
+uint8_t STOR_rotation_due(uint8_t series, FSIZE_t size, uint32_t current_ticks);
+FRESULT STOR_update_usage();
+void STOR_poll(uint32_t current_ticks);
+
+#endif /* STORAGE_MANAGER_H_ */
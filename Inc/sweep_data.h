@@ -0,0 +1,59 @@
+/*
+ * sweep_data.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef SWEEP_DATA_H_
+#define SWEEP_DATA_H_
+
+#include "scientific_data.h"
+
+#define SWT_MAX_STEPS               256
+#define SWT_RECORD_TIMEOUT          1000 // ms without samples after which a sweep is closed
+
+/*  Sweep record, one per sweep or per averaged group of sweeps:
+ *  | sweep counter (2) | start time (8) | FRAM table ID probe 0 (1) | FRAM table ID probe 1 (1) | N steps (2) |
+ *  | samples per step (2) | N sweeps (1) | status (1) | missing steps (2) | format (1) |
+ *  | step bitmap (32) | steps | sigma |
+ *  SC_FORMAT_RAW:    N steps x [probe 0 (2) | probe 1 (2)], mean of the samples of the step, 0 if missing
+ *  SC_FORMAT_RICE:   the same values compressed with SC_compress_samples()
+ *  SWT_FORMAT_SIGMA: steps are followed by N steps x [probe 0 (2) | probe 1 (2)] uncompressed
+ *                    standard deviations of the step over the averaged sweeps
+ *  Bit i of the step bitmap is set if step i received at least one sample. The start time is
+ *  the on-board time in us of the first received sample of the sweep. For an average the
+ *  sweep counter and start time are the ones of its first sweep and the status is the OR of
+ *  all its sweeps.
+ */
+#define SWT_RECORD_HEADER_LEN       (2 + 8 + 1 + 1 + 2 + 2 + 1 + 1 + 2 + 1 + (SWT_MAX_STEPS / 8))
+#define SWT_RECORD_MAX_LEN          (SWT_RECORD_HEADER_LEN + 2 * SWT_MAX_STEPS * SC_CB_SAMPLE_LEN)
+#define SWT_FORMAT_SIGMA            0x80
+
+/*  The record is downlinked as segmented SWT_SC_DATA_APID packets, each data field being
+ *  | sweep counter (2) | byte offset in the record (2) | up to SWT_SEGMENT_DATA_LEN record bytes |
+ */
+#define SWT_SEGMENT_HEADER_LEN      4
+#define SWT_SEGMENT_DATA_LEN        200
+
+// Sweep records on the SD card are prefixed with the sync word and the record length (2).
+#define SWT_RECORD_SYNC             0xA55A
+
+#define SWT_TABLE_ID_UNKNOWN        0xFF
+
+// Record status flags
+#define SWT_STATUS_MISSING_STEPS    0x01 // At least one step received no samples
+#define SWT_STATUS_SHORT_STEPS      0x02 // At least one step received fewer than samples per step
+#define SWT_STATUS_TIMEOUT          0x04 // Closed by SWT_RECORD_TIMEOUT instead of the last step or the next sweep
+#define SWT_STATUS_NO_CONFIG        0x08 // N steps or samples per step not known, defaults used
+#define SWT_STATUS_OUT_OF_RANGE     0x10 // Samples with a step ID beyond N steps were dropped
+
+extern uint16_t swt_sc_seq_count;
+
+void SWT_record_reset();
+void SWT_add_sample(uint16_t sweep_cnt, uint8_t step_ID, uint16_t* value);
+void SWT_process(uint32_t current_ticks);
+void SWT_flush();
+void SWT_set_table_ID(uint8_t FPGA_table_id, uint8_t FRAM_table_id);
+SPP_error set_SWT_averaging(uint8_t N_args, uint8_t* data);
+
+#endif /* SWEEP_DATA_H_ */
@@ -0,0 +1,39 @@
+/*
+ * sweep_profile.h
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#ifndef SWEEP_PROFILE_H_
+#define SWEEP_PROFILE_H_
+
+#include "langmuir_probe_bias.h"
+
+#define SWEEP_TABLE_LEN             256
+#define SWEEP_MAX_BREAKPOINTS       16
+
+typedef enum {
+    SWEEP_SHAPE_LINEAR      = 0,
+    SWEEP_SHAPE_LOG         = 1, // Steps logarithmically spaced away from the start level
+    SWEEP_SHAPE_TRIANGLE    = 2, // Start -> stop in the first half, stop -> start in the second, N_steps >= 3
+    SWEEP_SHAPE_CUSTOM      = 3, // Piecewise linear through the breakpoints
+} Sweep_Shape_t;
+
+typedef struct {
+    uint8_t  step_ID;
+    uint16_t voltage_level;
+} Sweep_breakpoint_t;
+
+typedef struct {
+    uint8_t  shape;
+    uint16_t start_voltage;
+    uint16_t stop_voltage;
+    uint16_t N_steps;
+    uint8_t  N_breakpoints;
+    Sweep_breakpoint_t breakpoints[SWEEP_MAX_BREAKPOINTS];
+} Sweep_profile_t;
+
+SPP_error generate_sweep_profile(Sweep_profile_t* profile, uint16_t* out_table);
+SPP_error generate_sweep_table(uint8_t N_args, uint8_t* data);
+
+#endif /* SWEEP_PROFILE_H_ */
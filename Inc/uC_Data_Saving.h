@@ -14,3 +14,4 @@ extern uint8_t dewobble_packet2[20];
 extern uint8_t uCFileOpen;
 
 FRESULT openUCDataFile();
+FRESULT rotateUCDataFile(UINT len);
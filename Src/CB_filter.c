@@ -0,0 +1,214 @@
+/*
+ * CB_filter.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "CB_filter.h"
+#include "langmuir_probe_bias.h"
+
+/*  Decimation and filtering of CB mode samples between reception and packetization.
+ *
+ *  Samples are offset binary 16-bit values. For the FIR they are converted to Q15 and the
+ *  taps are Q15 as well. The history of each channel is stored twice (at pos and at
+ *  pos + CB_FILTER_MAX_TAPS), so the newest CB_FILTER_MAX_TAPS samples are always
+ *  contiguous in memory and can be read two at a time for the dual 16-bit MAC.
+ *
+ *  A gap in the FPGA sequence numbers restarts the filter, so an output never mixes
+ *  samples from both sides of a gap.
+ */
+typedef struct {
+    uint8_t  mode;
+    uint8_t  decimation;
+    uint8_t  N_taps;                        // Rounded up to even, the padding tap is 0
+    int16_t  taps[CB_FILTER_MAX_TAPS];      // taps[0] applies to the newest sample
+} CB_filter_config_t;
+
+static CB_filter_config_t CB_filter_cfg = {
+    .mode       = CB_FILTER_NONE,
+    .decimation = 1,
+    .N_taps     = 0,
+    .taps       = {0},
+};
+
+static int16_t  CB_history[CB_FILTER_N_CHANNELS][2 * CB_FILTER_MAX_TAPS] __attribute__((aligned(4)));
+static uint8_t  CB_history_pos = 0;
+static uint8_t  CB_history_fill = 0;
+static uint32_t CB_boxcar_sum[CB_FILTER_N_CHANNELS];
+static uint8_t  CB_decim_count = 0;
+static uint16_t CB_expected_seq = 0;
+static bool     CB_filter_started = false;
+
+
+void CB_filter_reset() {
+    memset(CB_history, 0, sizeof(CB_history));
+    memset(CB_boxcar_sum, 0, sizeof(CB_boxcar_sum));
+    CB_history_pos = 0;
+    CB_history_fill = 0;
+    CB_decim_count = 0;
+    CB_filter_started = false;
+}
+
+
+uint8_t CB_filter_decimation() {
+    return (CB_filter_cfg.mode == CB_FILTER_NONE) ? 1 : CB_filter_cfg.decimation;
+}
+
+
+static inline int16_t to_Q15(uint16_t value) {
+    return (int16_t)(value ^ 0x8000);
+}
+
+static inline uint16_t from_Q30(int32_t acc) {
+    acc = (acc + (1 << 14)) >> 15;
+    if (acc > INT16_MAX) {
+        acc = INT16_MAX;
+    } else if (acc < INT16_MIN) {
+        acc = INT16_MIN;
+    }
+    return (uint16_t)(acc ^ 0x8000);
+}
+
+
+// Dot product of the taps and the newest samples. window[0] is the oldest sample.
+// The sum of the absolute tap values must stay below 2.0 so the Q30 sum cannot overflow.
+static int32_t FIR_dot(const int16_t* window, const int16_t* taps_reversed, uint8_t N_taps) {
+    int32_t acc = 0;
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    // Two 16-bit products per instruction. The window may start on an odd sample, so the
+    // pairs are loaded with memcpy, which compiles to a single unaligned-safe LDR.
+    for (uint8_t i = 0; i < N_taps; i += 2) {
+        uint32_t w, t;
+        memcpy(&w, &window[i], sizeof(w));
+        memcpy(&t, &taps_reversed[i], sizeof(t));
+        acc = __SMLAD(w, t, acc);
+    }
+#else
+    for (uint8_t i = 0; i < N_taps; i++) {
+        acc += (int32_t) window[i] * taps_reversed[i];
+    }
+#endif
+    return acc;
+}
+
+
+/*  Pushes one sample through the filter. Returns true and fills out when a decimated
+ *  output sample is ready.
+ */
+bool CB_filter_push(CB_sample_t* in, CB_sample_t* out) {
+    CB_filter_config_t* cfg = &CB_filter_cfg;
+
+    if (cfg->mode == CB_FILTER_NONE) {
+        *out = *in;
+        return true;
+    }
+    if (CB_filter_started && in->seq != CB_expected_seq) {
+        CB_filter_reset();
+    }
+    CB_filter_started = true;
+    CB_expected_seq = in->seq + 1;
+
+    if (cfg->mode == CB_FILTER_BOXCAR) {
+        for (uint8_t ch = 0; ch < CB_FILTER_N_CHANNELS; ch++) {
+            CB_boxcar_sum[ch] += in->value[ch];
+        }
+        if (++CB_decim_count < cfg->decimation) {
+            return false;
+        }
+        out->seq = in->seq;
+        for (uint8_t ch = 0; ch < CB_FILTER_N_CHANNELS; ch++) {
+            out->value[ch] = (CB_boxcar_sum[ch] + (cfg->decimation / 2)) / cfg->decimation;
+            CB_boxcar_sum[ch] = 0;
+        }
+        CB_decim_count = 0;
+        return true;
+    }
+
+    // FIR
+    for (uint8_t ch = 0; ch < CB_FILTER_N_CHANNELS; ch++) {
+        int16_t x = to_Q15(in->value[ch]);
+        CB_history[ch][CB_history_pos] = x;
+        CB_history[ch][CB_history_pos + CB_FILTER_MAX_TAPS] = x;
+    }
+    CB_history_pos = (CB_history_pos + 1) % CB_FILTER_MAX_TAPS;
+    if (CB_history_fill < cfg->N_taps) {
+        CB_history_fill++;
+    }
+
+    if (++CB_decim_count < cfg->decimation || CB_history_fill < cfg->N_taps) {
+        return false;
+    }
+    CB_decim_count = 0;
+
+    // Taps reversed so they line up with the oldest-first window.
+    int16_t taps_reversed[CB_FILTER_MAX_TAPS] __attribute__((aligned(4)));
+    for (uint8_t i = 0; i < cfg->N_taps; i++) {
+        taps_reversed[i] = cfg->taps[cfg->N_taps - 1 - i];
+    }
+
+    uint8_t window_start = CB_history_pos + CB_FILTER_MAX_TAPS - cfg->N_taps;
+    out->seq = in->seq;
+    for (uint8_t ch = 0; ch < CB_FILTER_N_CHANNELS; ch++) {
+        int32_t acc = FIR_dot(&CB_history[ch][window_start], taps_reversed, cfg->N_taps);
+        out->value[ch] = from_Q30(acc);
+    }
+    return true;
+}
+
+
+/*  FILTER_MODE_ARG_ID selects the mode, DECIMATION_ARG_ID the ratio R and every FIR_TAP_ARG_ID
+ *  (Q15) appends a tap, newest sample first. Taps are only replaced if at least one is given.
+ *  Tap sets with a sum of absolute values of 2.0 or more are rejected.
+ */
+SPP_error set_CB_filter(uint8_t N_args, uint8_t* data) {
+    CB_filter_config_t cfg = CB_filter_cfg;
+    uint8_t N_new_taps = 0;
+
+    for (int i = 0; i < N_args; i++) {
+        uint8_t arg_ID = *data++;
+        switch (arg_ID) {
+            case FILTER_MODE_ARG_ID:
+                cfg.mode = *data++;
+                break;
+            case DECIMATION_ARG_ID:
+                cfg.decimation = *data++;
+                break;
+            case FIR_TAP_ARG_ID:
+                if (N_new_taps >= CB_FILTER_MAX_TAPS) {
+                    return SPP_PUS8_ERROR;
+                }
+                memcpy(&cfg.taps[N_new_taps++], data, sizeof(int16_t));
+                data += sizeof(int16_t);
+                break;
+            default:
+                data += FPGA_arg_width(arg_ID);
+                break;
+        }
+    }
+
+    if (N_new_taps > 0) {
+        for (uint8_t i = N_new_taps; i < CB_FILTER_MAX_TAPS; i++) {
+            cfg.taps[i] = 0;
+        }
+        cfg.N_taps = N_new_taps + (N_new_taps & 0x01);
+    }
+    if (cfg.mode > CB_FILTER_FIR || cfg.decimation == 0 || cfg.decimation > CB_FILTER_MAX_DECIMATION) {
+        return SPP_PUS8_ERROR;
+    }
+    if (cfg.mode == CB_FILTER_FIR && cfg.N_taps == 0) {
+        return SPP_PUS8_ERROR;
+    }
+
+    // Sum of |taps| must stay below 2.0, otherwise the Q30 accumulator in FIR_dot can overflow
+    uint32_t tap_gain = 0;
+    for (uint8_t i = 0; i < cfg.N_taps; i++) {
+        tap_gain += (uint32_t) abs(cfg.taps[i]);
+    }
+    if (tap_gain >= (2UL << 15)) {
+        return SPP_PUS8_ERROR;
+    }
+
+    CB_filter_cfg = cfg;
+    CB_filter_reset();
+    return SPP_OK;
+}
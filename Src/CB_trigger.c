@@ -0,0 +1,247 @@
+/*
+ * CB_trigger.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "CB_trigger.h"
+#include "langmuir_probe_bias.h"
+#include "scientific_data.h"
+
+/*  Event trigger on the full rate CB mode samples.
+ *
+ *  Every received sample is checked against the enabled trigger conditions before it is
+ *  filtered. Until a trigger, samples are kept in a ring of the last pre_trigger samples.
+ *  On a trigger the ring, the trigger sample and the next post_trigger samples are sent
+ *  right away as CB_EVENT_APID packets, while the regular CB packets continue to carry only
+ *  the filtered and decimated stream. Triggers are not evaluated during a capture.
+ */
+typedef struct {
+    uint8_t  conditions;
+    uint8_t  probe;         // Probe of the threshold and slope conditions
+    uint16_t level;
+    uint16_t slope;
+    uint16_t diff;
+    uint16_t pre_trigger;
+    uint16_t post_trigger;
+} CB_trigger_config_t;
+
+static CB_trigger_config_t CB_trig_cfg = {
+    .conditions     = 0,
+    .probe          = 0,
+    .level          = 0x8000,
+    .slope          = 0xFFFF,
+    .diff           = 0xFFFF,
+    .pre_trigger    = CB_TRIG_DEF_PRE,
+    .post_trigger   = CB_TRIG_DEF_POST,
+};
+
+static CB_sample_t CB_pre_ring[CB_TRIG_MAX_PRE];
+static uint16_t    CB_pre_head = 0;
+static uint16_t    CB_pre_count = 0;
+static CB_sample_t CB_prev_sample;
+static bool        CB_have_prev = false;
+static bool        CB_capturing = false;
+static uint16_t    CB_post_remaining = 0;
+
+static uint8_t     CB_event_data[CB_EVENT_HEADER_LEN + CB_EVENT_MAX_SAMPLES * CB_EVENT_SAMPLE_LEN];
+static uint8_t     CB_event_N = 0;
+static uint16_t    CB_event_id = 0;
+static uint8_t     CB_event_conditions = 0;
+static uint16_t    CB_event_trigger_seq = 0;
+static uint64_t    CB_event_trigger_time = 0;
+uint16_t           CB_event_seq_count = 0;
+uint32_t           CB_trigger_events = 0;
+
+
+void CB_trigger_reset() {
+    CB_pre_head = 0;
+    CB_pre_count = 0;
+    CB_have_prev = false;
+    CB_capturing = false;
+    CB_event_N = 0;
+}
+
+
+static inline uint16_t abs_diff(uint16_t a, uint16_t b) {
+    return (a > b) ? a - b : b - a;
+}
+
+
+// Returns the conditions that fired on this sample.
+static uint8_t evaluate(CB_sample_t* sample) {
+    uint8_t  fired = 0;
+    uint16_t value = sample->value[CB_trig_cfg.probe];
+
+    if (!CB_have_prev) {
+        return 0;
+    }
+    uint16_t prev = CB_prev_sample.value[CB_trig_cfg.probe];
+
+    if ((CB_trig_cfg.conditions & CB_TRIG_THRESHOLD) && ((prev < CB_trig_cfg.level) != (value < CB_trig_cfg.level))) {
+        fired |= CB_TRIG_THRESHOLD;
+    }
+    if ((CB_trig_cfg.conditions & CB_TRIG_SLOPE) && abs_diff(value, prev) >= CB_trig_cfg.slope) {
+        fired |= CB_TRIG_SLOPE;
+    }
+    if ((CB_trig_cfg.conditions & CB_TRIG_DIFF) &&
+        abs_diff(sample->value[0], sample->value[1]) >= CB_trig_cfg.diff &&
+        abs_diff(CB_prev_sample.value[0], CB_prev_sample.value[1]) < CB_trig_cfg.diff) {
+        fired |= CB_TRIG_DIFF;
+    }
+    return fired;
+}
+
+
+static void send_event_packet() {
+    uint16_t data_len = CB_EVENT_HEADER_LEN + CB_event_N * CB_EVENT_SAMPLE_LEN;
+
+    memcpy(CB_event_data, &CB_event_id, sizeof(CB_event_id));
+    CB_event_data[2] = CB_event_conditions;
+    memcpy(CB_event_data + 3, &CB_event_trigger_seq, sizeof(CB_event_trigger_seq));
+    memcpy(CB_event_data + 5, &CB_event_trigger_time, sizeof(CB_event_trigger_time));
+    CB_event_data[13] = CB_event_N;
+
+    SPP_header_t SPP_header = SPP_make_header(
+        SPP_VERSION,
+        SPP_PACKET_TYPE_TM,
+        0,
+        CB_EVENT_APID,
+        SPP_SEQUENCE_SEG_UNSEG,
+        CB_event_seq_count,
+        data_len + CRC_BYTE_LEN - 1
+    );
+    SPP_send_TM(&SPP_header, NULL, CB_event_data, data_len);
+    CB_event_seq_count = (CB_event_seq_count + 1) & 0x3FFF;
+    CB_event_N = 0;
+    SC_stats.packets_out++;
+}
+
+
+static void add_event_sample(CB_sample_t* sample) {
+    uint8_t* out = CB_event_data + CB_EVENT_HEADER_LEN + CB_event_N * CB_EVENT_SAMPLE_LEN;
+    memcpy(out, &sample->seq, sizeof(sample->seq));
+    memcpy(out + 2, sample->value, sizeof(sample->value));
+    CB_event_N++;
+    if (CB_event_N >= CB_EVENT_MAX_SAMPLES) {
+        send_event_packet();
+    }
+}
+
+
+static void start_event(uint8_t conditions, CB_sample_t* sample) {
+    CB_event_id++;
+    CB_event_conditions = conditions;
+    CB_event_trigger_seq = sample->seq;
+    CB_event_trigger_time = SC_frame_time_us();
+    CB_event_N = 0;
+    CB_trigger_events++;
+
+    // Pre-trigger samples, oldest first.
+    uint16_t pos = (CB_pre_head + CB_TRIG_MAX_PRE - CB_pre_count) % CB_TRIG_MAX_PRE;
+    for (uint16_t i = 0; i < CB_pre_count; i++) {
+        add_event_sample(&CB_pre_ring[pos]);
+        pos = (pos + 1) % CB_TRIG_MAX_PRE;
+    }
+    CB_pre_count = 0;
+
+    add_event_sample(sample);
+    CB_post_remaining = CB_trig_cfg.post_trigger;
+    CB_capturing = (CB_post_remaining > 0);
+    if (!CB_capturing && CB_event_N > 0) {
+        send_event_packet();
+    }
+}
+
+
+void CB_trigger_push(CB_sample_t* sample) {
+    if (CB_trig_cfg.conditions == 0) {
+        return;
+    }
+
+    if (CB_capturing) {
+        add_event_sample(sample);
+        if (--CB_post_remaining == 0) {
+            CB_capturing = false;
+            if (CB_event_N > 0) {
+                send_event_packet();
+            }
+        }
+    } else {
+        uint8_t fired = evaluate(sample);
+        if (fired) {
+            start_event(fired, sample);
+        } else if (CB_trig_cfg.pre_trigger > 0) {
+            CB_pre_ring[CB_pre_head] = *sample;
+            CB_pre_head = (CB_pre_head + 1) % CB_TRIG_MAX_PRE;
+            if (CB_pre_count < CB_trig_cfg.pre_trigger) {
+                CB_pre_count++;
+            }
+        }
+    }
+    CB_prev_sample = *sample;
+    CB_have_prev = true;
+}
+
+
+// Sends the samples of an unfinished capture.
+void CB_trigger_flush() {
+    if (CB_capturing && CB_event_N > 0) {
+        send_event_packet();
+    }
+    CB_capturing = false;
+}
+
+
+/*  TRIGGER_MODE_ARG_ID enables the trigger conditions (CB_TRIG_*, 0 disables triggering),
+ *  PROBE_ID_ARG_ID selects the probe of the threshold and slope conditions, TRIGGER_LEVEL_ARG_ID,
+ *  SLOPE_LEVEL_ARG_ID and DIFF_LEVEL_ARG_ID set the condition levels, and PRE_TRIGGER_ARG_ID
+ *  and POST_TRIGGER_ARG_ID the number of samples captured before and after the trigger.
+ */
+SPP_error set_CB_trigger(uint8_t N_args, uint8_t* data) {
+    CB_trigger_config_t cfg = CB_trig_cfg;
+
+    for (int i = 0; i < N_args; i++) {
+        uint8_t arg_ID = *data++;
+        switch (arg_ID) {
+            case TRIGGER_MODE_ARG_ID:
+                cfg.conditions = *data++;
+                break;
+            case PROBE_ID_ARG_ID:
+                cfg.probe = *data++;
+                break;
+            case TRIGGER_LEVEL_ARG_ID:
+                memcpy(&cfg.level, data, sizeof(cfg.level));
+                data += sizeof(cfg.level);
+                break;
+            case SLOPE_LEVEL_ARG_ID:
+                memcpy(&cfg.slope, data, sizeof(cfg.slope));
+                data += sizeof(cfg.slope);
+                break;
+            case DIFF_LEVEL_ARG_ID:
+                memcpy(&cfg.diff, data, sizeof(cfg.diff));
+                data += sizeof(cfg.diff);
+                break;
+            case PRE_TRIGGER_ARG_ID:
+                memcpy(&cfg.pre_trigger, data, sizeof(cfg.pre_trigger));
+                data += sizeof(cfg.pre_trigger);
+                break;
+            case POST_TRIGGER_ARG_ID:
+                memcpy(&cfg.post_trigger, data, sizeof(cfg.post_trigger));
+                data += sizeof(cfg.post_trigger);
+                break;
+            default:
+                data += FPGA_arg_width(arg_ID);
+                break;
+        }
+    }
+    if (cfg.probe >= CB_FILTER_N_CHANNELS || cfg.pre_trigger > CB_TRIG_MAX_PRE ||
+        (cfg.conditions & ~(CB_TRIG_THRESHOLD | CB_TRIG_SLOPE | CB_TRIG_DIFF))) {
+        return SPP_PUS8_ERROR;
+    }
+
+    CB_trigger_flush();
+    CB_trig_cfg = cfg;
+    CB_trigger_reset();
+    return SPP_OK;
+}
@@ -1,225 +1,546 @@
 #include "FPGA_Data_Saving.h"
-
-uint8_t TRANSFERS_BEFORE_SWITCH = SD_BUFFER_SIZE / FPGA_BUFFER_SIZE;
-uint8_t SD_buffer_1[SD_BUFFER_SIZE];
-uint8_t SD_buffer_2[SD_BUFFER_SIZE];
-uint8_t SD_buffer_3[SD_BUFFER_SIZE];
-uint8_t SD_buffer_4[SD_BUFFER_SIZE];
-uint8_t SD_buffer_5[SD_BUFFER_SIZE];
-uint8_t SD_buffer_6[SD_BUFFER_SIZE];
-uint8_t SD_buffer_selection = 1;
-uint8_t SD_buffer_counter = 0;
-uint8_t bufferToWrite = 0;
-uint32_t fileWrites = 0;
-
-uint8_t writeQueue[WRITE_QUEUE_MAX_SIZE];
-uint8_t writeQueueSize = 0;
-int8_t writeQueueFirst = 0;
-int8_t writeQueueLast = -1;
+#include "on_board_time.h"
+#include "sd_stats.h"
+#include "FPGA_UART.h"
+#include "storage_manager.h"
+
+// Buffers are filled in pool order, so the queue always holds consecutive indices
+// starting at the buffer the writer task is working on. Each buffer is preceded by
+// the sector its block header is built in.
+static uint8_t SD_buffers[SD_BUFFERS][SD_BLOCK_LEN] __ALIGNED(32);
+uint8_t SD_buffer_selection = 0;
+uint16_t SD_buffer_counter = 0;
+static uint32_t lastSyncTick = 0;
+
+// Single producer (DMA complete interrupt) / single consumer (writer task) queue.
+// Only the producer writes writeQueueTail and only the consumer writes writeQueueHead.
+static SD_write_desc_t writeQueue[WRITE_QUEUE_LEN];
+static volatile uint8_t writeQueueHead = 0;
+static volatile uint8_t writeQueueTail = 0;
+uint32_t writeQueueOverflows = 0;
+uint8_t writeQueueHighWater = 0;
 
 FIL FPGADataFile;
 uint8_t FPGAFileOpen = 0;
 
-uint32_t timeLastEnqueue = 0;
+// Fast capture is used when requested and a contiguous block of FAST_CAPTURE_FILE_SIZE is free,
+// otherwise the file is written through f_write.
+uint8_t FPGAFastCapture = 1;
+static uint8_t fastCaptureActive = 0;
+static DWORD fastCaptureStartSector = 0;
+static DWORD fastCaptureWritten = 0;	// Sectors
+static DWORD fastCaptureSectors = 0;	// Preallocated
+
+static char FPGAFileName[64];
+static uint32_t FPGAFileID = 0;
+static uint32_t FPGABlockSequence = 0;
+static uint8_t FPGARecoveryDone = 0;
+
+// Index sidecar of the current data file, an entry every DBLK_INDEX_INTERVAL blocks
+static FIL FPGAIndexFile;
+static char FPGAIndexName[64];
+static uint8_t FPGAIndexOpen = 0;
+static uint32_t FPGAFileBlocks = 0;
+
+// Write error recovery, see HandleFPGAStream()
+uint8_t FPGAWriterState = SD_WRITER_RUNNING;
+uint8_t FPGABackpressure = 0;
+uint32_t FPGAWriteErrors = 0;
+static uint32_t lostBytesWriter = 0;	// Only written by the writer task, overflows are counted separately
+static uint8_t writeAttempts = 0;
+static uint32_t recoveryTick = 0;
+static uint8_t filesStale = 0;		// Index and FatFs data file still open from the failed write
+static uint8_t remountPending = 0;	// Volume unmounted to drop the locks of the stale files
+
+// Input data rate in bytes/ms, from the completion times of consecutive staging buffers
+static uint64_t timeLastBuffer = 0;
 uint16_t currentDataRate = 0;
 
-extern uint8_t ffuID;
-extern uint8_t unitID;
+// Allocates a contiguous cluster block for an empty file and returns its first sector.
+static FRESULT fastCaptureStart(FIL* fp, FSIZE_t size, DWORD* startSector) {
+	FRESULT result = f_expand(fp, size, 1);
 
-FRESULT openFPGADataFile() {
-	char unit_name[16];
-
-	switch (unitID) {
-	case 0x1A:
-		memcpy(unit_name, "CU", 3);
-		break;
-	case 0x1B:
-		memcpy(unit_name, "EMU_CONTROL", 12);
-		break;
-	case 0x1C:
-		memcpy(unit_name, "EMU_SCIENCE", 12);
-		break;
-	case 0x1D:
-		memcpy(unit_name, "SMILE", 6);
-		break;
-	default:
-		memcpy(unit_name, "UNKNOWN", 8);
-		break;
-	}
+	if (result != FR_OK)
+		return result;
+
+	// Commits the allocation, so data written behind FatFs' back is reachable after a power loss
+	result = f_sync(fp);
+
+	FATFS* fs = fp->obj.fs;
+	*startSector = fs->database + fs->csize * (fp->obj.sclust - 2);
+
+	return result;
+}
 
+static FRESULT fastCaptureWrite(FIL* fp, DWORD sector, const uint8_t* data, UINT sectors) {
+	if (disk_write(fp->obj.fs->drv, data, sector, sectors) != RES_OK)
+		return FR_DISK_ERR;
+
+	return FR_OK;
+}
+
+// Trims the preallocated file to the data actually written and releases the remaining clusters.
+static FRESULT fastCaptureClose(FIL* fp, FSIZE_t written) {
+	FRESULT result = f_lseek(fp, written);
+
+	if (result == FR_OK)
+		result = f_truncate(fp);
+
+	FRESULT closeResult = f_close(fp);
+
+	return (result != FR_OK) ? result : closeResult;
+}
+
+FRESULT openFPGADataFile() {
 	char file_name[64];
-	uint8_t file_no = 0;
 
-	do {
-		sprintf(file_name, "/FFU%d_%s_FPGA_%d.bin", ffuID, unit_name, file_no);
-		file_no++;
-	} while (f_stat((const TCHAR*) file_name, (void*) 0) == FR_OK);
+	// The last file of the previous boot may end in a block cut by a power loss, or in the
+	// stale rest of its preallocation. It is trimmed to its last valid block once per boot.
+	if (!FPGARecoveryDone) {
+		uint32_t lowest = 0;
+		uint32_t previous = 0;
+
+		if (STOR_find_series(STOR_SERIES_FPGA, &lowest, &previous)) {
+			char previousIndex[64];
+			DBLK_scan_t scan;
+
+			STOR_file_name(file_name, STOR_SERIES_FPGA, previous, ".bin");
+			STOR_file_name(previousIndex, STOR_SERIES_FPGA, previous, ".idx");
+			DBLK_recover((const TCHAR*) file_name, (const TCHAR*) previousIndex, 0, &scan);
+		}
+		FPGARecoveryDone = 1;
+	}
+
+	uint32_t file_no = STOR_new_file(STOR_SERIES_FPGA, xTaskGetTickCount());
+	STOR_file_name(file_name, STOR_SERIES_FPGA, file_no, ".bin");
 
+	// Unique per file, so blocks left over from other files are never taken as part of this one.
+	// File numbers come from the FRAM counter and are never reused, even across boots.
+	// Names and ID are all switched before the open, a failed open is retried by the writer
+	// recovery with them and must never reach the files of the previous number.
+	FPGAFileID = file_no;
+	strcpy(FPGAFileName, file_name);
+	STOR_file_name(FPGAIndexName, STOR_SERIES_FPGA, file_no, ".idx");
 	printf(file_name);
 
-	return f_open(&FPGADataFile, (const TCHAR*) file_name, FA_OPEN_ALWAYS | FA_WRITE);
+	FRESULT result = f_open(&FPGADataFile, (const TCHAR*) file_name, FA_OPEN_ALWAYS | FA_WRITE);
+	FPGAFileBlocks = 0;
+
+	// Capture goes on without an index if it cannot be created, it can be rebuilt with a recovery scan
+	if (result == FR_OK)
+		FPGAIndexOpen = (DBLK_index_create(&FPGAIndexFile, (const TCHAR*) FPGAIndexName, FPGAFileID) == FR_OK);
+
+	// Nothing past the rotation size limit is ever written, so nothing more is preallocated
+	FSIZE_t preallocation = FAST_CAPTURE_FILE_SIZE;
+	if (STOR_config.max_size[STOR_SERIES_FPGA] != 0 && STOR_config.max_size[STOR_SERIES_FPGA] < preallocation)
+		preallocation = ((FSIZE_t) STOR_config.max_size[STOR_SERIES_FPGA] / SD_BLOCK_LEN) * SD_BLOCK_LEN;
+
+	fastCaptureActive = 0;
+	if (result == FR_OK && FPGAFastCapture && preallocation >= SD_BLOCK_LEN) {
+		if (fastCaptureStart(&FPGADataFile, preallocation, &fastCaptureStartSector) == FR_OK) {
+			fastCaptureActive = 1;
+			fastCaptureWritten = 0;
+			fastCaptureSectors = preallocation / _MAX_SS;
+		}
+	}
+
+	return result;
+}
+
+FRESULT closeFPGADataFile() {
+	if (FPGAIndexOpen) {
+		FPGAIndexOpen = 0;
+		f_close(&FPGAIndexFile);
+	}
+
+	if (fastCaptureActive) {
+		fastCaptureActive = 0;
+		return fastCaptureClose(&FPGADataFile, (FSIZE_t) fastCaptureWritten * _MAX_SS);
+	}
+
+	return f_close(&FPGADataFile);
 }
 
 void FPGADMATransferCplt() {
+	// Speculative reads may have refilled lines of the slice while the DMA was writing it.
+	// Dropping them again makes the CPU see the DMA data when it computes the payload CRC.
+	DCache_invalidate(SD_buffer(SD_buffer_selection) + SD_buffer_counter*FPGA_BUFFER_SIZE, FPGA_BUFFER_SIZE);
 	SD_buffer_counter++;
 
 	if (SD_buffer_counter == TRANSFERS_BEFORE_SWITCH) {
-		switch (SD_buffer_selection) {
-		case 1:
-			SD_buffer_selection = 2;
-			writeQueueEnqueue(1);
-			break;
-		case 2:
-			SD_buffer_selection = 3;
-			writeQueueEnqueue(2);
-			break;
-		case 3:
-			SD_buffer_selection = 4;
-			writeQueueEnqueue(3);
-			break;
-		case 4:
-			SD_buffer_selection = 5;
-			writeQueueEnqueue(4);
-			break;
-		case 5:
-			SD_buffer_selection = 6;
-			writeQueueEnqueue(5);
-			break;
-		case 6:
-			SD_buffer_selection = 1;
-			writeQueueEnqueue(6);
-			break;
-		}
+		// If the writer still holds every other buffer the filled one is refilled in place,
+		// its data is lost and counted in writeQueueOverflows.
+		if (writeQueueEnqueue(SD_buffer_selection))
+			SD_buffer_selection = (SD_buffer_selection + 1) % SD_BUFFERS;
 
 		SD_buffer_counter = 0;
 	}
 }
 
 void FPGAStartDMATransfer() {
-	switch (SD_buffer_selection) {
-	case 1:
-		HAL_SRAM_Read_DMA(&hsram1, (uint32_t *)0x60000000, (uint32_t *)(SD_buffer_1 + SD_buffer_counter*FPGA_BUFFER_SIZE), FPGA_BUFFER_SIZE);
-		break;
-	case 2:
-		HAL_SRAM_Read_DMA(&hsram1, (uint32_t *)0x60000000, (uint32_t *)(SD_buffer_2 + SD_buffer_counter*FPGA_BUFFER_SIZE), FPGA_BUFFER_SIZE);
-		break;
-	case 3:
-		HAL_SRAM_Read_DMA(&hsram1, (uint32_t *)0x60000000, (uint32_t *)(SD_buffer_3 + SD_buffer_counter*FPGA_BUFFER_SIZE), FPGA_BUFFER_SIZE);
-		break;
-	case 4:
-		HAL_SRAM_Read_DMA(&hsram1, (uint32_t *)0x60000000, (uint32_t *)(SD_buffer_4 + SD_buffer_counter*FPGA_BUFFER_SIZE), FPGA_BUFFER_SIZE);
-		break;
-	case 5:
-		HAL_SRAM_Read_DMA(&hsram1, (uint32_t *)0x60000000, (uint32_t *)(SD_buffer_5 + SD_buffer_counter*FPGA_BUFFER_SIZE), FPGA_BUFFER_SIZE);
-		break;
-	case 6:
-		HAL_SRAM_Read_DMA(&hsram1, (uint32_t *)0x60000000, (uint32_t *)(SD_buffer_6 + SD_buffer_counter*FPGA_BUFFER_SIZE), FPGA_BUFFER_SIZE);
-		break;
-	}
-}
-
-uint8_t writeBuffer(uint8_t bufferNumber) {
+	uint8_t* dest = SD_buffer(SD_buffer_selection) + SD_buffer_counter*FPGA_BUFFER_SIZE;
+
+	// The pool is too large for DTCM and stays cacheable. No line of the slice may be written
+	// back over the DMA data later, the SD write path cleans the buffer before it is sent.
+	// The slice is invalidated again on completion, see FPGADMATransferCplt().
+	DCache_invalidate(dest, FPGA_BUFFER_SIZE);
+	HAL_SRAM_Read_DMA(&hsram1, (uint32_t *)0x60000000, (uint32_t *)dest, FPGA_BUFFER_SIZE);
+}
+
+uint8_t* SD_buffer(uint8_t bufferNumber) {
+	return SD_buffers[bufferNumber] + DBLK_HEADER_LEN;
+}
+
+uint8_t* SD_block(uint8_t bufferNumber) {
+	return SD_buffers[bufferNumber];
+}
+
+// Writes a staging buffer as one block, header sector and payload, to the current data file.
+uint8_t writeBuffer(SD_write_desc_t* desc) {
 	UINT bytesWritten = 0;
 
-	uint8_t* chosenBuffer = 0;
-	switch(bufferNumber) {
-	case 1:
-		chosenBuffer = SD_buffer_1;
-		break;
-	case 2:
-		chosenBuffer = SD_buffer_2;
-		break;
-	case 3:
-		chosenBuffer = SD_buffer_3;
-		break;
-	case 4:
-		chosenBuffer = SD_buffer_4;
-		break;
-	case 5:
-		chosenBuffer = SD_buffer_5;
-		break;
-	case 6:
-		chosenBuffer = SD_buffer_6;
-		break;
-	}
-
-	FRESULT result = f_write(&FPGADataFile, chosenBuffer, SD_BUFFER_SIZE, &bytesWritten);
+	// Capture continues in the next file once the preallocated one is full or the size or age limit
+	// is reached. A file always gets at least one block, whatever the limits.
+	if ((fastCaptureActive && fastCaptureWritten + SD_BLOCK_SECTORS > fastCaptureSectors) ||
+			(FPGAFileBlocks > 0 && STOR_rotation_due(STOR_SERIES_FPGA, (FSIZE_t) (FPGAFileBlocks + 1) * SD_BLOCK_LEN, xTaskGetTickCount()))) {
+		closeFPGADataFile();
+		FRESULT result = openFPGADataFile();
+
+		if (result != FR_OK)
+			return result;
+	}
+
+	// Built here rather than once per buffer, the file ID changes when the file does
+	DBLK_fill_header(SD_block(desc->buffer), FPGAFileID, FPGABlockSequence, desc->timeUs,
+			SD_buffer(desc->buffer), SD_BUFFER_SIZE, writeQueueOverflows);
+
+	uint32_t start = SDS_start();
+
+	if (fastCaptureActive) {
+		FRESULT result = fastCaptureWrite(&FPGADataFile, fastCaptureStartSector + fastCaptureWritten, SD_block(desc->buffer), SD_BLOCK_SECTORS);
+		SDS_record(&SD_stats.write, start);
+
+		if (result == FR_OK)
+			fastCaptureWritten += SD_BLOCK_SECTORS;
+
+		return result;
+	}
+
+	FRESULT result = f_write(&FPGADataFile, SD_block(desc->buffer), SD_BLOCK_LEN, &bytesWritten);
+	SDS_record(&SD_stats.write, start);
 
 	return result;
 }
 
-void writeQueueEnqueue(uint8_t bufferno) {
-	// Measures the time it takes for a SD write buffer to fill up and calculates the data rate - should probably moved somewhere else.
-	uint32_t timeThisEnqueue = xTaskGetTickCount();
-	currentDataRate = SD_BUFFER_SIZE / (timeThisEnqueue - timeLastEnqueue);
-	timeLastEnqueue = timeThisEnqueue;
+// Called from the DMA complete interrupt only. Returns 0 and counts an overflow if the queue is full.
+uint8_t writeQueueEnqueue(uint8_t bufferno) {
+	uint8_t tail = writeQueueTail;
+	uint8_t next = (tail + 1) % WRITE_QUEUE_LEN;
+
+	if (next == writeQueueHead) {
+		writeQueueOverflows++;
+		return 0;
+	}
 
-	// Actual write queue stuff
-	if (writeQueueSize < WRITE_QUEUE_MAX_SIZE) {
-		if (writeQueueLast == WRITE_QUEUE_MAX_SIZE - 1)
-			writeQueueLast = -1;
+	writeQueue[tail].buffer = bufferno;
+	writeQueue[tail].timeUs = OBT_get_us();
 
-		writeQueue[++writeQueueLast] = bufferno;
-		writeQueueSize++;
+	// The descriptor must be visible before the consumer sees the new tail
+	__DMB();
+	writeQueueTail = next;
+
+	uint8_t depth = (next + WRITE_QUEUE_LEN - writeQueueHead) % WRITE_QUEUE_LEN;
+	if (depth > writeQueueHighWater)
+		writeQueueHighWater = depth;
+
+	return 1;
+}
+
+// Called from the writer task only. The buffer stays owned by the writer until writeQueueRelease().
+uint8_t writeQueuePeek(SD_write_desc_t* desc) {
+	uint8_t head = writeQueueHead;
+
+	if (head == writeQueueTail)
+		return 0;
+
+	__DMB();
+	*desc = writeQueue[head];
+
+	return 1;
+}
+
+// Called from the writer task only, hands the buffer at the head of the queue back to the pool.
+void writeQueueRelease(void) {
+	uint8_t head = writeQueueHead;
+
+	if (head == writeQueueTail)
+		return;
+
+	// The buffer must be completely read before the producer may refill it
+	__DMB();
+	writeQueueHead = (head + 1) % WRITE_QUEUE_LEN;
+}
+
+// Staging buffer bytes that never made it to the card, dropped on overflow or given up after write errors
+uint32_t FPGALostBytes(void) {
+	return writeQueueOverflows * SD_BUFFER_SIZE + lostBytesWriter;
+}
+
+uint8_t writeQueueCount(void) {
+	uint8_t tail = writeQueueTail;
+	uint8_t head = writeQueueHead;
+
+	return (tail + WRITE_QUEUE_LEN - head) % WRITE_QUEUE_LEN;
+}
+
+// Tells the FPGA to pause or resume streaming, only sent when the state changes
+static void setBackpressure(uint8_t on) {
+	if (on == FPGABackpressure)
+		return;
+
+	// UART5 is a terminal in console mode, the FPGA is not listening
+	if (!console_enabled) {
+		uint8_t msg[5] = {0xB5, 0x43, FPGA_MESSAGE_FLOW_CONTROL, on, 0x0A};
+
+		if (FPGA_Transmit_Binary(msg, 5) != HAL_OK)
+			return;
+	}
+	FPGABackpressure = on;
+}
+
+/*
+ * Called once the card answers again. With _FS_LOCK the file objects of the failed write still hold
+ * their locks, and f_close only releases a lock once its final flush succeeds, so the same path
+ * could never be opened again. They are closed now that the card is back. If that still fails the
+ * volume is remounted, which drops every lock and every file object on it, the uC file included.
+ * A fast capture data file is not written through FatFs and is only reopened after a remount.
+ */
+static FRESULT releaseStaleFiles() {
+	if (filesStale) {
+		FRESULT result = fastCaptureActive ? FR_OK : f_close(&FPGADataFile);
+
+		if (FPGAIndexOpen) {
+			FRESULT indexResult = f_close(&FPGAIndexFile);
+
+			if (result == FR_OK || result == FR_INVALID_OBJECT)
+				result = indexResult;
+			FPGAIndexOpen = 0;
+		}
+
+		// An invalid object holds no lock, e.g. a rotation that failed to open the next file
+		if (result != FR_OK && result != FR_INVALID_OBJECT) {
+			f_mount(0, (const TCHAR*) SDPath, 0);
+			remountPending = 1;
+		}
+		filesStale = 0;
 	}
+
+	if (remountPending) {
+		FRESULT result = f_mount(&SDFatFS, (const TCHAR*) SDPath, 1);
+		if (result == FR_OK && fastCaptureActive)
+			result = f_open(&FPGADataFile, (const TCHAR*) FPGAFileName, FA_WRITE);
+		if (result != FR_OK)
+			return result;
+
+		remountPending = 0;
+		if (uCFileOpen)
+			uCFileOpen = (openUCDataFile() == FR_OK);
+	}
+
+	return FR_OK;
 }
 
-uint8_t writeQueueDequeue(void) {
-	uint8_t value;
+// Buffers written since the last sync may be gone after the card is reinitialised, the file
+// continues after its last whole block on the card and the lost blocks show up as a sequence gap.
+// A fast capture file is preallocated, the blocks written so far are all still on the card.
+static FRESULT reopenFPGADataFile() {
+	uint32_t blocks = FPGAFileBlocks;
+
+	if (!fastCaptureActive) {
+		FRESULT result = f_open(&FPGADataFile, (const TCHAR*) FPGAFileName, FA_OPEN_ALWAYS | FA_WRITE);
+		if (result != FR_OK)
+			return result;
+
+		blocks = f_size(&FPGADataFile) / SD_BLOCK_LEN;
+		result = f_lseek(&FPGADataFile, (FSIZE_t) blocks * SD_BLOCK_LEN);
+		if (result != FR_OK) {
+			f_close(&FPGADataFile);
+			return result;
+		}
+
+		if (blocks < FPGAFileBlocks)
+			lostBytesWriter += (FPGAFileBlocks - blocks) * SD_BUFFER_SIZE;
+		FPGAFileBlocks = blocks;
+	}
 
-	if (writeQueueSize != 0) {
-		value = writeQueue[writeQueueFirst++];
-		writeQueueSize--;
+	// A data file without blocks, e.g. after a rotation that failed to open it, gets a new index
+	if (!FPGAIndexOpen && blocks == 0) {
+		FPGAIndexOpen = (DBLK_index_create(&FPGAIndexFile, (const TCHAR*) FPGAIndexName, FPGAFileID) == FR_OK);
+		return FR_OK;
 	}
-	else
-		value = 0;
 
-	if (writeQueueFirst == WRITE_QUEUE_MAX_SIZE)
-		writeQueueFirst = 0;
+	// Entries past the data are dropped, the index may have been synced later than the data
+	if (!FPGAIndexOpen && f_open(&FPGAIndexFile, (const TCHAR*) FPGAIndexName, FA_OPEN_ALWAYS | FA_WRITE) == FR_OK) {
+		uint32_t entries = (blocks + DBLK_INDEX_INTERVAL - 1) / DBLK_INDEX_INTERVAL;
+
+		if (f_lseek(&FPGAIndexFile, sizeof(DBLK_index_header_t) + entries * sizeof(DBLK_index_entry_t)) == FR_OK &&
+				f_truncate(&FPGAIndexFile) == FR_OK)
+			FPGAIndexOpen = 1;
+		else
+			f_close(&FPGAIndexFile);
+	}
 
-	return value;
+	return FR_OK;
 }
 
-uint8_t writeQueuePeek(void) {
-	return writeQueue[writeQueueFirst];
+static void writeSucceeded(SD_write_desc_t* desc) {
+	// The entry is taken from the header just written, so it always matches the data file
+	if (FPGAIndexOpen && FPGAFileBlocks % DBLK_INDEX_INTERVAL == 0)
+		DBLK_index_add(&FPGAIndexFile, (const DBLK_header_t*) SD_block(desc->buffer), FPGAFileBlocks * SD_BLOCK_LEN);
+
+	FPGABlockSequence++;
+	FPGAFileBlocks++;
+
+	// Decides how often to flush data to the SD card. Blocks written through f_write since the
+	// last flush are lost on a power loss. Fast capture data is already on the card and there
+	// is no FAT state to flush, only the index, which DBLK_recover rebuilds from the blocks.
+	if (xTaskGetTickCount() - lastSyncTick >= (fastCaptureActive ? SD_FAST_SYNC_INTERVAL : SD_SYNC_INTERVAL)) {
+		if (!fastCaptureActive) {
+			uint32_t start = SDS_start();
+			f_sync(&FPGADataFile);
+			SDS_record(&SD_stats.sync, start);
+		}
+		if (FPGAIndexOpen)
+			f_sync(&FPGAIndexFile);
+		lastSyncTick = xTaskGetTickCount();
+	}
 }
 
+/*
+ * Writer state machine, one step per call so the main loop keeps running while the card is down.
+ * RUNNING:	writes the buffer at the head of the queue. On an error the buffer stays queued.
+ * REINIT:	reinitialises the card every SD_RECOVERY_INTERVAL until it answers.
+ * REOPEN:	releases the file objects of the failed write, reopens the data file and its index at
+ * 			the last whole block on the card, then retries.
+ * A buffer is only given up after SD_WRITE_MAX_ATTEMPTS failed writes on a card that came back.
+ * Meanwhile the queue fills up, backpressure pauses the FPGA and whatever it still sends is
+ * counted as lost.
+ */
 void HandleFPGAStream() {
-	  if (FPGAFileOpen) {
-		  if (writeQueueSize) {
-			  bufferToWrite = writeQueueDequeue();
-
-			  uint8_t attemptsRemaining = 2;
-			  FRESULT writeResult = 1;
-
-			  while (attemptsRemaining && writeResult != FR_OK) {
-
-				  HAL_GPIO_WritePin(LED3_GPIO_Port, LED3_Pin, GPIO_PIN_SET);
-				  writeResult = writeBuffer(bufferToWrite);
-				  HAL_GPIO_WritePin(LED3_GPIO_Port, LED3_Pin, GPIO_PIN_RESET);
-
-				  switch (writeResult) {
-				  case FR_OK:
-						fileWrites++;
-
-						// Decides how often to flush data to the SD card. Important in case of for example a power loss.
-						// Value is how many buffers before a flush, multiply with buffer size to get flush size.
-						if (fileWrites >= BUFFERS_BEFORE_FLUSH) {
-							f_sync(&FPGADataFile);
-							fileWrites = 0;
-						}
-						break;
-				  default:
-					  f_close(&FPGADataFile);
-					  BSP_SD_Init();
-
-					  if (f_open(&FPGADataFile, "/FPGA.bin", FA_OPEN_APPEND | FA_WRITE) != FR_OK)
-						  HAL_GPIO_WritePin(LED4_GPIO_Port, LED4_Pin, GPIO_PIN_SET);
-
-					  attemptsRemaining--;
-					  break;
-				  }
-			  }
+	  if (!FPGAFileOpen)
+		  return;
+
+	  uint8_t queued = writeQueueCount();
+	  if (queued >= WRITE_QUEUE_LEN - 1 - SD_BACKPRESSURE_ON)
+		  setBackpressure(1);
+	  else if (queued <= WRITE_QUEUE_LEN - 1 - SD_BACKPRESSURE_OFF)
+		  setBackpressure(0);
+
+	  switch (FPGAWriterState) {
+	  case SD_WRITER_RUNNING: {
+		  SD_write_desc_t desc;
+
+		  if (!writeQueuePeek(&desc))
+			  break;
+
+		  // Buffers dropped on overflow make the interval longer, the rate is then a lower bound
+		  if (timeLastBuffer != 0 && desc.timeUs > timeLastBuffer)
+			  currentDataRate = (uint16_t) (((uint64_t) SD_BUFFER_SIZE * 1000) / (desc.timeUs - timeLastBuffer));
+		  timeLastBuffer = desc.timeUs;
+
+		  HAL_GPIO_WritePin(LED3_GPIO_Port, LED3_Pin, GPIO_PIN_SET);
+		  FRESULT writeResult = writeBuffer(&desc);
+		  HAL_GPIO_WritePin(LED3_GPIO_Port, LED3_Pin, GPIO_PIN_RESET);
+
+		  if (writeResult == FR_OK) {
+			  writeSucceeded(&desc);
+			  writeAttempts = 0;
+			  writeQueueRelease();
+			  HAL_GPIO_WritePin(LED4_GPIO_Port, LED4_Pin, GPIO_PIN_RESET);
+			  break;
+		  }
+
+		  FPGAWriteErrors++;
+		  if (++writeAttempts >= SD_WRITE_MAX_ATTEMPTS) {
+			  // Most likely not the card but the file system, e.g. a full card, so it is not retried forever
+			  writeAttempts = 0;
+			  lostBytesWriter += SD_BUFFER_SIZE;
+			  writeQueueRelease();
 		  }
+
+		  // Files written through FatFs cannot be flushed to a failing card, they are released once it is back.
+		  // A fast capture file stays open, its sectors are written directly and are still allocated.
+		  filesStale = 1;
+
+		  HAL_GPIO_WritePin(LED4_GPIO_Port, LED4_Pin, GPIO_PIN_SET);
+		  recoveryTick = xTaskGetTickCount() - SD_RECOVERY_INTERVAL;
+		  FPGAWriterState = SD_WRITER_REINIT;
+		  break;
+	  }
+	  case SD_WRITER_REINIT:
+		  if (xTaskGetTickCount() - recoveryTick < SD_RECOVERY_INTERVAL)
+			  break;
+
+		  recoveryTick = xTaskGetTickCount();
+		  if (BSP_SD_Init() == MSD_OK)
+			  FPGAWriterState = SD_WRITER_REOPEN;
+		  break;
+	  case SD_WRITER_REOPEN:
+		  if (releaseStaleFiles() == FR_OK && reopenFPGADataFile() == FR_OK)
+			  FPGAWriterState = SD_WRITER_RUNNING;
+		  else
+			  FPGAWriterState = SD_WRITER_REINIT;
+		  break;
+	  default:
+		  FPGAWriterState = SD_WRITER_RUNNING;
+		  break;
 	  }
 }
+
+// Writes SD_BENCH_BUFFERS staging buffers to a scratch file, either through f_write with an f_sync
+// after every buffer like the FAT capture path or straight to a preallocated file like fast capture.
+// Returns the total time and the worst single buffer write in us. Capture must be stopped.
+FRESULT SD_benchmark(uint8_t fast, uint32_t* totalUs, uint32_t* worstUs) {
+	FIL benchFile;
+	DWORD startSector = 0;
+	uint64_t worst = 0;
+
+	if (FPGAFileOpen)
+		return FR_DENIED;
+
+	FRESULT result = f_open(&benchFile, "/SDBENCH.bin", FA_CREATE_ALWAYS | FA_WRITE);
+
+	if (result != FR_OK)
+		return result;
+
+	if (fast)
+		result = fastCaptureStart(&benchFile, (FSIZE_t) SD_BENCH_BUFFERS * SD_BUFFER_SIZE, &startSector);
+
+	uint64_t start = OBT_get_us();
+
+	for (uint16_t i = 0; i < SD_BENCH_BUFFERS && result == FR_OK; i++) {
+		uint64_t writeStart = OBT_get_us();
+
+		if (fast) {
+			result = fastCaptureWrite(&benchFile, startSector + i * SD_BUFFER_SECTORS, SD_buffer(i % SD_BUFFERS), SD_BUFFER_SECTORS);
+		}
+		else {
+			UINT bytesWritten = 0;
+			result = f_write(&benchFile, SD_buffer(i % SD_BUFFERS), SD_BUFFER_SIZE, &bytesWritten);
+			if (result == FR_OK)
+				result = f_sync(&benchFile);
+		}
+
+		uint64_t writeTime = OBT_get_us() - writeStart;
+		if (writeTime > worst)
+			worst = writeTime;
+	}
+
+	*totalUs = (uint32_t) (OBT_get_us() - start);
+	*worstUs = (uint32_t) worst;
+
+	f_close(&benchFile);
+	f_unlink("/SDBENCH.bin");
+
+	return result;
+}
@@ -1,7 +1,7 @@
 #include <FPGA_UART.h>
 
-uint8_t FPGARxBuffer[FPGA_RX_BUFFER_SIZE];
-uint8_t FPGATxBuffer[FPGA_TX_BUFFER_SIZE];
+DMA_BUFFER uint8_t FPGARxBuffer[FPGA_RX_BUFFER_SIZE];
+DMA_BUFFER uint8_t FPGATxBuffer[FPGA_TX_BUFFER_SIZE];
 uint8_t FPGAMessage[FPGA_RX_BUFFER_SIZE];
 uint8_t console_enabled = 0;
 uint8_t FPGAReceivedMessage = 0;
@@ -92,9 +92,9 @@ void FPGA_Transmit(const char* tx_string) {
 	HAL_UART_Transmit(&huart5, FPGATxBuffer, strlen(tx_string), 50);
 }
 
-void FPGA_Transmit_Binary(uint8_t* tx_data, size_t length) {
+HAL_StatusTypeDef FPGA_Transmit_Binary(uint8_t* tx_data, size_t length) {
 	memcpy(FPGATxBuffer, tx_data, length);
-	HAL_UART_Transmit(&huart5, FPGATxBuffer, length, 50);
+	return HAL_UART_Transmit(&huart5, FPGATxBuffer, length, 50);
 }
 
 void FPGA_Transmit_Binary_DMA(uint8_t* tx_data, size_t length) {
@@ -144,7 +144,7 @@ void HandleConsole() {
 		  FPGA_Transmit("\n\r\n\rClosing FPGA & uC data files...\n\r");
 		  FPGAFileOpen = 0;
 		  uCFileOpen = 0;
-		  f_close(&FPGADataFile);
+		  closeFPGADataFile();
 		  f_close(&uCDataFile);
 		  FPGA_Transmit("Formatting SD card...\n\r");
 
@@ -527,6 +527,154 @@ void HandleConsole() {
 		  FPGA_Transmit(str);
 		  HAL_UART_Receive_DMA(&huart5, FPGARxBuffer, 1);
 	  }
+	  else if (strcmp(cmd, "sdbench") == 0) {
+		  char str[256];
+
+		  sprintf(str, "\n\r\n\rBenchmarking SD card writes at speed level %u (%lu fallbacks)...\n\r\n\r",
+				  BSP_SD_GetSpeed(), BSP_SD_GetFallbacks());
+		  FPGA_Transmit(str);
+		  FPGA_Transmit("Mode\t\tMB/s\t\tWorst write (us)\n\r");
+
+		  for (uint8_t fast = 0; fast <= 1; fast++) {
+			  uint32_t totalUs = 0;
+			  uint32_t worstUs = 0;
+			  FRESULT result = SD_benchmark(fast, &totalUs, &worstUs);
+
+			  if (result != FR_OK || totalUs == 0) {
+				  sprintf(str, "%s\t\tError %d\n\r", fast ? "Fast" : "FAT", result);
+			  }
+			  else {
+				  // Bytes per us is MB/s, scaled by 100 for two decimals
+				  uint32_t rate = (uint32_t) ((uint64_t) SD_BENCH_BUFFERS * SD_BUFFER_SIZE * 100 / totalUs);
+				  sprintf(str, "%s\t\t%lu.%02lu\t\t%lu\n\r", fast ? "Fast" : "FAT", rate / 100, rate % 100, worstUs);
+			  }
+			  FPGA_Transmit(str);
+		  }
+
+		  FPGA_Transmit("\n\r> ");
+		  HAL_UART_Receive_DMA(&huart5, FPGARxBuffer, 1);
+	  }
+	  else if (strcmp(cmd, "sdstats") == 0) {
+		  char str[256];
+
+		  if (arg1 != 0 && strcmp(arg1, "reset") == 0) {
+			  SDS_reset();
+			  writeQueueHighWater = 0;
+			  FPGA_Transmit("\n\r\n\rSD writer statistics cleared.\n\r\n\r> ");
+		  }
+		  else {
+			  sprintf(str, "\n\r\n\rQueue %u/%u, high water %u, %lu overflows, input %u bytes/ms\n\r",
+					  writeQueueCount(), WRITE_QUEUE_LEN - 1, writeQueueHighWater, writeQueueOverflows, currentDataRate);
+			  FPGA_Transmit(str);
+			  sprintf(str, "Writer state %u, backpressure %u, %lu write errors, %lu bytes lost\n\r",
+					  FPGAWriterState, FPGABackpressure, FPGAWriteErrors, FPGALostBytes());
+			  FPGA_Transmit(str);
+			  sprintf(str, "Block writes: %lu, mean %lu us, max %lu us\n\rSyncs: %lu, mean %lu us, max %lu us\n\r\n\r",
+					  SD_stats.write.count, SDS_mean_us(&SD_stats.write), SD_stats.write.max_us,
+					  SD_stats.sync.count, SDS_mean_us(&SD_stats.sync), SD_stats.sync.max_us);
+			  FPGA_Transmit(str);
+			  FPGA_Transmit("From (us)\tWrites\t\tSyncs\n\r");
+
+			  for (uint8_t i = 0; i < SDS_HIST_BUCKETS; i++) {
+				  sprintf(str, "%lu\t\t%lu\t\t%lu\n\r", SDS_bucket_floor_us(i), SD_stats.write.buckets[i], SD_stats.sync.buckets[i]);
+				  FPGA_Transmit(str);
+			  }
+			  FPGA_Transmit("\n\r> ");
+		  }
+
+		  HAL_UART_Receive_DMA(&huart5, FPGARxBuffer, 1);
+	  }
+	  else if (strcmp(cmd, "storage") == 0) {
+		  char str[256];
+
+		  // storage <fpga|uc> <max MB> <max minutes> or storage watermark <low MB> <high MB>, 0 is no limit
+		  if (arg1 != 0 && arg2 != 0 && arg3 != 0) {
+			  uint32_t a = strtoul(arg2, NULL, 10);
+			  uint32_t b = strtoul(arg3, NULL, 10);
+
+			  if (strcmp(arg1, "fpga") == 0 || strcmp(arg1, "uc") == 0) {
+				  uint8_t series = (strcmp(arg1, "fpga") == 0) ? STOR_SERIES_FPGA : STOR_SERIES_UC;
+				  STOR_config.max_size[series] = a * 1024 * 1024;
+				  STOR_config.max_age[series] = b * 60 * 1000;
+			  }
+			  else if (strcmp(arg1, "watermark") == 0 && b >= a) {
+				  STOR_config.low_watermark = a * 1024;
+				  STOR_config.high_watermark = b * 1024;
+			  }
+		  }
+
+		  STOR_update_usage();
+		  sprintf(str, "\n\r\n\rCard %lu MB, %lu MB free, reclaiming below %lu MB up to %lu MB%s\n\r",
+				  STOR_stats.total_kB / 1024, STOR_stats.free_kB / 1024, STOR_config.low_watermark / 1024,
+				  STOR_config.high_watermark / 1024, STOR_stats.reclaiming ? " (active)" : "");
+		  FPGA_Transmit(str);
+		  sprintf(str, "FPGA files up to %lu MB / %lu min, uC files up to %lu MB / %lu min\n\r",
+				  STOR_config.max_size[STOR_SERIES_FPGA] / (1024 * 1024), STOR_config.max_age[STOR_SERIES_FPGA] / 60000,
+				  STOR_config.max_size[STOR_SERIES_UC] / (1024 * 1024), STOR_config.max_age[STOR_SERIES_UC] / 60000);
+		  FPGA_Transmit(str);
+		  sprintf(str, "%lu rotations, %lu files deleted, %lu MB reclaimed\n\r\n\r> ",
+				  STOR_stats.rotations, STOR_stats.files_deleted, STOR_stats.kB_reclaimed / 1024);
+		  FPGA_Transmit(str);
+
+		  HAL_UART_Receive_DMA(&huart5, FPGARxBuffer, 1);
+	  }
+	  else if (strcmp(cmd, "recover") == 0) {
+		  char str[256];
+
+		  if (arg1 == 0) {
+			  FPGA_Transmit("\n\r\n\rUsage: recover <file> [full]\n\r\n\r> ");
+		  }
+		  else {
+			  DBLK_scan_t scan;
+			  uint8_t full = (arg2 != 0 && strcmp(arg2, "full") == 0);
+			  char index[64];
+			  char* indexPath = 0;
+
+			  // The index of <name>.bin is <name>.idx, other files are scanned without rebuilding one
+			  strncpy(index, arg1, sizeof(index) - 1);
+			  index[sizeof(index) - 1] = 0;
+			  char* ext = strrchr(index, '.');
+			  if (ext != 0 && strcmp(ext, ".bin") == 0) {
+				  strcpy(ext, ".idx");
+				  indexPath = index;
+			  }
+
+			  FPGA_Transmit("\n\r\n\rScanning data blocks...\n\r");
+			  FRESULT result = DBLK_recover((const TCHAR*) arg1, (const TCHAR*) indexPath, full, &scan);
+
+			  if (result != FR_OK)
+				  sprintf(str, "Error %d while recovering %s.\n\r\n\r> ", result, arg1);
+			  else
+				  sprintf(str, "%lu valid blocks, sequence %lu - %lu, %lu missing, %lu of %lu bytes kept, stop reason %u.\n\r\n\r> ",
+						  scan.blocks, scan.first_sequence, scan.last_sequence, scan.missing,
+						  (scan.blocks > 0) ? scan.valid_len : scan.file_len, scan.file_len, scan.stop_reason);
+			  FPGA_Transmit(str);
+		  }
+
+		  HAL_UART_Receive_DMA(&huart5, FPGARxBuffer, 1);
+	  }
+	  else if (strcmp(cmd, "index") == 0) {
+		  char str[256];
+
+		  if (arg1 == 0 || arg2 == 0) {
+			  FPGA_Transmit("\n\r\n\rUsage: index <index file> <time us>\n\r\n\r> ");
+		  }
+		  else {
+			  DBLK_index_entry_t entry;
+			  uint32_t entries = 0;
+			  FRESULT result = DBLK_index_find((const TCHAR*) arg1, strtoull(arg2, NULL, 10), &entry, &entries);
+
+			  if (result != FR_OK)
+				  sprintf(str, "\n\r\n\rError %d while reading %s.\n\r\n\r> ", result, arg1);
+			  else
+				  sprintf(str, "\n\r\n\r%lu entries, closest block %lu at offset %lu, time %llu us, first sample %ld, %lu overflows.\n\r\n\r> ",
+						  entries, entry.sequence, entry.offset, entry.time_us,
+						  (entry.sample_seq == DBLK_NO_SAMPLE_SEQ) ? -1L : (long) entry.sample_seq, entry.overflows);
+			  FPGA_Transmit(str);
+		  }
+
+		  HAL_UART_Receive_DMA(&huart5, FPGARxBuffer, 1);
+	  }
 	  else if (strcmp(cmd, "spp_message") == 0 ) {
 		  if (arg1 == 0) {
 			  FPGA_Transmit("\n\r\n\rMissing message\n\r\n\r>");
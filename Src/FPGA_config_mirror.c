@@ -0,0 +1,166 @@
+/*
+ * FPGA_config_mirror.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "FPGA_config_mirror.h"
+
+/*  Local copy of the FPGA Langmuir configuration registers. Updated on every SET sent to
+ *  the FPGA and on every readback, so GETs can be answered without a UART round trip.
+ *  A register is only served from the mirror once its value is known (valid bit set).
+ */
+typedef struct {
+    uint16_t CB_vol_lvl[FPGA_MIRROR_N_PROBES];
+    uint16_t SWT_vol_lvl[FPGA_MIRROR_N_PROBES][FPGA_MIRROR_N_SWT_STEPS];
+    uint16_t scalars[NOF_FPGA_REGS];    // Indexed by FPGA_Reg_t, only the scalar registers are used.
+
+    uint8_t  CB_valid;                  // One bit per probe
+    uint32_t SWT_valid[FPGA_MIRROR_N_PROBES][FPGA_MIRROR_N_SWT_STEPS / 32];
+    uint16_t scalars_valid;             // One bit per FPGA_Reg_t
+} FPGA_config_mirror_t;
+
+static FPGA_config_mirror_t FPGA_mirror = {0};
+
+/*  Bulk refresh position: the CB voltage of every probe, then every sweep table step of every
+ *  probe. The GETs themselves are sent by refresh_FPGA_config_mirror().
+ */
+#define BULK_REFRESH_CB_START       0
+#define BULK_REFRESH_SWT_START      FPGA_MIRROR_N_PROBES
+#define BULK_REFRESH_END            (BULK_REFRESH_SWT_START + FPGA_MIRROR_N_PROBES * FPGA_MIRROR_N_SWT_STEPS)
+
+static uint16_t bulk_refresh_pos = BULK_REFRESH_END;
+
+bool     FPGA_mirror_verify = false;
+uint32_t FPGA_mirror_mismatch_cnt = 0;
+
+
+static uint16_t get_set_value(uint8_t reg, FPGA_msg_arg_t* fpgama) {
+    switch (reg) {
+        case FPGA_REG_CB_VOL_LVL:
+        case FPGA_REG_SWT_VOL_LVL:              return fpgama->voltage_level;
+        case FPGA_REG_SWT_STEPS:                return fpgama->N_steps;
+        case FPGA_REG_SWT_SAMPLES_PER_STEP:     return fpgama->N_samples_per_step;
+        case FPGA_REG_SWT_SAMPLE_SKIP:          return fpgama->N_skip;
+        case FPGA_REG_SWT_SAMPLES_PER_POINT:    return fpgama->N_f;
+        case FPGA_REG_SWT_NPOINTS:              return fpgama->N_points;
+        default:                                return 0;
+    }
+}
+
+
+void FPGA_mirror_store(uint8_t reg, FPGA_msg_arg_t* fpgama, uint16_t value) {
+    uint8_t probe = fpgama->probe_ID;
+    uint8_t step = fpgama->step_ID;
+
+    switch (reg) {
+        case FPGA_REG_NONE:
+            break;
+        case FPGA_REG_CB_VOL_LVL:
+            if (probe < FPGA_MIRROR_N_PROBES) {
+                FPGA_mirror.CB_vol_lvl[probe] = value;
+                FPGA_mirror.CB_valid |= (1 << probe);
+            }
+            break;
+        case FPGA_REG_SWT_VOL_LVL:
+            if (probe < FPGA_MIRROR_N_PROBES) {
+                FPGA_mirror.SWT_vol_lvl[probe][step] = value;
+                FPGA_mirror.SWT_valid[probe][step >> 5] |= (1UL << (step & 0x1F));
+            }
+            break;
+        default:
+            if (reg < NOF_FPGA_REGS) {
+                FPGA_mirror.scalars[reg] = value;
+                FPGA_mirror.scalars_valid |= (1 << reg);
+            }
+            break;
+    }
+}
+
+
+void FPGA_mirror_store_set(uint8_t reg, FPGA_msg_arg_t* fpgama) {
+    FPGA_mirror_store(reg, fpgama, get_set_value(reg, fpgama));
+}
+
+
+bool FPGA_mirror_lookup(uint8_t reg, FPGA_msg_arg_t* fpgama, uint16_t* value) {
+    uint8_t probe = fpgama->probe_ID;
+    uint8_t step = fpgama->step_ID;
+
+    switch (reg) {
+        case FPGA_REG_NONE:
+            return false;
+        case FPGA_REG_CB_VOL_LVL:
+            if (probe >= FPGA_MIRROR_N_PROBES || !(FPGA_mirror.CB_valid & (1 << probe))) {
+                return false;
+            }
+            *value = FPGA_mirror.CB_vol_lvl[probe];
+            return true;
+        case FPGA_REG_SWT_VOL_LVL:
+            if (probe >= FPGA_MIRROR_N_PROBES || !(FPGA_mirror.SWT_valid[probe][step >> 5] & (1UL << (step & 0x1F)))) {
+                return false;
+            }
+            *value = FPGA_mirror.SWT_vol_lvl[probe][step];
+            return true;
+        default:
+            if (reg >= NOF_FPGA_REGS || !(FPGA_mirror.scalars_valid & (1 << reg))) {
+                return false;
+            }
+            *value = FPGA_mirror.scalars[reg];
+            return true;
+    }
+}
+
+
+// Compares a value read back from the FPGA with the mirror and adopts the FPGA value.
+// Returns false on a mismatch.
+bool FPGA_mirror_compare(uint8_t reg, FPGA_msg_arg_t* fpgama, uint16_t FPGA_value) {
+    uint16_t mirror_value;
+    bool match = true;
+    if (FPGA_mirror_lookup(reg, fpgama, &mirror_value) && mirror_value != FPGA_value) {
+        FPGA_mirror_mismatch_cnt++;
+        match = false;
+    }
+    FPGA_mirror_store(reg, fpgama, FPGA_value);
+    return match;
+}
+
+
+// Forgets every mirrored value, for when the FPGA was reset or reconfigured, and reloads them.
+void FPGA_mirror_invalidate() {
+    FPGA_mirror.CB_valid = 0;
+    FPGA_mirror.scalars_valid = 0;
+    memset(FPGA_mirror.SWT_valid, 0, sizeof(FPGA_mirror.SWT_valid));
+    FPGA_mirror_request_refresh();
+}
+
+
+void FPGA_mirror_request_refresh() {
+    bulk_refresh_pos = BULK_REFRESH_CB_START;
+}
+
+
+void FPGA_mirror_stop_refresh() {
+    bulk_refresh_pos = BULK_REFRESH_END;
+}
+
+
+// Next GET of a pending bulk refresh. Returns false once every register has been requested.
+bool FPGA_mirror_next_refresh(uint8_t* func_id, FPGA_msg_arg_t* fpgama) {
+    if (bulk_refresh_pos >= BULK_REFRESH_END) {
+        return false;
+    }
+    memset(fpgama, 0, sizeof(FPGA_msg_arg_t));
+    fpgama->target = GS_FPGA_TARGET;
+
+    if (bulk_refresh_pos < BULK_REFRESH_SWT_START) {
+        *func_id = FPGA_GET_CB_VOL_LVL;
+        fpgama->probe_ID = bulk_refresh_pos - BULK_REFRESH_CB_START;
+    } else {
+        *func_id = FPGA_GET_SWT_VOL_LVL;
+        fpgama->probe_ID = (bulk_refresh_pos - BULK_REFRESH_SWT_START) / FPGA_MIRROR_N_SWT_STEPS;
+        fpgama->step_ID = (bulk_refresh_pos - BULK_REFRESH_SWT_START) % FPGA_MIRROR_N_SWT_STEPS;
+    }
+    bulk_refresh_pos++;
+    return true;
+}
@@ -23,7 +23,7 @@ void SendTelemetry() {
 	uint16_t ch_3 = ((uint16_t) (fpga1p5v * 100)) & 0x0FFF;
 	uint16_t ch_4 = ((uint16_t) (uc3v * 100)) & 0x0FFF;
 	uint16_t ch_5 = currentDataRate & 0x0FFF;
-	uint16_t ch_6 = writeQueueSize;
+	uint16_t ch_6 = writeQueueCount();
 	uint16_t ch_7 = 0;
 	uint16_t ch_8 = 0;
 	uint16_t ch_9 = 0;
@@ -0,0 +1,174 @@
+/*
+ * IV_analysis.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "IV_analysis.h"
+#include <math.h>
+
+/*  Langmuir probe I-V curve analysis of a single sweep, in single precision float.
+ *
+ *  1. V_f:  first zero crossing of the probe current, linearly interpolated.
+ *  2. I_is: least squares line through the ion saturation region (lowest
+ *           IV_ION_FIT_FRACTION of the bias range), evaluated at V_f.
+ *  3. V_p:  bias of the largest dI/dV above V_f.
+ *  4. T_e:  electron current I_e = I - ion fit. In the retardation region V_f < V < V_p
+ *           ln(I_e) = V / T_e + const, so T_e [eV] is the inverse slope of a line fit.
+ *  5. n_e:  Bohm ion current I_is = 0.61 e n_e A sqrt(e T_e / m_i) with O+ ions.
+ *
+ *  Electron current is positive, ion current negative.
+ */
+
+uint16_t iv_param_seq_count = 0;
+
+static float IV_V[IV_MAX_POINTS];
+static float IV_I[IV_MAX_POINTS];
+
+
+typedef struct {
+    float    Sx, Sy, Sxx, Sxy;
+    uint16_t N;
+} Line_fit_t;
+
+static inline void line_fit_add(Line_fit_t* fit, float x, float y) {
+    fit->Sx += x;
+    fit->Sy += y;
+    fit->Sxx += x * x;
+    fit->Sxy += x * y;
+    fit->N++;
+}
+
+static bool line_fit_solve(Line_fit_t* fit, float* slope, float* intercept) {
+    float det = fit->N * fit->Sxx - fit->Sx * fit->Sx;
+    if (fit->N < IV_MIN_FIT_POINTS || fabsf(det) < 1.0e-12f) {
+        return false;
+    }
+    *slope = (fit->N * fit->Sxy - fit->Sx * fit->Sy) / det;
+    *intercept = (fit->Sy - *slope * fit->Sx) / fit->N;
+    return true;
+}
+
+
+static inline uint32_t get_cycle_count() {
+    return DWT->CYCCNT;
+}
+
+
+/*  bias and current are the raw sweep values, N points in sweep order. The sweep is expected
+ *  to be monotonically increasing in bias. Returns the status flags, 0 if every parameter
+ *  was derived.
+ */
+uint8_t analyze_IV_curve(const uint16_t* bias, const uint16_t* current, uint16_t N, IV_result_t* result) {
+    uint32_t start_cycles = get_cycle_count();
+    *result = (IV_result_t) {0};
+
+    if (N > IV_MAX_POINTS) {
+        N = IV_MAX_POINTS;
+    }
+    for (uint16_t i = 0; i < N; i++) {
+        IV_V[i] = ((int32_t) bias[i] - IV_DEFAULT_BIAS_OFFSET_LSB) * IV_DEFAULT_BIAS_V_PER_LSB;
+        IV_I[i] = ((int32_t) current[i] - IV_DEFAULT_CURRENT_OFFSET_LSB) * IV_DEFAULT_CURRENT_A_PER_LSB;
+    }
+
+    // Floating potential
+    int16_t vf_idx = -1;
+    for (uint16_t i = 1; i < N; i++) {
+        if (IV_I[i - 1] < 0.0f && IV_I[i] >= 0.0f) {
+            float frac = -IV_I[i - 1] / (IV_I[i] - IV_I[i - 1]);
+            result->V_f = IV_V[i - 1] + frac * (IV_V[i] - IV_V[i - 1]);
+            vf_idx = i;
+            break;
+        }
+    }
+    if (vf_idx < 0) {
+        result->status = IV_STATUS_NO_VF | IV_STATUS_NO_ION_FIT | IV_STATUS_NO_TE | IV_STATUS_NO_NE;
+        result->cycles = get_cycle_count() - start_cycles;
+        return result->status;
+    }
+
+    // Ion saturation region
+    float V_ion_limit = IV_V[0] + (IV_V[N - 1] - IV_V[0]) * IV_ION_FIT_FRACTION;
+    Line_fit_t ion_fit = {0};
+    for (uint16_t i = 0; i < vf_idx && IV_V[i] <= V_ion_limit; i++) {
+        line_fit_add(&ion_fit, IV_V[i], IV_I[i]);
+    }
+    float ion_slope = 0.0f, ion_intercept = 0.0f;
+    if (line_fit_solve(&ion_fit, &ion_slope, &ion_intercept)) {
+        result->I_is = ion_slope * result->V_f + ion_intercept;
+    } else {
+        result->status |= IV_STATUS_NO_ION_FIT;
+    }
+
+    // Plasma potential, largest slope above V_f
+    uint16_t vp_idx = vf_idx;
+    float    max_didv = 0.0f;
+    for (uint16_t i = vf_idx; i < N - 1; i++) {
+        float dV = IV_V[i + 1] - IV_V[i];
+        if (dV <= 0.0f) {
+            continue;
+        }
+        float didv = (IV_I[i + 1] - IV_I[i]) / dV;
+        if (didv > max_didv) {
+            max_didv = didv;
+            vp_idx = i + 1;
+        }
+    }
+    result->V_p = IV_V[vp_idx];
+
+    // Electron temperature from the exponential region
+    Line_fit_t te_fit = {0};
+    for (uint16_t i = vf_idx; i < vp_idx; i++) {
+        float I_e = IV_I[i] - (ion_slope * IV_V[i] + ion_intercept);
+        if (I_e > 0.0f) {
+            line_fit_add(&te_fit, IV_V[i], logf(I_e));
+        }
+    }
+    float te_slope, te_intercept;
+    if (line_fit_solve(&te_fit, &te_slope, &te_intercept) && te_slope > 0.0f) {
+        result->T_e = 1.0f / te_slope;
+    } else {
+        result->status |= IV_STATUS_NO_TE;
+    }
+
+    // Electron density, quasi-neutral plasma so n_e = n_i
+    if (!(result->status & (IV_STATUS_NO_TE | IV_STATUS_NO_ION_FIT)) && result->I_is < 0.0f) {
+        float v_bohm = sqrtf(IV_ELEMENTARY_CHARGE * result->T_e / IV_ION_MASS_KG);
+        result->n_e = -result->I_is / (0.61f * IV_ELEMENTARY_CHARGE * IV_DEFAULT_PROBE_AREA_M2 * v_bohm);
+    } else {
+        result->status |= IV_STATUS_NO_NE;
+    }
+
+    result->cycles = get_cycle_count() - start_cycles;
+    return result->status;
+}
+
+
+// TM data: sweep seq (2) | probe ID (1) | status (1) | V_f | V_p | I_is | T_e | n_e (float, 4 each) | cycles (4)
+void send_IV_parameters(uint16_t sweep_seq, uint8_t probe_ID, IV_result_t* result) {
+    uint8_t  TM_data[2 + 1 + 1 + 5 * sizeof(float) + sizeof(uint32_t)];
+    uint8_t* out = TM_data;
+
+    memcpy(out, &sweep_seq, sizeof(sweep_seq));
+    out += sizeof(sweep_seq);
+    *out++ = probe_ID;
+    *out++ = result->status;
+
+    float params[5] = {result->V_f, result->V_p, result->I_is, result->T_e, result->n_e};
+    memcpy(out, params, sizeof(params));
+    out += sizeof(params);
+    memcpy(out, &result->cycles, sizeof(result->cycles));
+    out += sizeof(result->cycles);
+
+    SPP_header_t SPP_header = SPP_make_header(
+        SPP_VERSION,
+        SPP_PACKET_TYPE_TM,
+        0,
+        IV_PARAM_APID,
+        SPP_SEQUENCE_SEG_UNSEG,
+        iv_param_seq_count,
+        (out - TM_data) + CRC_BYTE_LEN - 1
+    );
+    iv_param_seq_count = (iv_param_seq_count + 1) & 0x3FFF;
+    SPP_send_TM(&SPP_header, NULL, TM_data, out - TM_data);
+}
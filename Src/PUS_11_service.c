@@ -0,0 +1,542 @@
+/*
+ * PUS_11_service.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+#include "Space_Packet_Protocol.h"
+#include "FRAM.h"
+#include "on_board_time.h"
+
+/*  Time-based schedule. Release times are on-board time in ms since boot, the clock that also
+ *  time stamps the science packets and the data blocks (see on_board_time.h). The 32-bit
+ *  release times wrap after ~49 days, comparisons are wrap-safe.
+ *
+ *  Activities live in a fixed pool, so every activity keeps its FRAM slot for its whole
+ *  lifetime. The min-heap only holds pool indices ordered by release time.
+ *
+ *  FRAM layout: | magic (1) | spare (1) | valid mask (2) | slot 0 | ... | slot 15 |
+ *  slot:        | release time (4) | TC len (1) | TC packet (SCHED_MAX_TC_LEN) | spare |
+ *
+ *  Release times do not survive a reboot, so a restored schedule starts disabled and
+ *  has to be time shifted and enabled from ground.
+ */
+#define SCHED_MAX_ACTIVITIES    16
+#define SCHED_MAX_TC_LEN        64
+#define SCHED_FRAM_MAGIC        0x5C
+#define SCHED_FRAM_HEADER_LEN   4
+#define SCHED_FRAM_SLOT_SIZE    72
+#define SCHED_ACTIVITY_ID_LEN   4   // APID (2) | sequence count (2)
+
+#if (SCHED_FRAM_HEADER_LEN + SCHED_MAX_ACTIVITIES * SCHED_FRAM_SLOT_SIZE) > FRAM_SCHEDULE_SECTION_SIZE
+#error "PUS 11 schedule does not fit its FRAM section"
+#endif
+
+typedef struct {
+    uint32_t release_time;
+    uint16_t APID;
+    uint16_t seq_count;
+    uint8_t  TC_len;
+    uint8_t  TC[SCHED_MAX_TC_LEN];
+} Sched_activity_t;
+
+static Sched_activity_t sched_pool[SCHED_MAX_ACTIVITIES];
+static uint16_t         sched_valid_mask = 0;
+static uint8_t          sched_heap[SCHED_MAX_ACTIVITIES];
+static uint8_t          sched_heap_len = 0;
+static bool             sched_enabled = false;
+
+
+// Wrap-safe comparison of two on-board times.
+static inline bool time_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+static inline uint32_t get_OBT_ms() {
+    return (uint32_t) (OBT_get_us() / 1000);
+}
+
+static inline uint16_t get_slot_address(uint8_t idx) {
+    return FRAM_SCHEDULE_SECTION_START + SCHED_FRAM_HEADER_LEN + (idx * SCHED_FRAM_SLOT_SIZE);
+}
+
+
+static void save_header_FRAM() {
+    uint8_t header[SCHED_FRAM_HEADER_LEN] = {SCHED_FRAM_MAGIC, 0x00};
+    memcpy(header + 2, &sched_valid_mask, sizeof(sched_valid_mask));
+    writeFRAM(FRAM_SCHEDULE_SECTION_START, header, SCHED_FRAM_HEADER_LEN);
+}
+
+static void save_release_time_FRAM(uint8_t idx) {
+    writeFRAM(get_slot_address(idx), (uint8_t*)&sched_pool[idx].release_time, sizeof(sched_pool[idx].release_time));
+}
+
+static void save_activity_FRAM(uint8_t idx) {
+    uint8_t slot[SCHED_FRAM_SLOT_SIZE];
+    Sched_activity_t* act = &sched_pool[idx];
+    memcpy(slot, &act->release_time, sizeof(act->release_time));
+    slot[4] = act->TC_len;
+    memcpy(slot + 5, act->TC, act->TC_len);
+    writeFRAM(get_slot_address(idx), slot, 5 + act->TC_len);
+}
+
+
+/* Min-heap of pool indices */
+
+static void heap_swap(uint8_t a, uint8_t b) {
+    uint8_t tmp = sched_heap[a];
+    sched_heap[a] = sched_heap[b];
+    sched_heap[b] = tmp;
+}
+
+static inline bool heap_less(uint8_t a, uint8_t b) {
+    return time_before(sched_pool[sched_heap[a]].release_time, sched_pool[sched_heap[b]].release_time);
+}
+
+static void heap_sift_up(uint8_t pos) {
+    while (pos > 0) {
+        uint8_t parent = (pos - 1) / 2;
+        if (!heap_less(pos, parent)) {
+            break;
+        }
+        heap_swap(pos, parent);
+        pos = parent;
+    }
+}
+
+static void heap_sift_down(uint8_t pos) {
+    for (;;) {
+        uint8_t smallest = pos;
+        uint8_t left = 2 * pos + 1;
+        uint8_t right = left + 1;
+        if (left < sched_heap_len && heap_less(left, smallest)) {
+            smallest = left;
+        }
+        if (right < sched_heap_len && heap_less(right, smallest)) {
+            smallest = right;
+        }
+        if (smallest == pos) {
+            break;
+        }
+        heap_swap(pos, smallest);
+        pos = smallest;
+    }
+}
+
+static void heap_push(uint8_t idx) {
+    sched_heap[sched_heap_len] = idx;
+    heap_sift_up(sched_heap_len);
+    sched_heap_len++;
+}
+
+static void heap_remove_at(uint8_t pos) {
+    sched_heap_len--;
+    if (pos != sched_heap_len) {
+        sched_heap[pos] = sched_heap[sched_heap_len];
+        heap_sift_up(pos);
+        heap_sift_down(pos);
+    }
+}
+
+static void heap_rebuild() {
+    for (int pos = sched_heap_len / 2 - 1; pos >= 0; pos--) {
+        heap_sift_down(pos);
+    }
+}
+
+
+static int find_heap_pos(uint16_t APID, uint16_t seq_count) {
+    for (uint8_t pos = 0; pos < sched_heap_len; pos++) {
+        Sched_activity_t* act = &sched_pool[sched_heap[pos]];
+        if (act->APID == APID && act->seq_count == seq_count) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+static int get_free_slot() {
+    for (uint8_t idx = 0; idx < SCHED_MAX_ACTIVITIES; idx++) {
+        if (!(sched_valid_mask & (1 << idx))) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+static void remove_activity(uint8_t pos) {
+    uint8_t idx = sched_heap[pos];
+    heap_remove_at(pos);
+    sched_valid_mask &= ~(1 << idx);
+    save_header_FRAM();
+}
+
+static void reset_schedule() {
+    sched_heap_len = 0;
+    sched_valid_mask = 0;
+    save_header_FRAM();
+}
+
+
+// TC_len returns the length of the nested TC, max_len is what is left of the enclosing TC data.
+static SPP_error insert_activity(uint32_t release_time, uint8_t* TC, uint16_t max_len, uint16_t* TC_len) {
+    if (max_len < SPP_PRIMARY_HEADER_LEN) {
+        return SPP_PUS11_ERROR;
+    }
+    SPP_header_t TC_SPP_header;
+    SPP_decode_header(TC, &TC_SPP_header);
+    uint16_t len = TC_SPP_header.packet_data_length + SPP_PRIMARY_HEADER_LEN + 1;
+    *TC_len = len;
+
+    if (TC_SPP_header.packet_type != SPP_PACKET_TYPE_TC || !TC_SPP_header.secondary_header_flag) {
+        return SPP_PUS11_ERROR;
+    }
+    if (len < SPP_PUS_TC_MIN_LEN || len > SCHED_MAX_TC_LEN || len > max_len) {
+        return SPP_PUS11_ERROR;
+    }
+    if (SPP_validate_checksum(TC, len) != SPP_OK) {
+        return SPP_PACKET_CRC_MISMATCH;
+    }
+    // Scheduling the scheduler itself is not allowed.
+    if (TC[SPP_PRIMARY_HEADER_LEN + 1] == TIME_BASED_SCHEDULING_ID) {
+        return SPP_PUS11_ERROR;
+    }
+    if (!time_before(get_OBT_ms(), release_time)) {
+        return SPP_PUS11_ERROR;
+    }
+    if (find_heap_pos(TC_SPP_header.application_process_id, TC_SPP_header.packet_sequence_count) >= 0) {
+        return SPP_PUS11_ERROR;
+    }
+    int idx = get_free_slot();
+    if (idx < 0) {
+        return SPP_PUS11_ERROR;
+    }
+
+    Sched_activity_t* act = &sched_pool[idx];
+    act->release_time = release_time;
+    act->APID = TC_SPP_header.application_process_id;
+    act->seq_count = TC_SPP_header.packet_sequence_count;
+    act->TC_len = len;
+    memcpy(act->TC, TC, len);
+
+    save_activity_FRAM(idx);
+    sched_valid_mask |= (1 << idx);
+    save_header_FRAM();
+    heap_push(idx);
+    return SPP_OK;
+}
+
+
+// data: N (1) | N x [release time (4) | TC packet]
+static SPP_error insert_activities(uint8_t* data, uint16_t data_len) {
+    SPP_error err = SPP_OK;
+    if (data_len < 1) {
+        return SPP_PUS11_ERROR;
+    }
+    uint8_t N = *data++;
+    data_len--;
+    for (int i = 0; i < N; i++) {
+        uint32_t release_time;
+        if (data_len < sizeof(release_time)) {
+            return SPP_PUS11_ERROR;
+        }
+        memcpy(&release_time, data, sizeof(release_time));
+        data += sizeof(release_time);
+        data_len -= sizeof(release_time);
+
+        uint16_t TC_len = 0;
+        err = insert_activity(release_time, data, data_len, &TC_len);
+        if (err != SPP_OK) {
+            break;
+        }
+        data += TC_len;
+        data_len -= TC_len;
+    }
+    return err;
+}
+
+
+// data: N (1) | N x [APID (2) | sequence count (2)]
+static SPP_error delete_activities(uint8_t* data, uint16_t data_len) {
+    SPP_error err = SPP_OK;
+    if (data_len < 1 || data_len < 1 + data[0] * SCHED_ACTIVITY_ID_LEN) {
+        return SPP_PUS11_ERROR;
+    }
+    uint8_t N = *data++;
+    for (int i = 0; i < N; i++) {
+        uint16_t APID, seq_count;
+        memcpy(&APID, data, sizeof(APID));
+        data += sizeof(APID);
+        memcpy(&seq_count, data, sizeof(seq_count));
+        data += sizeof(seq_count);
+
+        int pos = find_heap_pos(APID, seq_count);
+        if (pos < 0) {
+            err = SPP_PUS11_ERROR;
+            continue;
+        }
+        remove_activity(pos);
+    }
+    return err;
+}
+
+
+/*  data: time offset (4, signed) | N (1) | N x [APID (2) | sequence count (2)]
+ *  Like an insert, a shift may not put a release time at or before now. If any of the
+ *  activities would end up there, none of them is shifted.
+ */
+static SPP_error time_shift_activities(uint8_t* data, uint16_t data_len) {
+    SPP_error err = SPP_OK;
+    int32_t offset;
+    if (data_len < sizeof(offset) + 1 || data_len < sizeof(offset) + 1 + data[sizeof(offset)] * SCHED_ACTIVITY_ID_LEN) {
+        return SPP_PUS11_ERROR;
+    }
+    memcpy(&offset, data, sizeof(offset));
+    data += sizeof(offset);
+
+    // Pool indices of the listed activities, an activity listed twice is shifted once
+    uint16_t shift_mask = 0;
+    uint32_t now = get_OBT_ms();
+    uint8_t N = *data++;
+    for (int i = 0; i < N; i++) {
+        uint16_t APID, seq_count;
+        memcpy(&APID, data, sizeof(APID));
+        data += sizeof(APID);
+        memcpy(&seq_count, data, sizeof(seq_count));
+        data += sizeof(seq_count);
+
+        int pos = find_heap_pos(APID, seq_count);
+        if (pos < 0) {
+            err = SPP_PUS11_ERROR;
+            continue;
+        }
+        uint8_t idx = sched_heap[pos];
+        if (!time_before(now, sched_pool[idx].release_time + offset)) {
+            return SPP_PUS11_ERROR;
+        }
+        shift_mask |= (1 << idx);
+    }
+
+    for (uint8_t idx = 0; idx < SCHED_MAX_ACTIVITIES; idx++) {
+        if (shift_mask & (1 << idx)) {
+            sched_pool[idx].release_time += offset;
+            save_release_time_FRAM(idx);
+        }
+    }
+    heap_rebuild();
+    return err;
+}
+
+
+// data: time offset (4, signed). Order of the activities does not change.
+static SPP_error time_shift_all(uint8_t* data, uint16_t data_len) {
+    int32_t offset;
+    if (data_len < sizeof(offset)) {
+        return SPP_PUS11_ERROR;
+    }
+    memcpy(&offset, data, sizeof(offset));
+
+    // The earliest activity is at the top of the heap, if it stays in the future all of them do
+    if (sched_heap_len > 0 && !time_before(get_OBT_ms(), sched_pool[sched_heap[0]].release_time + offset)) {
+        return SPP_PUS11_ERROR;
+    }
+    for (uint8_t pos = 0; pos < sched_heap_len; pos++) {
+        uint8_t idx = sched_heap[pos];
+        sched_pool[idx].release_time += offset;
+        save_release_time_FRAM(idx);
+    }
+    return SPP_OK;
+}
+
+
+static void send_TBS_TM(SPP_header_t* req_SPP_h, PUS_TC_header_t* req_PUS_h, uint8_t subtype, uint8_t* data, uint16_t data_len) {
+    SPP_header_t resp_SPP_header = SPP_make_header(
+        SPP_VERSION,
+        SPP_PACKET_TYPE_TM,
+        1,
+        req_SPP_h->application_process_id,
+        SPP_SEQUENCE_SEG_UNSEG,
+        req_SPP_h->packet_sequence_count,
+        SPP_PUS_TM_HEADER_LEN_WO_SPARE + data_len + CRC_BYTE_LEN - 1
+    );
+    PUS_TM_header_t resp_PUS_header = PUS_make_TM_header(
+        PUS_VERSION,
+        0,
+        TIME_BASED_SCHEDULING_ID,
+        subtype,
+        0,
+        req_PUS_h->source_id,
+        0
+    );
+    SPP_send_TM(&resp_SPP_header, &resp_PUS_header, data, data_len);
+}
+
+
+// One 11,10 report per activity, each report has N = 1 to stay within a single packet.
+static void send_detail_report(SPP_header_t* req_SPP_h, PUS_TC_header_t* req_PUS_h) {
+    uint8_t TM_data[1 + sizeof(uint32_t) + SCHED_MAX_TC_LEN];
+    for (uint8_t pos = 0; pos < sched_heap_len; pos++) {
+        Sched_activity_t* act = &sched_pool[sched_heap[pos]];
+        TM_data[0] = 1;
+        memcpy(TM_data + 1, &act->release_time, sizeof(act->release_time));
+        memcpy(TM_data + 1 + sizeof(act->release_time), act->TC, act->TC_len);
+        send_TBS_TM(req_SPP_h, req_PUS_h, TBS_DETAIL_REPORT, TM_data, 1 + sizeof(act->release_time) + act->TC_len);
+    }
+}
+
+
+// 11,13 report: on-board time (4) | N (1) | N x [release time (4) | APID (2) | sequence count (2)]
+static void send_summary_report(SPP_header_t* req_SPP_h, PUS_TC_header_t* req_PUS_h) {
+    uint8_t TM_data[sizeof(uint32_t) + 1 + SCHED_MAX_ACTIVITIES * 8];
+    uint8_t* out = TM_data;
+    uint32_t now = get_OBT_ms();
+    memcpy(out, &now, sizeof(now));
+    out += sizeof(now);
+    *out++ = sched_heap_len;
+    for (uint8_t pos = 0; pos < sched_heap_len; pos++) {
+        Sched_activity_t* act = &sched_pool[sched_heap[pos]];
+        memcpy(out, &act->release_time, sizeof(act->release_time));
+        out += sizeof(act->release_time);
+        memcpy(out, &act->APID, sizeof(act->APID));
+        out += sizeof(act->APID);
+        memcpy(out, &act->seq_count, sizeof(act->seq_count));
+        out += sizeof(act->seq_count);
+    }
+    send_TBS_TM(req_SPP_h, req_PUS_h, TBS_SUMMARY_REPORT, TM_data, out - TM_data);
+}
+
+
+// Restores the schedule from FRAM. Must be called after FRAM is accessible.
+void SPP_init_TBS_schedule() {
+    uint8_t header[SCHED_FRAM_HEADER_LEN];
+    sched_enabled = false;
+    sched_heap_len = 0;
+    sched_valid_mask = 0;
+
+    if (readFRAM(FRAM_SCHEDULE_SECTION_START, header, SCHED_FRAM_HEADER_LEN) != HAL_OK || header[0] != SCHED_FRAM_MAGIC) {
+        save_header_FRAM();
+        return;
+    }
+    uint16_t stored_mask;
+    memcpy(&stored_mask, header + 2, sizeof(stored_mask));
+
+    for (uint8_t idx = 0; idx < SCHED_MAX_ACTIVITIES; idx++) {
+        if (!(stored_mask & (1 << idx))) {
+            continue;
+        }
+        uint8_t slot[SCHED_FRAM_SLOT_SIZE];
+        if (readFRAM(get_slot_address(idx), slot, SCHED_FRAM_SLOT_SIZE) != HAL_OK) {
+            continue;
+        }
+        Sched_activity_t* act = &sched_pool[idx];
+        memcpy(&act->release_time, slot, sizeof(act->release_time));
+        act->TC_len = slot[4];
+        if (act->TC_len < SPP_PUS_TC_MIN_LEN || act->TC_len > SCHED_MAX_TC_LEN) {
+            continue;
+        }
+        memcpy(act->TC, slot + 5, act->TC_len);
+        if (SPP_validate_checksum(act->TC, act->TC_len) != SPP_OK) {
+            continue;
+        }
+        SPP_header_t TC_SPP_header;
+        SPP_decode_header(act->TC, &TC_SPP_header);
+        act->APID = TC_SPP_header.application_process_id;
+        act->seq_count = TC_SPP_header.packet_sequence_count;
+
+        sched_valid_mask |= (1 << idx);
+        sched_heap[sched_heap_len++] = idx;
+    }
+    heap_rebuild();
+    if (sched_valid_mask != stored_mask) {
+        save_header_FRAM();
+    }
+}
+
+
+// Called from the main loop. Releases every activity whose release time has passed.
+void SPP_execute_scheduled_TCs() {
+    uint8_t TC[SCHED_MAX_TC_LEN];
+    uint32_t now = get_OBT_ms();
+
+    while (sched_enabled && sched_heap_len > 0) {
+        Sched_activity_t* act = &sched_pool[sched_heap[0]];
+        if (time_before(now, act->release_time)) {
+            break;
+        }
+        // Activity is removed before execution, so a TC that reboots or fails is not repeated.
+        memcpy(TC, act->TC, act->TC_len);
+        remove_activity(0);
+        SPP_process_TC_packet(TC);
+    }
+}
+
+
+// TBS - Time-based scheduling PUS service 11
+SPP_error SPP_handle_TBS_TC(SPP_header_t* SPP_header, PUS_TC_header_t* secondary_header, uint8_t* data) {
+    SPP_error err = SPP_OK;
+    if (Current_Global_Device_State != NORMAL_MODE) {
+        return UNDEFINED_ERROR;
+    }
+    if (secondary_header == NULL) {
+        return SPP_MISSING_PUS_HEADER;
+    }
+    // Application data length, the PUS header and the CRC are not part of it
+    uint16_t data_len = 0;
+    if (SPP_header->packet_data_length + 1 > SPP_PUS_TC_HEADER_LEN_WO_SPARE + CRC_BYTE_LEN) {
+        data_len = SPP_header->packet_data_length + 1 - SPP_PUS_TC_HEADER_LEN_WO_SPARE - CRC_BYTE_LEN;
+    }
+
+    switch (secondary_header->message_subtype_id) {
+        case TBS_ENABLE:
+        case TBS_DISABLE:
+        case TBS_RESET:
+        case TBS_INSERT_ACTIVITIES:
+        case TBS_DELETE_ACTIVITIES:
+        case TBS_TIME_SHIFT_ACTIVITIES:
+        case TBS_TIME_SHIFT_ALL:
+        case TBS_DETAIL_REPORT_ALL:
+        case TBS_SUMMARY_REPORT_ALL:
+            send_succ_acc(SPP_header, secondary_header);
+            break;
+        default:
+            send_fail_acc(SPP_header, secondary_header);
+            return SPP_UNHANDLED_PUS_ID;
+    }
+
+    switch (secondary_header->message_subtype_id) {
+        case TBS_ENABLE:
+            sched_enabled = true;
+            break;
+        case TBS_DISABLE:
+            sched_enabled = false;
+            break;
+        case TBS_RESET:
+            sched_enabled = false;
+            reset_schedule();
+            break;
+        case TBS_INSERT_ACTIVITIES:
+            err = insert_activities(data, data_len);
+            break;
+        case TBS_DELETE_ACTIVITIES:
+            err = delete_activities(data, data_len);
+            break;
+        case TBS_TIME_SHIFT_ACTIVITIES:
+            err = time_shift_activities(data, data_len);
+            break;
+        case TBS_TIME_SHIFT_ALL:
+            err = time_shift_all(data, data_len);
+            break;
+        case TBS_DETAIL_REPORT_ALL:
+            send_detail_report(SPP_header, secondary_header);
+            break;
+        case TBS_SUMMARY_REPORT_ALL:
+            send_summary_report(SPP_header, secondary_header);
+            break;
+    }
+
+    if (err != SPP_OK) {
+        send_fail_comp(SPP_header, secondary_header);
+    } else {
+        send_succ_comp(SPP_header, secondary_header);
+    }
+    return err;
+}
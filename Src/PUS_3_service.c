@@ -5,6 +5,14 @@
  *      Author: Rūdolfs Arvīds Kalniņš <rakal@kth.se>
  */
 #include "Space_Packet_Protocol.h"
+#include "FPGA_config_mirror.h"
+#include "scientific_data.h"
+#include "CB_trigger.h"
+#include "downlink_scheduler.h"
+#include "FPGA_Data_Saving.h"
+#include "bsp_driver_sd.h"
+#include "sd_stats.h"
+#include "storage_manager.h"
 
 #define MAX_PAR_COUNT       16
 #define MAX_STRUCT_COUNT    16
@@ -16,6 +24,24 @@
 #define DEF_FPGA_N1         2
 #define DEF_FPGA_PS         false
 
+#define DEF_MIRROR_N1       1
+#define DEF_MIRROR_PS       false
+
+#define DEF_SC_N1           7
+#define DEF_SC_PS           false
+
+#define DEF_DL_N1           (2 * NOF_DL_CLASSES)
+#define DEF_DL_PS           false
+
+#define DEF_SD_N1           16
+#define DEF_SD_PS           false
+
+#define DEF_SD_HIST_N1      SDS_HIST_BUCKETS
+#define DEF_SD_HIST_PS      false
+
+#define DEF_STOR_N1         6
+#define DEF_STOR_PS         false
+
 #define HK_SPP_APP_ID        61  // Just some random numbers.
 #define HK_PUS_SOURCE_ID     14
 
@@ -38,28 +64,100 @@ typedef struct {
 typedef enum {
     UC_SID            = 0xAAAA,
     FPGA_SID          = 0x5555,
+    MIRROR_SID        = 0x5556, // FPGA configuration mirror, verify mode mismatches
+    SC_SID            = 0x3333, // Scientific data pipeline
+    DL_SID            = 0x6666, // Downlink scheduler, occupancy and drops of each class in DL_Class_ID_t order
+    SD_SID            = 0x7777, // SD writer latency summary, staging queue, card speed and error recovery
+    SD_WRITE_HIST_SID = 0x7778, // SD block write latency histogram
+    SD_SYNC_HIST_SID  = 0x7779, // SD f_sync latency histogram
+    STOR_SID          = 0x777A, // SD card usage, file rotation and space reclamation
 } HK_SID;
 
 
-HK_par_report_structure_t HKPRS_uc = {
-    .SID                    = UC_SID,
-    .collection_interval    = DEF_COL_INTV,
-    .N1                     = DEF_UC_N1,
-    .parameters             = {0},
-    .periodic_send          = DEF_UC_PS,
-    .last_collect_tick      = 0,
-    .seq_count              = 0,
-};
-
-HK_par_report_structure_t HKPRS_fpga = {
-    .SID                    = FPGA_SID,
-    .collection_interval    = DEF_COL_INTV,
-    .N1                     = DEF_FPGA_N1,
-    .parameters             = {0},
-    .periodic_send          = DEF_FPGA_PS,
-    .last_collect_tick      = 0,
-    .seq_count              = 0,
+HK_par_report_structure_t HKPRS_list[] = {
+    {
+        .SID                    = UC_SID,
+        .collection_interval    = DEF_COL_INTV,
+        .N1                     = DEF_UC_N1,
+        .parameters             = {0},
+        .periodic_send          = DEF_UC_PS,
+        .last_collect_tick      = 0,
+        .seq_count              = 0,
+    },
+    {
+        .SID                    = FPGA_SID,
+        .collection_interval    = DEF_COL_INTV,
+        .N1                     = DEF_FPGA_N1,
+        .parameters             = {0},
+        .periodic_send          = DEF_FPGA_PS,
+        .last_collect_tick      = 0,
+        .seq_count              = 0,
+    },
+    {
+        .SID                    = MIRROR_SID,
+        .collection_interval    = DEF_COL_INTV,
+        .N1                     = DEF_MIRROR_N1,
+        .parameters             = {0},
+        .periodic_send          = DEF_MIRROR_PS,
+        .last_collect_tick      = 0,
+        .seq_count              = 0,
+    },
+    {
+        .SID                    = SC_SID,
+        .collection_interval    = DEF_COL_INTV,
+        .N1                     = DEF_SC_N1,
+        .parameters             = {0},
+        .periodic_send          = DEF_SC_PS,
+        .last_collect_tick      = 0,
+        .seq_count              = 0,
+    },
+    {
+        .SID                    = DL_SID,
+        .collection_interval    = DEF_COL_INTV,
+        .N1                     = DEF_DL_N1,
+        .parameters             = {0},
+        .periodic_send          = DEF_DL_PS,
+        .last_collect_tick      = 0,
+        .seq_count              = 0,
+    },
+    {
+        .SID                    = SD_SID,
+        .collection_interval    = DEF_COL_INTV,
+        .N1                     = DEF_SD_N1,
+        .parameters             = {0},
+        .periodic_send          = DEF_SD_PS,
+        .last_collect_tick      = 0,
+        .seq_count              = 0,
+    },
+    {
+        .SID                    = SD_WRITE_HIST_SID,
+        .collection_interval    = DEF_COL_INTV,
+        .N1                     = DEF_SD_HIST_N1,
+        .parameters             = {0},
+        .periodic_send          = DEF_SD_HIST_PS,
+        .last_collect_tick      = 0,
+        .seq_count              = 0,
+    },
+    {
+        .SID                    = SD_SYNC_HIST_SID,
+        .collection_interval    = DEF_COL_INTV,
+        .N1                     = DEF_SD_HIST_N1,
+        .parameters             = {0},
+        .periodic_send          = DEF_SD_HIST_PS,
+        .last_collect_tick      = 0,
+        .seq_count              = 0,
+    },
+    {
+        .SID                    = STOR_SID,
+        .collection_interval    = DEF_COL_INTV,
+        .N1                     = DEF_STOR_N1,
+        .parameters             = {0},
+        .periodic_send          = DEF_STOR_PS,
+        .last_collect_tick      = 0,
+        .seq_count              = 0,
+    },
 };
+#define NOF_HKPRS   (sizeof(HKPRS_list) / sizeof(HKPRS_list[0]))
 
 HK_par_report_structure_t HKPRS_err = {
     .SID                    = 0,
@@ -72,15 +170,12 @@ HK_par_report_structure_t HKPRS_err = {
 };
 
 static HK_par_report_structure_t* get_HKPRS(uint16_t SID) {
-    HK_par_report_structure_t* selected_HKPRS;
-    if (SID == UC_SID) {
-        selected_HKPRS = &HKPRS_uc;
-    } else if (SID == FPGA_SID) {
-        selected_HKPRS = &HKPRS_fpga;
-    } else {
-        selected_HKPRS = &HKPRS_err; // This is kind of bad, probably should return an error code.
+    for (int i = 0; i < NOF_HKPRS; i++) {
+        if (HKPRS_list[i].SID == SID) {
+            return &HKPRS_list[i];
+        }
     }
-    return selected_HKPRS;
+    return &HKPRS_err; // This is kind of bad, probably should return an error code.
 }
 
 
@@ -94,6 +189,16 @@ static void fill_report_struct(uint16_t SID) {
 
     uint32_t uc_pars[DEF_UC_N1] = {s_vbat, s_temp, s_uc3v};
     uint32_t fpga_pars[DEF_FPGA_N1] = {s_fpga1p5v, s_fpga3v};
+    uint32_t mirror_pars[DEF_MIRROR_N1] = {FPGA_mirror_mismatch_cnt};
+    uint32_t sc_pars[DEF_SC_N1] = {SC_stats.samples_in, SC_stats.packets_out, SC_stats.bytes_dropped, SC_stats.sync_errors,
+                                   SC_stats.sweeps_out, SC_stats.sweeps_incomplete, CB_trigger_events};
+    uint32_t sd_pars[DEF_SD_N1] = {SD_stats.write.count, SDS_mean_us(&SD_stats.write), SD_stats.write.max_us,
+                                   SD_stats.sync.count, SDS_mean_us(&SD_stats.sync), SD_stats.sync.max_us,
+                                   writeQueueCount(), writeQueueHighWater, writeQueueOverflows, currentDataRate,
+                                   BSP_SD_GetSpeed(), BSP_SD_GetFallbacks(), FPGAWriteErrors, FPGALostBytes(),
+                                   FPGAWriterState, FPGABackpressure};
+    uint32_t stor_pars[DEF_STOR_N1] = {STOR_stats.total_kB, STOR_stats.free_kB, STOR_stats.rotations,
+                                       STOR_stats.files_deleted, STOR_stats.kB_reclaimed, STOR_stats.reclaiming};
 
     HK_par_report_structure_t* HKPRS = get_HKPRS(SID);
     switch(SID) {
@@ -107,6 +212,42 @@ static void fill_report_struct(uint16_t SID) {
                 HKPRS->parameters[i] = fpga_pars[i];
             }
             break;
+        case MIRROR_SID:
+            for(int i = 0; i < HKPRS->N1; i++) {
+                HKPRS->parameters[i] = mirror_pars[i];
+            }
+            break;
+        case SC_SID:
+            for(int i = 0; i < HKPRS->N1; i++) {
+                HKPRS->parameters[i] = sc_pars[i];
+            }
+            break;
+        case DL_SID:
+            for(int i = 0; i < NOF_DL_CLASSES; i++) {
+                HKPRS->parameters[2 * i] = DL_occupancy(i);
+                HKPRS->parameters[2 * i + 1] = DL_dropped(i);
+            }
+            break;
+        case SD_SID:
+            for(int i = 0; i < HKPRS->N1; i++) {
+                HKPRS->parameters[i] = sd_pars[i];
+            }
+            break;
+        case SD_WRITE_HIST_SID:
+            for(int i = 0; i < HKPRS->N1; i++) {
+                HKPRS->parameters[i] = SD_stats.write.buckets[i];
+            }
+            break;
+        case SD_SYNC_HIST_SID:
+            for(int i = 0; i < HKPRS->N1; i++) {
+                HKPRS->parameters[i] = SD_stats.sync.buckets[i];
+            }
+            break;
+        case STOR_SID:
+            for(int i = 0; i < HKPRS->N1; i++) {
+                HKPRS->parameters[i] = stor_pars[i];
+            }
+            break;
     }  
 }
 
@@ -177,26 +318,21 @@ static void set_periodic_report(uint8_t* data, bool state) {
         memcpy(&SID, data, sizeof(SID));
         data += sizeof(SID);
 
-        switch(SID) {
-            case UC_SID:
-                HKPRS_uc.periodic_send = state;
-                break;
-            case FPGA_SID:
-                HKPRS_fpga.periodic_send = state;
-                break;
+        HK_par_report_structure_t* HKPRS = get_HKPRS(SID);
+        if (HKPRS != &HKPRS_err) {
+            HKPRS->periodic_send = state;
         }
     }
 }
 
 
 void SPP_collect_HK_data(uint32_t current_ticks) {
-    if ((current_ticks - HKPRS_uc.last_collect_tick) > HKPRS_uc.collection_interval) {
-        fill_report_struct(HKPRS_uc.SID);
-        HKPRS_uc.last_collect_tick = current_ticks;
-    }
-    if ((current_ticks - HKPRS_fpga.last_collect_tick) > HKPRS_fpga.collection_interval) {
-        fill_report_struct(HKPRS_fpga.SID);
-        HKPRS_fpga.last_collect_tick = current_ticks;
+    for (int i = 0; i < NOF_HKPRS; i++) {
+        HK_par_report_structure_t* HKPRS = &HKPRS_list[i];
+        if ((current_ticks - HKPRS->last_collect_tick) > HKPRS->collection_interval) {
+            fill_report_struct(HKPRS->SID);
+            HKPRS->last_collect_tick = current_ticks;
+        }
     }
 }
 
@@ -229,11 +365,10 @@ static void HK_make_headers_send(uint16_t sel_SID) {
 
 
 void SPP_periodic_HK_send() {
-    if (HKPRS_uc.periodic_send) {
-        HK_make_headers_send(UC_SID);
-    }
-    if (HKPRS_fpga.periodic_send) {
-        HK_make_headers_send(FPGA_SID);
+    for (int i = 0; i < NOF_HKPRS; i++) {
+        if (HKPRS_list[i].periodic_send) {
+            HK_make_headers_send(HKPRS_list[i].SID);
+        }
     }
 }
 
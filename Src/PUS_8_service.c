@@ -9,9 +9,29 @@
 #include "Space_Packet_Protocol.h"
 #include "device_state.h"
 #include "langmuir_probe_bias.h"
+#include "sweep_profile.h"
+#include "command_sequence.h"
+#include "FPGA_config_mirror.h"
+#include "scientific_data.h"
+#include "CB_filter.h"
+#include "sweep_data.h"
+#include "CB_trigger.h"
+#include "downlink_scheduler.h"
 
 typedef enum {
     CPY_TABLE_FRAM_TO_FPGA = 0xE0,
+    GEN_SWEEP_TABLE        = 0xE1,
+    CMD_SEQ_CLEAR          = 0xE2,
+    CMD_SEQ_APPEND         = 0xE3,
+    CMD_SEQ_EXECUTE        = 0xE4,
+    SET_MIRROR_VERIFY      = 0xE5,
+    SET_SC_PACKING         = 0xE6,
+    SET_SC_COMPRESSION     = 0xE7,
+    SET_CB_FILTER          = 0xE8,
+    SET_SWT_AVERAGING      = 0xE9,
+    SET_CB_TRIGGER         = 0xEA,
+    SET_DL_BUDGET          = 0xEB,
+    REFRESH_FPGA_MIRROR    = 0xEC, // After the FPGA was power cycled or reset from outside
 } Aux_Func_ID_t;
 
 
@@ -23,65 +43,9 @@ SPP_error perform_function(SPP_header_t* SPP_h, PUS_TC_header_t* PUS_TC_h , uint
     uint8_t  N_args = *data++;
 
     if (is_langmuir_func(func_id)) {
-        FPGA_msg_arg_t fpgama =  {
-            .probe_ID       = 0xFF,
-            .step_ID        = 0xFF,
-            .voltage_level  = 0x0000,
-            .N_steps        = 0x00,
-            .N_skip         = 0x0000,
-            .N_f            = 0x0000, // Samples per points
-            .N_points       = 0x0000,
-            .target     = 0xFF,
-            .N_samples_per_step = 0x0000,
-            // .result         = {0},
-            // .result_len     = 0,
-        };
-
-        for(int i = 0; i < N_args; i++) {
-            uint8_t arg_ID = *data++;
-            switch(arg_ID) {
-                case PROBE_ID_ARG_ID:
-                    fpgama.probe_ID = *data++;
-                    break;
-                case STEP_ID_ARG_ID:
-                    fpgama.step_ID = *data++;
-                    break;
-                case VOL_LVL_ARG_ID:
-                    memcpy((uint8_t*)&fpgama.voltage_level, data, sizeof(fpgama.voltage_level));
-                    data += sizeof(fpgama.voltage_level);
-                    break;
-                case N_STEPS_ARG_ID:
-                    fpgama.N_steps = *data++;
-                    break;
-                case N_SKIP_ARG_ID:
-                    memcpy((uint8_t*)&fpgama.N_skip, data, sizeof(fpgama.N_skip));
-                    data += sizeof(fpgama.N_skip);
-                    break;
-                case N_F_ARG_ID:
-                    memcpy((uint8_t*)&fpgama.N_f, data, sizeof(fpgama.N_f));
-                    data += sizeof(fpgama.N_f);
-                    break;
-                case N_POINTS_ARG_ID:
-                    memcpy((uint8_t*)&fpgama.N_points, data, sizeof(fpgama.N_points));
-                    data += sizeof(fpgama.N_points);
-                    break;
-                case GS_TARGET_ARG_ID:
-                    // "sizeof" cannot be used here as .target is an enum type whose length cannot specified(at least in <C23).
-                    // If "sizeof" is used, it returns 4, which is incorrect as the target is only a single byte value.
-                    // This bug does not cause problems if the target argument is the last one in the message but would
-                    // mess up the alignment if it is in the beginning or middle of the message.
-                    memcpy((uint8_t*)&fpgama.target, data, 1);
-                    data += 1;
-                    break;
-                case N_SAMPLES_PER_STEP_ARG_ID:
-                    memcpy((uint8_t*)&fpgama.N_samples_per_step, data, sizeof(fpgama.N_samples_per_step));
-                    data += sizeof(fpgama.N_samples_per_step);
-                    break;
-                default:
-                    break;
-            }
-        }
-        send_FPGA_langmuir_msg(func_id, &fpgama);
+        FPGA_msg_arg_t fpgama;
+        decode_FPGA_msg_args(N_args, data, &fpgama);
+        err = send_FPGA_langmuir_msg(func_id, &fpgama);
         //send_succ_comp(SPP_h, PUS_TC;);
 
     } else {
@@ -109,6 +73,57 @@ SPP_error perform_function(SPP_header_t* SPP_h, PUS_TC_header_t* PUS_TC_h , uint
                 }
                break;
             }
+            case GEN_SWEEP_TABLE:
+                err = generate_sweep_table(N_args, data);
+                break;
+
+            case CMD_SEQ_CLEAR:
+                err = handle_cmd_seq_clear(N_args, data);
+                break;
+
+            case CMD_SEQ_APPEND:
+                err = handle_cmd_seq_append(N_args, data);
+                break;
+
+            case CMD_SEQ_EXECUTE:
+                err = handle_cmd_seq_execute(N_args, data);
+                break;
+
+            case SET_MIRROR_VERIFY:
+                for (int i = 0; i < N_args; i++) {
+                    uint8_t arg_ID = *data++;
+                    if (arg_ID == ENABLE_ARG_ID) {
+                        FPGA_mirror_verify = (*data++ != 0);
+                    } else {
+                        data += FPGA_arg_width(arg_ID);
+                    }
+                }
+                break;
+
+            case SET_SC_PACKING:
+                err = set_CB_packing(N_args, data);
+                break;
+
+            case SET_SC_COMPRESSION:
+                err = set_SC_compression(N_args, data);
+                break;
+
+            case SET_CB_FILTER:
+                err = set_CB_filter(N_args, data);
+                break;
+
+            case SET_SWT_AVERAGING:
+                err = set_SWT_averaging(N_args, data);
+                break;
+
+            case SET_CB_TRIGGER:
+                err = set_CB_trigger(N_args, data);
+                break;
+
+            case SET_DL_BUDGET:
+                err = set_DL_budget(N_args, data);
+                break;
+
             case SET_DEV_STATE_NORMAL:
             	set_device_state(NORMAL_MODE);
                 break;
@@ -122,9 +137,15 @@ SPP_error perform_function(SPP_header_t* SPP_h, PUS_TC_header_t* PUS_TC_h , uint
 
             case SET_DEV_STATE_UPDATE:
             	set_device_state(UPDATE_MODE);
+                FPGA_mirror_invalidate(); // FPGA is reconfigured by the update
                 break;
 
             case SET_DEV_STATE_SWAP_IMAGE:
+                FPGA_mirror_invalidate();
+                break;
+
+            case REFRESH_FPGA_MIRROR:
+                FPGA_mirror_invalidate();
                 break;
 
             default:
@@ -146,6 +167,9 @@ SPP_error SPP_handle_FM_TC(SPP_header_t* SPP_header , PUS_TC_header_t* secondary
     if (secondary_header->message_subtype_id == FM_PERFORM_FUNCTION) {
         send_succ_acc(SPP_header, secondary_header);
         err = perform_function(SPP_header, secondary_header, data);
+        if (err != SPP_OK) {
+            send_fail_comp(SPP_header, secondary_header);
+        }
     } else {
         send_fail_acc(SPP_header, secondary_header);
         err = SPP_UNHANDLED_PUS_ID;
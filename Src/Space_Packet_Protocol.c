@@ -6,6 +6,7 @@
  */
 
 #include "Space_Packet_Protocol.h"
+#include "downlink_scheduler.h"
 #include <stdio.h>
 
 uint8_t DEBUG_Space_Packet_Data_Buffer[256];
@@ -14,18 +15,19 @@ uint8_t OBC_Space_Packet_Data_Buffer[1024];
 uint8_t DEBUGRxBuffer[COBS_FRAME_LEN];
 uint8_t DEBUGTxBuffer[COBS_FRAME_LEN];
 uint16_t SPP_DEBUG_recv_count = 0;
-uint8_t SPP_DEBUG_recv_char = 0xff;
+DMA_BUFFER uint8_t SPP_DEBUG_recv_char;
 
 uint8_t OBCRxBuffer[COBS_FRAME_LEN];
 uint8_t OBCTxBuffer[COBS_FRAME_LEN];
 uint16_t SPP_OBC_recv_count = 0;
-uint8_t SPP_OBC_recv_char = 0xff;
+DMA_BUFFER uint8_t SPP_OBC_recv_char;
 
 
 // NONSTATIC FOR TESTING PURPOSES
 /* static */ SPP_error SPP_UART_transmit_DMA(uint8_t* data, uint16_t data_len) {
 	*(data + data_len) = 0x00; // Adding sentinel value.
 	data_len++;
+    DCache_clean(data, data_len);
     HAL_UART_Transmit_DMA(&SPP_DEBUG_UART, data, data_len);
     HAL_UART_Transmit(&SPP_OBC_UART, data, data_len, 100);
     return SPP_OK;
@@ -33,6 +35,7 @@ uint8_t SPP_OBC_recv_char = 0xff;
 
 
 SPP_error SPP_DLog(char* data){
+    DCache_clean(data, strlen(data));
     HAL_UART_Transmit_DMA(&SPP_DEBUG_UART, (uint8_t*)data, strlen(data));
 	HAL_Delay(5);
     return SPP_OK;
@@ -222,19 +225,16 @@ SPP_error SPP_send_TM(SPP_header_t* resp_SPP_header, PUS_TM_header_t* response_s
     SPP_prepare_full_msg(resp_SPP_header, response_secondary_header, data, data_len, response_TM_packet, &packet_total_len);
 
     uint16_t cobs_packet_total_len = COBS_encode(response_TM_packet, packet_total_len, response_TM_packet_COBS);
- 
-    memcpy(OBCTxBuffer, response_TM_packet_COBS, cobs_packet_total_len);
-    SPP_UART_transmit_DMA(OBCTxBuffer, cobs_packet_total_len);
+
+    // Frames are queued for the downlink scheduler, which also adds the sentinel value.
+    DL_enqueue(DL_classify(resp_SPP_header, response_secondary_header), response_TM_packet_COBS, cobs_packet_total_len);
     return SPP_OK;
 }
 
 
 
-// Test function to check if decodeing and encoding and data seperation works correctly.
+// Decodes a COBS framed TC from the given source and processes it.
 SPP_error SPP_handle_incoming_TC(SPP_TC_source source) {
-    SPP_error result_code = SPP_OK;
-    bool CRC_correct = true;
-
     uint8_t* recv_buffer;
     uint8_t* packet_buffer; 
 
@@ -253,6 +253,18 @@ SPP_error SPP_handle_incoming_TC(SPP_TC_source source) {
 
     COBS_decode(recv_buffer, COBS_FRAME_LEN, packet_buffer);
 
+    SPP_error result_code = SPP_process_TC_packet(packet_buffer);
+
+    SPP_reset_UART_recv_DMA();
+    return result_code;
+}
+
+
+// Processes a decoded space packet. Also used by the time-based scheduler to release TCs.
+SPP_error SPP_process_TC_packet(uint8_t* packet_buffer) {
+    SPP_error result_code = SPP_OK;
+    bool CRC_correct = true;
+
     SPP_header_t primary_header;
     SPP_decode_header(packet_buffer, &primary_header);
     uint16_t space_packet_length = primary_header.packet_data_length + SPP_PRIMARY_HEADER_LEN + 1;
@@ -284,6 +296,9 @@ SPP_error SPP_handle_incoming_TC(SPP_TC_source source) {
             else if (PUS_TC_header.service_type_id == FUNCTION_MANAGEMNET_ID) {
                 SPP_handle_FM_TC(&primary_header, &PUS_TC_header, data);
             }
+            else if (PUS_TC_header.service_type_id == TIME_BASED_SCHEDULING_ID) {
+                SPP_handle_TBS_TC(&primary_header, &PUS_TC_header, data);
+            }
             else if (PUS_TC_header.service_type_id == TEST_SERVICE_ID) {
                 SPP_handle_TEST_TC(&primary_header, &PUS_TC_header);
             } else {
@@ -307,7 +322,6 @@ SPP_error SPP_handle_incoming_TC(SPP_TC_source source) {
             
         }
     }
-    SPP_reset_UART_recv_DMA();
     return result_code;
 }
 
@@ -27,6 +27,7 @@
 /* USER CODE END FirstSection */
 /* Includes ------------------------------------------------------------------*/
 #include "bsp_driver_sd.h"
+#include <string.h>
 
 /* Extern variables ---------------------------------------------------------*/
 
@@ -34,6 +35,17 @@ extern SD_HandleTypeDef hsd1;
 
 /* USER CODE BEGIN BeforeInitSection */
 /* can be used to modify / undefine following code or add code */
+static uint8_t SD_TrainClock(void);
+
+/* Current bus speed and the highest speed training may select. The limit is lowered
+   at runtime after repeated CRC or timeout errors and survives re-initialisation. */
+static uint8_t sd_speed = BSP_SD_SPEED_SAFE;
+static uint8_t sd_speed_limit = BSP_SD_SPEED_HIGH;
+static volatile uint8_t sd_consecutive_errors = 0;
+static uint32_t sd_fallbacks = 0;
+
+static uint32_t sd_test_ref[BSP_SD_TEST_BLOCKS * BLOCKSIZE / 4];
+static uint32_t sd_test_read[BSP_SD_TEST_BLOCKS * BLOCKSIZE / 4];
 /* USER CODE END BeforeInitSection */
 /**
   * @brief  Initializes the SD card device.
@@ -58,11 +70,188 @@ uint8_t BSP_SD_Init(void)
       sd_state = MSD_ERROR;
     }
   }
+  /* Switch to high speed mode and raise the clock as far as the card reads back reliably */
+  if (sd_state == MSD_OK)
+  {
+    sd_state = SD_TrainClock();
+  }
 
   return sd_state;
 }
 /* USER CODE BEGIN AfterInitSection */
 /* can be used to modify previous code / undefine following code / add code */
+/**
+  * @brief  Sets the SDMMC clock for a speed level, keeping the 4-bit bus.
+  * @param  speed: BSP_SD_SPEED_SAFE, BSP_SD_SPEED_DEFAULT or BSP_SD_SPEED_HIGH
+  * @retval None
+  */
+static void SD_SetSpeed(uint8_t speed)
+{
+  SDMMC_InitTypeDef init = hsd1.Init;
+
+  init.BusWide = SDMMC_BUS_WIDE_4B;
+  init.ClockBypass = (speed == BSP_SD_SPEED_HIGH) ? SDMMC_CLOCK_BYPASS_ENABLE : SDMMC_CLOCK_BYPASS_DISABLE;
+  init.ClockDiv = (speed == BSP_SD_SPEED_SAFE) ? BSP_SD_SAFE_CLOCK_DIV : 0U;
+  SDMMC_Init(hsd1.Instance, init);
+
+  sd_speed = speed;
+}
+
+/**
+  * @brief  Sends CMD6 (SWITCH_FUNC) and reads the 512-bit switch status.
+  * @param  argument: CMD6 argument, mode in bit 31 and one function per group nibble
+  * @param  status: 64 byte buffer, in the order the card sends it
+  * @retval SD status
+  */
+static uint8_t SD_SwitchFunction(uint32_t argument, uint8_t *status)
+{
+  SDMMC_DataInitTypeDef config;
+  uint32_t *words = (uint32_t *)status;
+  uint32_t count = 0U;
+  uint32_t tickstart = HAL_GetTick();
+  uint8_t sd_state = MSD_OK;
+
+  hsd1.Instance->DCTRL = 0U;
+  if (SDMMC_CmdBlockLength(hsd1.Instance, 64U) != HAL_SD_ERROR_NONE)
+  {
+    return MSD_ERROR;
+  }
+
+  config.DataTimeOut   = SDMMC_DATATIMEOUT;
+  config.DataLength    = 64U;
+  config.DataBlockSize = SDMMC_DATABLOCK_SIZE_64B;
+  config.TransferDir   = SDMMC_TRANSFER_DIR_TO_SDMMC;
+  config.TransferMode  = SDMMC_TRANSFER_MODE_BLOCK;
+  config.DPSM          = SDMMC_DPSM_ENABLE;
+  SDMMC_ConfigData(hsd1.Instance, &config);
+
+  if (SDMMC_CmdSwitch(hsd1.Instance, argument) != HAL_SD_ERROR_NONE)
+  {
+    sd_state = MSD_ERROR;
+  }
+
+  while (sd_state == MSD_OK &&
+         !__SDMMC_GET_FLAG(hsd1.Instance, SDMMC_FLAG_RXOVERR | SDMMC_FLAG_DCRCFAIL | SDMMC_FLAG_DTIMEOUT | SDMMC_FLAG_DBCKEND))
+  {
+    if (__SDMMC_GET_FLAG(hsd1.Instance, SDMMC_FLAG_RXDAVL) && count < 16U)
+    {
+      words[count++] = SDMMC_ReadFIFO(hsd1.Instance);
+    }
+    if ((HAL_GetTick() - tickstart) >= BSP_SD_TEST_TIMEOUT)
+    {
+      sd_state = MSD_ERROR;
+    }
+  }
+
+  if (__SDMMC_GET_FLAG(hsd1.Instance, SDMMC_FLAG_RXOVERR | SDMMC_FLAG_DCRCFAIL | SDMMC_FLAG_DTIMEOUT))
+  {
+    sd_state = MSD_ERROR;
+  }
+  while (__SDMMC_GET_FLAG(hsd1.Instance, SDMMC_FLAG_RXDAVL) && count < 16U)
+  {
+    words[count++] = SDMMC_ReadFIFO(hsd1.Instance);
+  }
+  __SDMMC_CLEAR_FLAG(hsd1.Instance, SDMMC_STATIC_FLAGS);
+
+  if (SDMMC_CmdBlockLength(hsd1.Instance, BLOCKSIZE) != HAL_SD_ERROR_NONE || count != 16U)
+  {
+    sd_state = MSD_ERROR;
+  }
+
+  return sd_state;
+}
+
+/**
+  * @brief  Switches the card to high speed mode (function 1 of group 1).
+  * @retval SD status, MSD_ERROR if the card does not support it
+  */
+static uint8_t SD_SwitchHighSpeed(void)
+{
+  uint8_t status[64];
+
+  /* Check mode first, bit 1 of byte 13 is set if high speed is supported */
+  if (SD_SwitchFunction(0x00FFFFF1U, status) != MSD_OK || (status[13] & 0x02U) == 0U)
+  {
+    return MSD_ERROR;
+  }
+  /* The function group 1 result is in the low nibble of byte 16 */
+  if (SD_SwitchFunction(0x80FFFFF1U, status) != MSD_OK || (status[16] & 0x0FU) != 0x01U)
+  {
+    return MSD_ERROR;
+  }
+
+  return MSD_OK;
+}
+
+/**
+  * @brief  Reads the test blocks at the current speed and compares them to the reference.
+  * @retval SD status
+  */
+static uint8_t SD_VerifyReadBack(void)
+{
+  if (HAL_SD_ReadBlocks(&hsd1, (uint8_t *)sd_test_read, 0U, BSP_SD_TEST_BLOCKS, BSP_SD_TEST_TIMEOUT) != HAL_OK)
+  {
+    return MSD_ERROR;
+  }
+
+  return (memcmp(sd_test_ref, sd_test_read, sizeof(sd_test_ref)) == 0) ? MSD_OK : MSD_ERROR;
+}
+
+/**
+  * @brief  Steps the clock up from the safe speed to sd_speed_limit. The first blocks of the
+  *         card are read at the safe speed as the test pattern and every step has to read
+  *         them back identically, otherwise the previous step is kept. The pattern is only
+  *         read, so training never writes outside the file system.
+  * @retval SD status
+  */
+static uint8_t SD_TrainClock(void)
+{
+  SD_SetSpeed(BSP_SD_SPEED_SAFE);
+
+  if (HAL_SD_ReadBlocks(&hsd1, (uint8_t *)sd_test_ref, 0U, BSP_SD_TEST_BLOCKS, BSP_SD_TEST_TIMEOUT) != HAL_OK)
+  {
+    return MSD_ERROR;
+  }
+
+  for (uint8_t speed = BSP_SD_SPEED_DEFAULT; speed <= sd_speed_limit; speed++)
+  {
+    if (speed == BSP_SD_SPEED_HIGH && SD_SwitchHighSpeed() != MSD_OK)
+    {
+      break;
+    }
+
+    uint8_t previous = sd_speed;
+    SD_SetSpeed(speed);
+
+    if (SD_VerifyReadBack() != MSD_OK)
+    {
+      SD_SetSpeed(previous);
+      break;
+    }
+  }
+
+  sd_consecutive_errors = 0;
+
+  return MSD_OK;
+}
+
+/**
+  * @brief  Gets the current SD bus speed level.
+  * @retval BSP_SD_SPEED_SAFE, BSP_SD_SPEED_DEFAULT or BSP_SD_SPEED_HIGH
+  */
+uint8_t BSP_SD_GetSpeed(void)
+{
+  return sd_speed;
+}
+
+/**
+  * @brief  Gets the number of runtime speed fallbacks since boot.
+  * @retval Number of fallbacks
+  */
+uint32_t BSP_SD_GetFallbacks(void)
+{
+  return sd_fallbacks;
+}
 /* USER CODE END AfterInitSection */
 
 /**
@@ -236,6 +425,7 @@ void HAL_SD_AbortCallback(SD_HandleTypeDef *hsd)
   */
 void HAL_SD_TxCpltCallback(SD_HandleTypeDef *hsd)
 {
+  sd_consecutive_errors = 0;
   BSP_SD_WriteCpltCallback();
 }
 
@@ -246,9 +436,34 @@ void HAL_SD_TxCpltCallback(SD_HandleTypeDef *hsd)
   */
 void HAL_SD_RxCpltCallback(SD_HandleTypeDef *hsd)
 {
+  sd_consecutive_errors = 0;
   BSP_SD_ReadCpltCallback();
 }
 
+/**
+  * @brief SD error callback. After BSP_SD_ERRORS_BEFORE_FALLBACK consecutive CRC or
+  *        timeout errors the clock is stepped down one level. The transfer has already
+  *        been aborted by the HAL, the retry of the caller runs at the lower speed.
+  * @param hsd: SD handle
+  * @retval None
+  */
+void HAL_SD_ErrorCallback(SD_HandleTypeDef *hsd)
+{
+  if ((hsd->ErrorCode & (HAL_SD_ERROR_DATA_CRC_FAIL | HAL_SD_ERROR_DATA_TIMEOUT |
+                         HAL_SD_ERROR_CMD_CRC_FAIL | HAL_SD_ERROR_CMD_RSP_TIMEOUT)) == 0U)
+  {
+    return;
+  }
+
+  if (++sd_consecutive_errors >= BSP_SD_ERRORS_BEFORE_FALLBACK && sd_speed > BSP_SD_SPEED_SAFE)
+  {
+    sd_speed_limit = sd_speed - 1U;
+    SD_SetSpeed(sd_speed_limit);
+    sd_consecutive_errors = 0;
+    sd_fallbacks++;
+  }
+}
+
 /* USER CODE BEGIN CallBacksSection_C */
 /**
   * @brief BSP SD Abort callback
@@ -0,0 +1,235 @@
+/*
+ * command_sequence.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "command_sequence.h"
+#include "cmsis_os.h"
+
+#define NO_SEQ_ID   0xFF
+
+/*  Sequence being executed. It is copied from FRAM when it is started and stepped from the
+ *  main loop by cmd_seq_process(), so the delays between commands never block the loop.
+ */
+static struct {
+    bool     running;
+    uint8_t  N_left;            // Commands not sent yet
+    uint16_t pos;               // Entry of the next command in data
+    uint32_t release_tick;      // Tick at which the next command is due
+    uint8_t  data[CMD_SEQ_MAX_DATA_LEN];
+} cmd_seq_run = { .running = false };
+
+typedef struct {
+    uint8_t  magic;
+    uint8_t  N_cmds;
+    uint16_t used_len;
+} CMD_seq_header_t;
+
+
+static inline uint16_t get_cmd_seq_address(uint8_t seq_id) {
+    return FRAM_CMD_SEQ_SECTION_START + (seq_id * FRAM_CMD_SEQ_SIZE);
+}
+
+
+static SPP_error read_cmd_seq_header(uint8_t seq_id, CMD_seq_header_t* header) {
+    uint8_t raw[CMD_SEQ_HEADER_LEN];
+    if (readFRAM(get_cmd_seq_address(seq_id), raw, CMD_SEQ_HEADER_LEN) != HAL_OK) {
+        return UNDEFINED_ERROR;
+    }
+    header->magic = raw[0];
+    header->N_cmds = raw[1];
+    memcpy(&header->used_len, raw + 2, sizeof(header->used_len));
+
+    // Slot never written or corrupted, treat it as empty.
+    if (header->magic != CMD_SEQ_MAGIC || header->used_len > CMD_SEQ_MAX_DATA_LEN) {
+        header->magic = CMD_SEQ_MAGIC;
+        header->N_cmds = 0;
+        header->used_len = 0;
+    }
+    return SPP_OK;
+}
+
+
+static SPP_error write_cmd_seq_header(uint8_t seq_id, CMD_seq_header_t* header) {
+    uint8_t raw[CMD_SEQ_HEADER_LEN];
+    raw[0] = header->magic;
+    raw[1] = header->N_cmds;
+    memcpy(raw + 2, &header->used_len, sizeof(header->used_len));
+    if (writeFRAM(get_cmd_seq_address(seq_id), raw, CMD_SEQ_HEADER_LEN) != HAL_OK) {
+        return UNDEFINED_ERROR;
+    }
+    return SPP_OK;
+}
+
+
+SPP_error cmd_seq_clear(uint8_t seq_id) {
+    if (seq_id >= FRAM_CMD_SEQ_COUNT) {
+        return SPP_PUS8_ERROR;
+    }
+    CMD_seq_header_t header = {
+        .magic      = CMD_SEQ_MAGIC,
+        .N_cmds     = 0,
+        .used_len   = 0,
+    };
+    return write_cmd_seq_header(seq_id, &header);
+}
+
+
+// cmd is a Langmuir function as it appears in a PUS 8 perform function TC: func_id, N_args, arguments.
+SPP_error cmd_seq_append(uint8_t seq_id, uint16_t delay_ms, uint8_t* cmd, uint8_t cmd_len) {
+    if (seq_id >= FRAM_CMD_SEQ_COUNT || cmd_len < 2) {
+        return SPP_PUS8_ERROR;
+    }
+    if (!is_langmuir_func(cmd[0])) {
+        return SPP_PUS8_ERROR;
+    }
+
+    CMD_seq_header_t header;
+    if (read_cmd_seq_header(seq_id, &header) != SPP_OK) {
+        return UNDEFINED_ERROR;
+    }
+    if (header.used_len + CMD_SEQ_ENTRY_HDR_LEN + cmd_len > CMD_SEQ_MAX_DATA_LEN) {
+        return SPP_PUS8_ERROR;
+    }
+
+    uint8_t entry[CMD_SEQ_ENTRY_HDR_LEN + CMD_SEQ_MAX_DATA_LEN];
+    memcpy(entry, &delay_ms, sizeof(delay_ms));
+    entry[2] = cmd_len;
+    memcpy(entry + CMD_SEQ_ENTRY_HDR_LEN, cmd, cmd_len);
+
+    uint16_t entry_address = get_cmd_seq_address(seq_id) + CMD_SEQ_HEADER_LEN + header.used_len;
+    if (writeFRAM(entry_address, entry, CMD_SEQ_ENTRY_HDR_LEN + cmd_len) != HAL_OK) {
+        return UNDEFINED_ERROR;
+    }
+
+    // Header is only updated after the entry itself is in FRAM.
+    header.N_cmds++;
+    header.used_len += CMD_SEQ_ENTRY_HDR_LEN + cmd_len;
+    return write_cmd_seq_header(seq_id, &header);
+}
+
+
+static uint16_t get_entry_delay(uint16_t pos) {
+    uint16_t delay_ms;
+    memcpy(&delay_ms, cmd_seq_run.data + pos, sizeof(delay_ms));
+    return delay_ms;
+}
+
+
+/*  Reads the whole sequence from FRAM once and starts it. Every entry is checked before the
+ *  first command is sent, the commands themselves are sent by cmd_seq_process(). Only one
+ *  sequence runs at a time.
+ */
+SPP_error cmd_seq_execute(uint8_t seq_id) {
+    if (seq_id >= FRAM_CMD_SEQ_COUNT || cmd_seq_run.running) {
+        return SPP_PUS8_ERROR;
+    }
+
+    CMD_seq_header_t header;
+    if (read_cmd_seq_header(seq_id, &header) != SPP_OK) {
+        return UNDEFINED_ERROR;
+    }
+    if (header.N_cmds == 0) {
+        return SPP_OK;
+    }
+
+    if (readFRAM(get_cmd_seq_address(seq_id) + CMD_SEQ_HEADER_LEN, cmd_seq_run.data, header.used_len) != HAL_OK) {
+        return UNDEFINED_ERROR;
+    }
+
+    uint16_t pos = 0;
+    for (uint8_t i = 0; i < header.N_cmds; i++) {
+        if (pos + CMD_SEQ_ENTRY_HDR_LEN > header.used_len) {
+            return UNDEFINED_ERROR;
+        }
+        pos += CMD_SEQ_ENTRY_HDR_LEN + cmd_seq_run.data[pos + 2];
+        if (pos > header.used_len) {
+            return UNDEFINED_ERROR;
+        }
+    }
+
+    cmd_seq_run.N_left = header.N_cmds;
+    cmd_seq_run.pos = 0;
+    cmd_seq_run.release_tick = xTaskGetTickCount() + get_entry_delay(0);
+    cmd_seq_run.running = true;
+    cmd_seq_process(xTaskGetTickCount());
+    return SPP_OK;
+}
+
+
+// Called from the main loop. Sends every command that is due, delay_ms counts from the previous command.
+void cmd_seq_process(uint32_t current_ticks) {
+    while (cmd_seq_run.running && (int32_t)(current_ticks - cmd_seq_run.release_tick) >= 0) {
+        uint8_t* cmd = cmd_seq_run.data + cmd_seq_run.pos + CMD_SEQ_ENTRY_HDR_LEN;
+        uint8_t  cmd_len = cmd_seq_run.data[cmd_seq_run.pos + 2];
+
+        uint8_t func_id = cmd[0];
+        uint8_t N_args = cmd[1];
+        FPGA_msg_arg_t fpgama;
+        decode_FPGA_msg_args(N_args, cmd + 2, &fpgama);
+        send_FPGA_langmuir_msg(func_id, &fpgama);
+
+        cmd_seq_run.pos += CMD_SEQ_ENTRY_HDR_LEN + cmd_len;
+        if (--cmd_seq_run.N_left == 0) {
+            cmd_seq_run.running = false;
+        } else {
+            cmd_seq_run.release_tick += get_entry_delay(cmd_seq_run.pos);
+        }
+    }
+}
+
+
+static uint8_t get_seq_id_arg(uint8_t N_args, uint8_t* data) {
+    uint8_t seq_id = NO_SEQ_ID;
+    for (int i = 0; i < N_args; i++) {
+        uint8_t arg_ID = *data++;
+        if (arg_ID == SEQ_ID_ARG_ID) {
+            seq_id = *data++;
+        } else {
+            data += FPGA_arg_width(arg_ID);
+        }
+    }
+    return seq_id;
+}
+
+
+SPP_error handle_cmd_seq_clear(uint8_t N_args, uint8_t* data) {
+    return cmd_seq_clear(get_seq_id_arg(N_args, data));
+}
+
+
+SPP_error handle_cmd_seq_execute(uint8_t N_args, uint8_t* data) {
+    return cmd_seq_execute(get_seq_id_arg(N_args, data));
+}
+
+
+SPP_error handle_cmd_seq_append(uint8_t N_args, uint8_t* data) {
+    uint8_t  seq_id = NO_SEQ_ID;
+    uint16_t delay_ms = 0;
+
+    for (int i = 0; i < N_args; i++) {
+        uint8_t arg_ID = *data++;
+        switch (arg_ID) {
+            case SEQ_ID_ARG_ID:
+                seq_id = *data++;
+                break;
+            case DELAY_MS_ARG_ID:
+                memcpy(&delay_ms, data, sizeof(delay_ms));
+                data += sizeof(delay_ms);
+                break;
+            case SEQ_CMD_ARG_ID:
+            {
+                uint16_t args_len = FPGA_msg_args_len(data[1], data + 2);
+                if (data[1] > 0 && args_len == 0) {
+                    return SPP_PUS8_ERROR;
+                }
+                return cmd_seq_append(seq_id, delay_ms, data, 2 + args_len);
+            }
+            default:
+                data += FPGA_arg_width(arg_ID);
+                break;
+        }
+    }
+    return SPP_PUS8_ERROR; // No command given.
+}
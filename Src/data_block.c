@@ -0,0 +1,384 @@
+/*
+ * data_block.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "data_block.h"
+#include "scientific_data.h"
+#include <string.h>
+
+#define DBLK_CRC_POLY           0xEDB88320 // Reflected 0x04C11DB7
+#define DBLK_HEADER_CRC_LEN     (sizeof(DBLK_header_t) - sizeof(uint32_t))
+
+static uint32_t DBLK_CRC_table[256];
+static uint8_t  DBLK_CRC_table_ready = 0;
+
+// One sector of file data at a time for the scanner
+static uint8_t  DBLK_work[DBLK_HEADER_LEN] __ALIGNED(32);
+
+
+static void build_CRC_table() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ DBLK_CRC_POLY : (crc >> 1);
+        }
+        DBLK_CRC_table[i] = crc;
+    }
+    DBLK_CRC_table_ready = 1;
+}
+
+
+/*  CRC-32 as used by zlib and Ethernet. Start with crc = 0, pass the result of the previous
+ *  call to continue over more data.
+ */
+uint32_t DBLK_CRC32(uint32_t crc, const uint8_t* data, uint32_t len) {
+    if (!DBLK_CRC_table_ready) {
+        build_CRC_table();
+    }
+    crc = ~crc;
+    while (len--) {
+        crc = DBLK_CRC_table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+
+void DBLK_fill_header(uint8_t* header, uint32_t file_ID, uint32_t sequence, uint64_t time_us,
+                      const uint8_t* payload, uint32_t payload_len, uint32_t overflows) {
+    DBLK_header_t h = {
+        .magic          = DBLK_MAGIC,
+        .version        = DBLK_VERSION,
+        .header_len     = DBLK_HEADER_LEN,
+        .file_ID        = file_ID,
+        .sequence       = sequence,
+        .time_us        = time_us,
+        .payload_len    = payload_len,
+        .payload_CRC    = DBLK_CRC32(0, payload, payload_len),
+        .overflows      = overflows,
+        .sample_seq     = DBLK_first_sample_seq(payload, payload_len),
+    };
+    h.header_CRC = DBLK_CRC32(0, (uint8_t*) &h, DBLK_HEADER_CRC_LEN);
+
+    memset(header, 0, DBLK_HEADER_LEN);
+    memcpy(header, (uint8_t*) &h, sizeof(h));
+}
+
+
+/*  Sequence number of the first CB frame in the payload. The frame cut at the start of the
+ *  buffer and SWT frames can hold preamble values in their data, so a CB frame is only taken
+ *  as such if the next CB frame in sequence follows it.
+ */
+uint32_t DBLK_first_sample_seq(const uint8_t* payload, uint32_t payload_len) {
+    uint32_t end = (payload_len < DBLK_SAMPLE_SEARCH_LEN) ? payload_len : DBLK_SAMPLE_SEARCH_LEN;
+
+    for (uint32_t pos = 0; pos + SC_CB_FRAME_LEN + 3 <= end; pos++) {
+        const uint8_t* next = &payload[pos + SC_CB_FRAME_LEN];
+        uint16_t seq, next_seq;
+
+        if (payload[pos] != SCIENTIFIC_DATA_PREAMBLE || next[0] != SCIENTIFIC_DATA_PREAMBLE) {
+            continue;
+        }
+        memcpy(&seq, &payload[pos + 1], sizeof(seq));
+        memcpy(&next_seq, &next[1], sizeof(next_seq));
+        if (next_seq == (uint16_t) (seq + 1)) {
+            return seq;
+        }
+    }
+    return DBLK_NO_SAMPLE_SEQ;
+}
+
+
+// Returns 1 and the decoded header if the magic, version, length and header CRC are valid.
+uint8_t DBLK_check_header(const uint8_t* header, DBLK_header_t* out) {
+    memcpy((uint8_t*) out, header, sizeof(DBLK_header_t));
+
+    if (out->magic != DBLK_MAGIC || out->version != DBLK_VERSION || out->header_len != DBLK_HEADER_LEN) {
+        return 0;
+    }
+    return DBLK_CRC32(0, header, DBLK_HEADER_CRC_LEN) == out->header_CRC;
+}
+
+
+static FRESULT payload_CRC(FIL* fp, FSIZE_t pos, uint32_t len, uint32_t* crc) {
+    FRESULT res = f_lseek(fp, pos);
+    *crc = 0;
+
+    while (res == FR_OK && len > 0) {
+        UINT chunk = (len > sizeof(DBLK_work)) ? sizeof(DBLK_work) : len;
+        UINT read = 0;
+        res = f_read(fp, DBLK_work, chunk, &read);
+        if (res == FR_OK && read != chunk) {
+            res = FR_INT_ERR;
+        }
+        if (res == FR_OK) {
+            *crc = DBLK_CRC32(*crc, DBLK_work, chunk);
+            len -= chunk;
+        }
+    }
+    return res;
+}
+
+
+/*  Walks the blocks of a data file from the start and finds where its valid data ends.
+ *  Headers are checked for every block. Payload CRCs are checked for every block only with
+ *  verify_all, otherwise only for the last block with a valid header, which is the one a
+ *  power loss can leave with a valid header and a partly written payload.
+ *  If index is not NULL, an entry is appended to it for every DBLK_INDEX_INTERVAL-th block
+ *  with a valid header. The caller drops the entries past scan->blocks afterwards.
+ */
+FRESULT DBLK_scan(FIL* fp, FIL* index, uint8_t verify_all, DBLK_scan_t* scan) {
+    DBLK_header_t header;
+    FSIZE_t pos = 0;
+    FSIZE_t last_pos = 0;
+    uint32_t last_payload_len = 0;
+    uint32_t last_payload_CRC = 0;
+    uint32_t prev_sequence = 0;     // Sequence of the block before the last valid one
+    uint32_t last_gap = 0;          // Sequence numbers skipped before the last valid block
+    uint32_t crc;
+    FRESULT res = FR_OK;
+
+    memset(scan, 0, sizeof(DBLK_scan_t));
+    scan->file_len = f_size(fp);
+    scan->stop_reason = DBLK_SCAN_END;
+
+    while (pos + DBLK_HEADER_LEN <= scan->file_len) {
+        UINT read = 0;
+        res = f_lseek(fp, pos);
+        if (res == FR_OK) {
+            res = f_read(fp, DBLK_work, DBLK_HEADER_LEN, &read);
+        }
+        if (res != FR_OK) {
+            return res;
+        }
+
+        if (read != DBLK_HEADER_LEN || !DBLK_check_header(DBLK_work, &header)) {
+            scan->stop_reason = DBLK_SCAN_BAD_HEADER;
+            break;
+        }
+        // Buffers given up after write errors leave gaps, stale blocks never have a higher sequence
+        if (scan->blocks > 0 && (header.file_ID != scan->file_ID || header.sequence <= scan->last_sequence)) {
+            scan->stop_reason = DBLK_SCAN_BAD_SEQUENCE;
+            break;
+        }
+
+        FSIZE_t end = pos + DBLK_HEADER_LEN + header.payload_len;
+        if (end > scan->file_len) {
+            scan->stop_reason = DBLK_SCAN_TRUNCATED;
+            break;
+        }
+
+        if (verify_all) {
+            res = payload_CRC(fp, pos + DBLK_HEADER_LEN, header.payload_len, &crc);
+            if (res != FR_OK) {
+                return res;
+            }
+            if (crc != header.payload_CRC) {
+                scan->stop_reason = DBLK_SCAN_BAD_PAYLOAD;
+                break;
+            }
+        }
+
+        if (scan->blocks == 0) {
+            scan->file_ID = header.file_ID;
+            scan->first_sequence = header.sequence;
+        }
+        if (index != NULL && scan->blocks % DBLK_INDEX_INTERVAL == 0) {
+            res = DBLK_index_add(index, &header, (uint32_t) pos);
+            if (res != FR_OK) {
+                return res;
+            }
+        }
+        last_gap = (scan->blocks > 0) ? header.sequence - scan->last_sequence - 1 : 0;
+        scan->missing += last_gap;
+        prev_sequence = scan->last_sequence;
+        scan->blocks++;
+        scan->last_sequence = header.sequence;
+        last_pos = pos;
+        last_payload_len = header.payload_len;
+        last_payload_CRC = header.payload_CRC;
+        pos = end;
+    }
+
+    if (!verify_all && scan->blocks > 0) {
+        res = payload_CRC(fp, last_pos + DBLK_HEADER_LEN, last_payload_len, &crc);
+        if (res != FR_OK) {
+            return res;
+        }
+        if (crc != last_payload_CRC) {
+            scan->blocks--;
+            scan->last_sequence = prev_sequence;
+            scan->missing -= last_gap;
+            if (scan->blocks == 0) {
+                scan->file_ID = 0;
+                scan->first_sequence = 0;
+                scan->last_sequence = 0;
+            }
+            scan->stop_reason = DBLK_SCAN_BAD_PAYLOAD;
+            pos = last_pos;
+        }
+    }
+
+    scan->valid_len = pos;
+    return FR_OK;
+}
+
+
+/*  Scans a data file and truncates it after its last valid block. Files without any valid
+ *  block are left untouched, they may be in an older format. If index_path is not NULL the
+ *  index sidecar is rebuilt from the scan, it may have missed entries since its last sync.
+ */
+FRESULT DBLK_recover(const TCHAR* path, const TCHAR* index_path, uint8_t verify_all, DBLK_scan_t* scan) {
+    FIL file;
+    FIL index;
+    uint8_t index_open = 0;
+
+    FRESULT res = f_open(&file, path, FA_READ | FA_WRITE);
+    if (res != FR_OK) {
+        return res;
+    }
+
+    if (index_path != NULL && f_open(&index, index_path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK) {
+        index_open = (f_lseek(&index, sizeof(DBLK_index_header_t)) == FR_OK);
+    }
+
+    res = DBLK_scan(&file, index_open ? &index : NULL, verify_all, scan);
+
+    if (res == FR_OK && scan->blocks > 0 && scan->valid_len < scan->file_len) {
+        res = f_lseek(&file, scan->valid_len);
+        if (res == FR_OK) {
+            res = f_truncate(&file);
+        }
+    }
+
+    if (index_open) {
+        // Entries were added for blocks 0, N, 2N, ... of those with a valid header
+        uint32_t N_entries = (scan->blocks + DBLK_INDEX_INTERVAL - 1) / DBLK_INDEX_INTERVAL;
+        DBLK_index_header_t header = {
+            .magic      = DBLK_INDEX_MAGIC,
+            .version    = DBLK_INDEX_VERSION,
+            .entry_len  = sizeof(DBLK_index_entry_t),
+            .file_ID    = scan->file_ID,
+            .interval   = DBLK_INDEX_INTERVAL,
+        };
+        UINT written = 0;
+
+        if (res == FR_OK) {
+            f_lseek(&index, sizeof(header) + N_entries * sizeof(DBLK_index_entry_t));
+            f_truncate(&index);
+            f_lseek(&index, 0);
+            f_write(&index, (uint8_t*) &header, sizeof(header), &written);
+        }
+        f_close(&index);
+    }
+
+    FRESULT close_res = f_close(&file);
+    return (res != FR_OK) ? res : close_res;
+}
+
+
+// Creates the index sidecar of a new data file.
+FRESULT DBLK_index_create(FIL* index, const TCHAR* path, uint32_t file_ID) {
+    DBLK_index_header_t header = {
+        .magic      = DBLK_INDEX_MAGIC,
+        .version    = DBLK_INDEX_VERSION,
+        .entry_len  = sizeof(DBLK_index_entry_t),
+        .file_ID    = file_ID,
+        .interval   = DBLK_INDEX_INTERVAL,
+    };
+    UINT written = 0;
+
+    FRESULT res = f_open(index, path, FA_CREATE_ALWAYS | FA_WRITE);
+    if (res != FR_OK) {
+        return res;
+    }
+    res = f_write(index, (uint8_t*) &header, sizeof(header), &written);
+    if (res == FR_OK && written != sizeof(header)) {
+        res = FR_DENIED;
+    }
+    if (res != FR_OK) {
+        f_close(index);
+    }
+    return res;
+}
+
+
+// Appends the entry of a block at the current end of the index.
+FRESULT DBLK_index_add(FIL* index, const DBLK_header_t* header, uint32_t offset) {
+    DBLK_index_entry_t entry = {
+        .sequence   = header->sequence,
+        .offset     = offset,
+        .time_us    = header->time_us,
+        .overflows  = header->overflows,
+        .sample_seq = header->sample_seq,
+    };
+    UINT written = 0;
+
+    FRESULT res = f_write(index, (uint8_t*) &entry, sizeof(entry), &written);
+    if (res == FR_OK && written != sizeof(entry)) {
+        res = FR_DENIED;
+    }
+    return res;
+}
+
+
+static FRESULT read_entry(FIL* index, uint32_t i, DBLK_index_entry_t* entry) {
+    UINT read = 0;
+    FRESULT res = f_lseek(index, sizeof(DBLK_index_header_t) + i * sizeof(DBLK_index_entry_t));
+    if (res == FR_OK) {
+        res = f_read(index, (uint8_t*) entry, sizeof(DBLK_index_entry_t), &read);
+    }
+    if (res == FR_OK && read != sizeof(DBLK_index_entry_t)) {
+        res = FR_INT_ERR;
+    }
+    return res;
+}
+
+
+/*  Finds the last index entry at or before time_us, or the first entry if time_us is before
+ *  all of them. Reading the data file from entry->offset reaches time_us within at most
+ *  DBLK_INDEX_INTERVAL blocks. N_entries is set to the number of entries in the index.
+ */
+FRESULT DBLK_index_find(const TCHAR* path, uint64_t time_us, DBLK_index_entry_t* entry, uint32_t* N_entries) {
+    FIL index;
+    DBLK_index_header_t header;
+    UINT read = 0;
+
+    *N_entries = 0;
+    FRESULT res = f_open(&index, path, FA_READ);
+    if (res != FR_OK) {
+        return res;
+    }
+
+    res = f_read(&index, (uint8_t*) &header, sizeof(header), &read);
+    if (res == FR_OK && (read != sizeof(header) || header.magic != DBLK_INDEX_MAGIC ||
+                         header.version != DBLK_INDEX_VERSION || header.entry_len != sizeof(DBLK_index_entry_t))) {
+        res = FR_INT_ERR;
+    }
+    if (res == FR_OK) {
+        *N_entries = (f_size(&index) - sizeof(header)) / sizeof(DBLK_index_entry_t);
+        if (*N_entries == 0) {
+            res = FR_NO_FILE;
+        }
+    }
+
+    // Last entry with a time not after time_us
+    uint32_t lo = 0;
+    uint32_t hi = *N_entries;
+    while (res == FR_OK && hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        res = read_entry(&index, mid, entry);
+        if (entry->time_us <= time_us) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    if (res == FR_OK) {
+        res = read_entry(&index, lo, entry);
+    }
+
+    f_close(&index);
+    return res;
+}
@@ -0,0 +1,238 @@
+/*
+ * downlink_scheduler.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "downlink_scheduler.h"
+#include "langmuir_probe_bias.h"
+#include "scientific_data.h"
+#include "IV_analysis.h"
+
+/*  Downlink scheduler for the OBC UART.
+ *
+ *  SPP_send_TM() queues every encoded TM frame in the queue of its class. The main loop
+ *  sends one frame at a time with interrupt driven transmission (mirrored to the debug UART
+ *  by DMA) and picks the next frame once both UARTs are idle:
+ *  - a queued verification frame is always sent first,
+ *  - otherwise the highest priority class whose token bucket holds enough bytes for its
+ *    oldest frame. Buckets refill at the configured rate up to the burst size.
+ *  A full queue drops the new frame, except for lossless classes where the producer waits
+ *  up to DL_LOSSLESS_TIMEOUT for the queue to drain.
+ */
+#define DL_VERIF_DEPTH          4
+#define DL_HK_DEPTH             4
+#define DL_READBACK_DEPTH       8
+#define DL_EVENT_DEPTH          8  // A default event window is 4 packets
+#define DL_SCIENCE_DEPTH        12
+#define DL_BULK_DEPTH           12 // A full sweep record with sigma
+#define DL_TOTAL_DEPTH          (DL_VERIF_DEPTH + DL_HK_DEPTH + DL_READBACK_DEPTH + DL_EVENT_DEPTH + DL_SCIENCE_DEPTH + \
+                                 DL_BULK_DEPTH)
+
+typedef struct {
+    uint8_t  first_slot;
+    uint8_t  depth;
+    bool     lossless;
+    uint16_t rate;          // Token refill [bytes/s], unused for verification
+    uint16_t burst;         // Bucket size [bytes]
+    uint32_t tokens;        // [1/1000 bytes]
+    uint8_t  head;
+    uint8_t  count;
+    uint32_t dropped;
+} DL_queue_t;
+
+static DL_queue_t DL_queues[NOF_DL_CLASSES] = {
+    [DL_CLASS_VERIF]    = { .first_slot = 0,
+                            .depth = DL_VERIF_DEPTH,    .lossless = true,  .rate = 0,    .burst = DL_FRAME_LEN },
+    [DL_CLASS_HK]       = { .first_slot = DL_VERIF_DEPTH,
+                            .depth = DL_HK_DEPTH,       .lossless = false, .rate = 1000, .burst = 1024 },
+    [DL_CLASS_READBACK] = { .first_slot = DL_VERIF_DEPTH + DL_HK_DEPTH,
+                            .depth = DL_READBACK_DEPTH, .lossless = true,  .rate = 2000, .burst = 2048 },
+    [DL_CLASS_EVENT]    = { .first_slot = DL_VERIF_DEPTH + DL_HK_DEPTH + DL_READBACK_DEPTH,
+                            .depth = DL_EVENT_DEPTH,    .lossless = true,  .rate = 3000, .burst = 2048 },
+    [DL_CLASS_SCIENCE]  = { .first_slot = DL_VERIF_DEPTH + DL_HK_DEPTH + DL_READBACK_DEPTH + DL_EVENT_DEPTH,
+                            .depth = DL_SCIENCE_DEPTH,  .lossless = false, .rate = 6000, .burst = 2048 },
+    [DL_CLASS_BULK]     = { .first_slot = DL_VERIF_DEPTH + DL_HK_DEPTH + DL_READBACK_DEPTH + DL_EVENT_DEPTH + DL_SCIENCE_DEPTH,
+                            .depth = DL_BULK_DEPTH,     .lossless = false, .rate = 2000, .burst = 3072 },
+};
+
+// Classes of the packets without a PUS secondary header.
+static const struct {
+    uint16_t APID;
+    uint8_t  DL_class;
+} DL_APID_classes[] = {
+    { .APID = READBACK_APID,    .DL_class = DL_CLASS_READBACK },
+    { .APID = CB_SC_DATA_APID,  .DL_class = DL_CLASS_SCIENCE },
+    { .APID = CB_EVENT_APID,    .DL_class = DL_CLASS_EVENT },
+    { .APID = IV_PARAM_APID,    .DL_class = DL_CLASS_SCIENCE },
+    { .APID = SWT_SC_DATA_APID, .DL_class = DL_CLASS_BULK },
+};
+#define NOF_DL_APID_CLASSES     (sizeof(DL_APID_classes) / sizeof(DL_APID_classes[0]))
+
+DMA_BUFFER static uint8_t DL_frames[DL_TOTAL_DEPTH][DL_FRAME_LEN];
+static uint16_t DL_frame_lens[DL_TOTAL_DEPTH];
+static int8_t   DL_in_flight = -1;  // Class of the frame being transmitted
+static uint32_t DL_last_tick = 0;
+
+
+uint8_t DL_classify(SPP_header_t* SPP_header, PUS_TM_header_t* PUS_header) {
+    if (PUS_header != NULL) {
+        switch (PUS_header->service_type_id) {
+            case REQUEST_VERIFICATION_SERVICE_ID:
+            case TEST_SERVICE_ID:
+                return DL_CLASS_VERIF;
+            case HOUSEKEEPING_SERVICE_ID:
+                return DL_CLASS_HK;
+            default:
+                return DL_CLASS_READBACK;
+        }
+    }
+    for (int i = 0; i < NOF_DL_APID_CLASSES; i++) {
+        if (DL_APID_classes[i].APID == SPP_header->application_process_id) {
+            return DL_APID_classes[i].DL_class;
+        }
+    }
+    return DL_CLASS_BULK;
+}
+
+
+static bool DL_UARTs_idle() {
+    return SPP_OBC_UART.gState == HAL_UART_STATE_READY && SPP_DEBUG_UART.gState == HAL_UART_STATE_READY;
+}
+
+
+void DL_enqueue(uint8_t DL_class, uint8_t* frame, uint16_t frame_len) {
+    if (DL_class >= NOF_DL_CLASSES || frame_len > COBS_FRAME_LEN) {
+        return;
+    }
+    DL_queue_t* q = &DL_queues[DL_class];
+
+    if (q->count >= q->depth && q->lossless) {
+        uint32_t start_tick = xTaskGetTickCount();
+        while (q->count >= q->depth && (xTaskGetTickCount() - start_tick) < DL_LOSSLESS_TIMEOUT) {
+            DL_process(xTaskGetTickCount());
+        }
+    }
+    if (q->count >= q->depth) {
+        q->dropped++;
+        return;
+    }
+
+    uint8_t slot = q->first_slot + (q->head + q->count) % q->depth;
+    memcpy(DL_frames[slot], frame, frame_len);
+    DL_frames[slot][frame_len] = 0x00; // Sentinel value
+    DL_frame_lens[slot] = frame_len + 1;
+    q->count++;
+}
+
+
+static void refill_tokens(uint32_t current_ticks) {
+    uint32_t elapsed = current_ticks - DL_last_tick;
+    if (elapsed == 0) {
+        return;
+    }
+    DL_last_tick = current_ticks;
+
+    for (int i = 0; i < NOF_DL_CLASSES; i++) {
+        DL_queue_t* q = &DL_queues[i];
+        uint32_t max_tokens = (uint32_t) q->burst * 1000;
+        uint64_t tokens = q->tokens + (uint64_t) q->rate * elapsed; // bytes/s * ms
+        q->tokens = (tokens > max_tokens) ? max_tokens : (uint32_t) tokens;
+    }
+}
+
+
+// Called from the main loop and by lossless producers waiting for queue space.
+void DL_process(uint32_t current_ticks) {
+    refill_tokens(current_ticks);
+
+    if (!DL_UARTs_idle()) {
+        return;
+    }
+    if (DL_in_flight >= 0) {
+        DL_queue_t* q = &DL_queues[DL_in_flight];
+        q->head = (q->head + 1) % q->depth;
+        q->count--;
+        DL_in_flight = -1;
+    }
+
+    for (int i = 0; i < NOF_DL_CLASSES; i++) {
+        DL_queue_t* q = &DL_queues[i];
+        if (q->count == 0) {
+            continue;
+        }
+        uint8_t  slot = q->first_slot + q->head;
+        uint16_t len = DL_frame_lens[slot];
+        if (i != DL_CLASS_VERIF) {
+            if (q->tokens < (uint32_t) len * 1000) {
+                continue;
+            }
+            q->tokens -= (uint32_t) len * 1000;
+        }
+        DL_in_flight = i;
+        HAL_UART_Transmit_DMA(&SPP_DEBUG_UART, DL_frames[slot], len);
+        HAL_UART_Transmit_IT(&SPP_OBC_UART, DL_frames[slot], len);
+        return;
+    }
+}
+
+
+uint8_t DL_occupancy(uint8_t DL_class) {
+    return (DL_class < NOF_DL_CLASSES) ? DL_queues[DL_class].count : 0;
+}
+
+
+uint32_t DL_dropped(uint8_t DL_class) {
+    return (DL_class < NOF_DL_CLASSES) ? DL_queues[DL_class].dropped : 0;
+}
+
+
+/*  Token bucket of a downlink class (DL_CLASS_ARG_ID): refill rate in bytes/s (DL_RATE_ARG_ID)
+ *  and bucket size in bytes (DL_BURST_ARG_ID). The bucket has to hold at least one full frame.
+ *  Verification is not budgeted.
+ */
+SPP_error set_DL_budget(uint8_t N_args, uint8_t* data) {
+    uint8_t DL_class = 0xFF;
+    uint16_t rate = 0;
+    uint16_t burst = 0;
+    bool rate_set = false, burst_set = false;
+
+    for (int i = 0; i < N_args; i++) {
+        uint8_t arg_ID = *data++;
+        switch (arg_ID) {
+            case DL_CLASS_ARG_ID:
+                DL_class = *data++;
+                break;
+            case DL_RATE_ARG_ID:
+                memcpy(&rate, data, sizeof(rate));
+                data += sizeof(rate);
+                rate_set = true;
+                break;
+            case DL_BURST_ARG_ID:
+                memcpy(&burst, data, sizeof(burst));
+                data += sizeof(burst);
+                burst_set = true;
+                break;
+            default:
+                data += FPGA_arg_width(arg_ID);
+                break;
+        }
+    }
+    if (DL_class == DL_CLASS_VERIF || DL_class >= NOF_DL_CLASSES) {
+        return SPP_PUS8_ERROR;
+    }
+    DL_queue_t* q = &DL_queues[DL_class];
+    if (burst_set && burst < DL_FRAME_LEN) {
+        return SPP_PUS8_ERROR;
+    }
+    if (rate_set) {
+        q->rate = rate;
+    }
+    if (burst_set) {
+        q->burst = burst;
+        if (q->tokens > (uint32_t) burst * 1000) {
+            q->tokens = (uint32_t) burst * 1000;
+        }
+    }
+    return SPP_OK;
+}
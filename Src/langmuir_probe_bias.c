@@ -7,56 +7,77 @@
 
 #include "langmuir_probe_bias.h"
 #include "FPGA_UART.h"
-
-// ADD FPGA Function ID TO BOTH THE ENUM AND ARRAY!
+#include "FPGA_config_mirror.h"
+#include "scientific_data.h"
+#include "sweep_data.h"
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t readback_len;
+    uint8_t flags;
+    uint8_t reg;
+    uint8_t N_args;
+    uint8_t args[FPGA_FUNC_MAX_ARGS];
+} FPGA_func_desc_t;
+
+#define FPGA_FUNC_ARGS(...) __VA_ARGS__
+
+// Descriptor table generated from FPGA_LANGMUIR_FUNC_LIST.
+#define FPGA_FUNC_IDX_ENTRY(name, opcode, ...) name##_IDX,
 typedef enum {
-    FPGA_EN_CB_MODE          = 0xCA,
-    FPGA_DIS_CB_MODE         = 0xC0,
-
-    FPGA_SET_CB_VOL_LVL      = 0xCB,
-    FPGA_GET_CB_VOL_LVL      = 0xCC,
-
-    FPGA_SWT_ACTIVATE_SWEEP         = 0xAA,
-    FPGA_SET_SWT_VOL_LVL            = 0xAB,
-    FPGA_SET_SWT_STEPS              = 0xAC,
-    FPGA_SET_SWT_SAMPLES_PER_STEP   = 0xAD,
-    FPGA_SET_SWT_SAMPLE_SKIP        = 0xAE,
-    FPGA_SET_SWT_SAMPLES_PER_POINT  = 0xAF,
-    FPGA_SET_SWT_NPOINTS            = 0xB0,
-
-    FPGA_GET_SWT_SWEEP_CNT          = 0xA0,
-    FPGA_GET_SWT_VOL_LVL            = 0xA1,
-    FPGA_GET_SWT_STEPS              = 0xA2,
-    FPGA_GET_SWT_SAMPLES_PER_STEP   = 0xA3,
-    FPGA_GET_SWT_SAMPLE_SKIP        = 0xA4,
-    FPGA_GET_SWT_SAMPLES_PER_POINT  = 0xA5,
-    FPGA_GET_SWT_NPOINTS            = 0xA6,
-
-} FPGA_Func_ID_t;
-
-
-const FPGA_Func_ID_t FPGA_supported_msg_IDs[] = {
-    FPGA_EN_CB_MODE ,
-    FPGA_SET_CB_VOL_LVL,
-    FPGA_DIS_CB_MODE,
-    FPGA_GET_CB_VOL_LVL,
-    FPGA_SWT_ACTIVATE_SWEEP,
-    FPGA_SET_SWT_VOL_LVL,
-    FPGA_SET_SWT_STEPS,
-	FPGA_SET_SWT_SAMPLES_PER_STEP,
-    FPGA_SET_SWT_SAMPLE_SKIP,
-    FPGA_SET_SWT_SAMPLES_PER_POINT,
-    FPGA_SET_SWT_NPOINTS,
-    FPGA_GET_SWT_SWEEP_CNT,
-    FPGA_GET_SWT_VOL_LVL,
-    FPGA_GET_SWT_STEPS,
-	FPGA_GET_SWT_SAMPLES_PER_STEP,
-    FPGA_GET_SWT_SAMPLE_SKIP,
-    FPGA_GET_SWT_SAMPLES_PER_POINT,
-    FPGA_GET_SWT_NPOINTS,
+    FPGA_LANGMUIR_FUNC_LIST(FPGA_FUNC_IDX_ENTRY)
+    NOF_FPGA_FUNCS
+} FPGA_Func_Idx_t;
+
+#define FPGA_FUNC_DESC_ENTRY(name, op, rb_len, fl, rg, n_args, arg_list) \
+    [name##_IDX] = { .opcode = op, .readback_len = rb_len, .flags = fl, .reg = rg, .N_args = n_args, .args = { FPGA_FUNC_ARGS arg_list } },
+static const FPGA_func_desc_t FPGA_func_desc[NOF_FPGA_FUNCS] = {
+    FPGA_LANGMUIR_FUNC_LIST(FPGA_FUNC_DESC_ENTRY)
 };
 
-#define NOF_FPGA_FUNCS sizeof(FPGA_supported_msg_IDs) / sizeof(FPGA_supported_msg_IDs[0])
+// Descriptor index + 1 of every function ID, 0 for unsupported IDs. Also generated at compile time.
+#define FPGA_FUNC_LOOKUP_ENTRY(name, opcode, ...) [opcode] = name##_IDX + 1,
+static const uint8_t FPGA_func_lookup[256] = {
+    FPGA_LANGMUIR_FUNC_LIST(FPGA_FUNC_LOOKUP_ENTRY)
+};
+
+// Encoded width in bytes of each argument, indexed by FPGA_Arg_ID_t. 0 = unknown argument.
+static const uint8_t FPGA_arg_widths[] = {
+    [PROBE_ID_ARG_ID]           = 1,
+    [STEP_ID_ARG_ID]            = 1,
+    [VOL_LVL_ARG_ID]            = 2,
+    [N_STEPS_ARG_ID]            = 1,
+    [N_SKIP_ARG_ID]             = 2,
+    [N_F_ARG_ID]                = 2,
+    [N_POINTS_ARG_ID]           = 2,
+    [GS_TARGET_ARG_ID]          = 1,
+    [FRAM_TABLE_ID_ARG_ID]      = 1,
+    [N_SAMPLES_PER_STEP_ARG_ID] = 2,
+    [SWEEP_SHAPE_ARG_ID]        = 1,
+    [START_VOL_LVL_ARG_ID]      = 2,
+    [STOP_VOL_LVL_ARG_ID]       = 2,
+    [BREAKPOINT_ARG_ID]         = 3,
+    [SEQ_ID_ARG_ID]             = 1,
+    [DELAY_MS_ARG_ID]           = 2,
+    [ENABLE_ARG_ID]             = 1,
+    [SC_N_SAMPLES_ARG_ID]       = 1,
+    [FLUSH_TIMEOUT_MS_ARG_ID]   = 2,
+    [APID_ARG_ID]               = 2,
+    [FILTER_MODE_ARG_ID]        = 1,
+    [DECIMATION_ARG_ID]         = 1,
+    [FIR_TAP_ARG_ID]            = 2,
+    [N_AVG_SWEEPS_ARG_ID]       = 1,
+    [SIGMA_ARG_ID]              = 1,
+    [TRIGGER_MODE_ARG_ID]       = 1,
+    [TRIGGER_LEVEL_ARG_ID]      = 2,
+    [SLOPE_LEVEL_ARG_ID]        = 2,
+    [DIFF_LEVEL_ARG_ID]         = 2,
+    [PRE_TRIGGER_ARG_ID]        = 2,
+    [POST_TRIGGER_ARG_ID]       = 2,
+    [DL_CLASS_ARG_ID]           = 1,
+    [DL_RATE_ARG_ID]            = 2,
+    [DL_BURST_ARG_ID]           = 2,
+};
 
 #define FPGA_MSG_PREMABLE_0     0xB5
 #define FPGA_MSG_PREMABLE_1     0x43
@@ -82,40 +103,6 @@ Langmuir_Readback_State_t LangmuirReadbackState = LANG_RB_PRE0;
 uint8_t FPGA_byte_recv = 0xFF;
 uint8_t FPGA_readback_msg[LANGMUIR_READBACK_MAX_SIZE];
 uint16_t rb_seq_cnt = 0;
-#define READBACK_APID  0xABBA
-
-#define SCIENTIFIC_DATA_PREAMBLE        0x83
-#define SC_DATA_MAX_SIZE                10000
-#define SC_CB_PACKET_RAW_DATA_LEN       6 // 2 sequence counter bytes and 2 data bytes each probe.
-#define SC_CB_PACKET_FULL_DATA_LEN      1 + SC_CB_PACKET_RAW_DATA_LEN  // 1 byte header
-
-uint8_t scientific_cb_data_packet[SC_CB_PACKET_FULL_DATA_LEN];
-
-
-uint8_t scientific_data[SC_DATA_MAX_SIZE];
-uint32_t sc_data_id = 0;
-
-
-#define CB_SC_DATA_APID     0x2CB
-uint16_t cb_sc_seq_count = 0;
-
-#define SWT_SC_DATA_APID    0x2AD
-uint16_t swt_sc_seq_count = 0;
-
-bool sc_data_en = false;
-
-typedef enum {
-    LANG_SC_PRE,
-    LANG_SC_SEQ_CNT0,
-    LANG_SC_SEQ_CNT1,
-    LANG_SC_PROBE0_DATA0,
-    LANG_SC_PROBE0_DATA1,
-    LANG_SC_PROBE1_DATA0,
-    LANG_SC_PROBE1_DATA1,
-} Langmuir_Scientific_Data_Message_State_t;
-
-Langmuir_Scientific_Data_Message_State_t LSDMS = LANG_SC_PRE;
-
 
 
 static inline bool check_FPGA_msg_format(uint8_t len) {
@@ -154,10 +141,20 @@ static bool receive_readback(uint8_t expected_data_len, uint8_t* output_buf) {
 }
 
 
-static bool wait_for_readback(uint8_t* request_info, uint8_t request_info_len, uint8_t* output_buf, uint8_t expected_data_len) {
-    memcpy(output_buf, request_info, request_info_len);
-    bool res = receive_readback(expected_data_len, output_buf + request_info_len);
-    return res;
+// Sends a GET message to the FPGA and waits for its readback value (little-endian, at most 2 bytes).
+static bool transceive_FPGA_readback(uint8_t* msg, uint8_t msg_len, uint8_t readback_len, uint16_t* value) {
+    uint8_t readback[2] = {0};
+    if (readback_len > sizeof(readback)) {
+        return false;
+    }
+    if (FPGA_Transmit_Binary(msg, msg_len) != HAL_OK) {
+        return false;
+    }
+    if (!receive_readback(readback_len, readback)) {
+        return false;
+    }
+    *value = readback[0] | (readback[1] << 8);
+    return true;
 }
 
 
@@ -203,6 +200,20 @@ SPP_error save_sweep_table_value_FRAM(uint8_t table_id, uint8_t step_id, uint16_
 };
 
 
+// Writes the first N_values steps of a sweep table in a single FRAM transaction.
+SPP_error save_sweep_table_FRAM(uint8_t table_id, uint16_t* values, uint16_t N_values) {
+    if (table_id > 7 || N_values > 256) {
+        return UNDEFINED_ERROR;
+    }
+    uint16_t sweep_table_address = get_sweep_table_address(table_id);
+
+    if (writeFRAM(sweep_table_address, (uint8_t*) values, N_values * 2) != HAL_OK) {
+        return UNDEFINED_ERROR;
+    }
+    return SPP_OK;
+}
+
+
 uint16_t read_sweep_table_value_FRAM(uint8_t table_id, uint8_t step_id) {
     if (table_id > 7) { // Table IDs 0-7
         // TODO Add error generation here. (PUS1)
@@ -218,224 +229,176 @@ uint16_t read_sweep_table_value_FRAM(uint8_t table_id, uint8_t step_id) {
 };
 
 
-void enable_scientific_data_callback() {
-    sc_data_en = true;
-    HAL_UART_Receive_DMA(&huart5, scientific_cb_data_packet, 7);
+static const FPGA_func_desc_t* get_FPGA_func_desc(uint8_t func_id) {
+    uint8_t idx = FPGA_func_lookup[func_id];
+    return (idx == 0) ? NULL : &FPGA_func_desc[idx - 1];
 }
 
-void disable_scientific_data_callback() {
-    sc_data_en = false;
-}
 
-void handle_scientific_data_packet() {
-    if (sc_data_id >= SC_DATA_MAX_SIZE || !sc_data_en) {
-		return;
-	}
-    if (scientific_cb_data_packet[0] == SCIENTIFIC_DATA_PREAMBLE) {
-        // memcpy(scientific_data + sc_data_id, scientific_cb_data_packet + 1, 6);
-        SPP_header_t SC_SPP_header = SPP_make_header(
-            SPP_VERSION,
-            SPP_PACKET_TYPE_TM,
-            0,
-            CB_SC_DATA_APID,
-            SPP_SEQUENCE_SEG_UNSEG,
-            cb_sc_seq_count,
-            SC_CB_PACKET_RAW_DATA_LEN + CRC_BYTE_LEN - 1
-        );
-        uint8_t temp_SPP_packet[128];
-        uint16_t SPP_packet_len;
-        SPP_prepare_full_msg(&SC_SPP_header, NULL, scientific_cb_data_packet + 1, SC_CB_PACKET_RAW_DATA_LEN, temp_SPP_packet, &SPP_packet_len);
-
-        
+static uint16_t get_FPGA_arg_value(FPGA_msg_arg_t* fpgama, uint8_t arg_ID) {
+    switch (arg_ID) {
+        case PROBE_ID_ARG_ID:           return fpgama->probe_ID;
+        case STEP_ID_ARG_ID:            return fpgama->step_ID;
+        case VOL_LVL_ARG_ID:            return fpgama->voltage_level;
+        case N_STEPS_ARG_ID:            return fpgama->N_steps;
+        case N_SKIP_ARG_ID:             return fpgama->N_skip;
+        case N_F_ARG_ID:                return fpgama->N_f;
+        case N_POINTS_ARG_ID:           return fpgama->N_points;
+        case GS_TARGET_ARG_ID:          return fpgama->target;
+        case N_SAMPLES_PER_STEP_ARG_ID: return fpgama->N_samples_per_step;
+        default:                        return 0;
     }
 }
 
-/*
-void handle_scientific_data_packet() {
-	if (sc_data_id >= SC_DATA_MAX_SIZE || !sc_data_en) {
-		return;
-	}
-    uint8_t* packet = scientific_data_packet;
-    switch(LSDMS) {
-        case LANG_SC_PRE:
-            if (packet[0] == SCIENTIFIC_DATA_PREAMBLE) {
-                LSDMS = LANG_SC_SEQ_CNT0;
-            }
-            HAL_UART_Receive_DMA(&huart5, scientific_data_packet, 1);
-            break;
 
-        case LANG_SC_DATA0:
-            memcpy(scientific_data + sc_data_id, scientific_data_packet, 1);
-            sc_data_id++;
-            LSDMS  = LANG_SC_DATA1;
-            HAL_UART_Receive_DMA(&huart5, scientific_data_packet, 1);
-            break;
+// Builds the UART message: preamble, opcode, arguments (little-endian) and postamble.
+static uint8_t encode_FPGA_langmuir_msg(const FPGA_func_desc_t* desc, FPGA_msg_arg_t* fpgama, uint8_t* msg) {
+    uint8_t msg_cnt = 0;
 
-        case LANG_SC_DATA1:
-            memcpy(scientific_data + sc_data_id, scientific_data_packet, 1);
-            sc_data_id++;
-            LSDMS  = LANG_SC_PRE;
-            HAL_UART_Receive_DMA(&huart5, scientific_data_packet, 1);
-            break;
-        default:
-            HAL_UART_Receive_DMA(&huart5, scientific_data_packet, 1);
-            break;
-    }
+    msg[msg_cnt++] = FPGA_MSG_PREMABLE_0;
+    msg[msg_cnt++] = FPGA_MSG_PREMABLE_1;
+    msg[msg_cnt++] = desc->opcode;
 
+    for (uint8_t i = 0; i < desc->N_args; i++) {
+        uint8_t  arg_ID = desc->args[i];
+        uint16_t value  = get_FPGA_arg_value(fpgama, arg_ID);
 
-}
-*/
+        msg[msg_cnt++] = value & 0x00FF;
+        if (FPGA_arg_width(arg_ID) == 2) {
+            msg[msg_cnt++] = (value & 0xFF00) >> 8;
+        }
+    }
 
+    msg[msg_cnt++] = FPGA_MSG_POSTAMBLE;
+    return msg_cnt;
+}
 
 
-void send_FPGA_langmuir_msg(uint8_t func_id, FPGA_msg_arg_t* fpgama) {
-    uint8_t msg[64] = {0};
-    uint8_t msg_cnt = 0;
+/*  Sends a Langmuir function to the FPGA, or to FRAM for sweep table targets. Returns
+ *  SPP_PUS8_ERROR when a GET could not be answered.
+ */
+SPP_error send_FPGA_langmuir_msg(uint8_t func_id, FPGA_msg_arg_t* fpgama) {
+    const FPGA_func_desc_t* desc = get_FPGA_func_desc(func_id);
+    if (desc == NULL) {
+        return SPP_PUS8_ERROR;
+    }
 
-    bool is_FPGA_readback_reqeust = false;
-    uint8_t request_info[16] = {0};
-    uint8_t request_info_len = 0;
-    uint8_t readback_data[64] = {0};
-    uint8_t readback_len = 0;
+    uint8_t msg[3 + (FPGA_FUNC_MAX_ARGS * 2) + 1];
+    uint8_t msg_cnt = encode_FPGA_langmuir_msg(desc, fpgama, msg);
 
-    bool save_to_FRAM = false;
-    bool read_from_FRAM = false;
+    // Readbacks are prefixed with the request itself (opcode and arguments).
+    uint8_t* request_info = msg + 2;
+    uint8_t  request_info_len = msg_cnt - 3;
+    uint8_t  readback_data[64] = {0};
+    uint8_t  readback_len = desc->readback_len;
 
-    msg[msg_cnt++] = FPGA_MSG_PREMABLE_0;
-    msg[msg_cnt++] = FPGA_MSG_PREMABLE_1;
+    bool FRAM_target = (desc->flags & FPGA_FUNC_FRAM_TARGET) && (fpgama->target == GS_FRAM_TARGET);
 
-    switch (func_id) {
-        case FPGA_EN_CB_MODE:
-            msg[msg_cnt++] = FPGA_EN_CB_MODE;
-            enable_scientific_data_callback();
-            //is_FPGA_readback_reqeust = true;
-            //readback_len = 3;
-            //HAL_UART_Receive(&huart5, scientific_data_packet, 3, 1000);
-            break;
-        case FPGA_SET_CB_VOL_LVL:
-            msg[msg_cnt++] = FPGA_SET_CB_VOL_LVL;
-            msg[msg_cnt++] = fpgama->probe_ID;
-            msg[msg_cnt++] = ((uint8_t*)(&fpgama->voltage_level))[0];
-            msg[msg_cnt++] = ((uint8_t*)(&fpgama->voltage_level))[1];
-            break;
-        case FPGA_DIS_CB_MODE:
-            request_info[request_info_len++] = msg[msg_cnt++] = FPGA_DIS_CB_MODE;
-            disable_scientific_data_callback();
-            break;
-        case FPGA_GET_CB_VOL_LVL:
-            request_info[request_info_len++] = msg[msg_cnt++] = FPGA_GET_CB_VOL_LVL;
-            request_info[request_info_len++] = msg[msg_cnt++] = fpgama->probe_ID;
-            is_FPGA_readback_reqeust = true;
-            readback_len = sizeof(fpgama->voltage_level);
-            break;
-        case FPGA_SWT_ACTIVATE_SWEEP:
-            msg[msg_cnt++] = FPGA_SWT_ACTIVATE_SWEEP;
-            break;
-        case FPGA_SET_SWT_VOL_LVL:
-            if (fpgama->target == GS_FPGA_TARGET) {
-                msg[msg_cnt++] = FPGA_SET_SWT_VOL_LVL;
-                msg[msg_cnt++] = fpgama->probe_ID;
-                msg[msg_cnt++] = fpgama->step_ID;
-                msg[msg_cnt++] = ((uint8_t*)(&fpgama->voltage_level))[0];
-                msg[msg_cnt++] = ((uint8_t*)(&fpgama->voltage_level))[1];
-            } else if (fpgama->target == GS_FRAM_TARGET) {
-                save_to_FRAM = true;
-            }
-            break;
-        case FPGA_SET_SWT_STEPS:
-            msg[msg_cnt++] = FPGA_SET_SWT_STEPS;
-            msg[msg_cnt++] = fpgama->N_steps;
-            break;
-        case FPGA_SET_SWT_SAMPLES_PER_STEP:
-            msg[msg_cnt++] = FPGA_SET_SWT_SAMPLES_PER_STEP;
-            msg[msg_cnt++] = ((uint8_t*)(&fpgama->N_samples_per_step))[0];
-            msg[msg_cnt++] = ((uint8_t*)(&fpgama->N_samples_per_step))[1];
-            break;
-        case FPGA_SET_SWT_SAMPLE_SKIP:
-            msg[msg_cnt++] = FPGA_SET_SWT_SAMPLE_SKIP;
-            msg[msg_cnt++] = ((uint8_t*)(&fpgama->N_skip))[0];
-            msg[msg_cnt++] = ((uint8_t*)(&fpgama->N_skip))[1];
-            break;
-        case FPGA_SET_SWT_SAMPLES_PER_POINT:
-            msg[msg_cnt++] = FPGA_SET_SWT_SAMPLES_PER_POINT;
-            msg[msg_cnt++] = ((uint8_t*)(&fpgama->N_f))[0];
-            msg[msg_cnt++] = ((uint8_t*)(&fpgama->N_f))[1];
-            break;
-        case FPGA_SET_SWT_NPOINTS:
-            msg[msg_cnt++] = FPGA_SET_SWT_NPOINTS;
-            msg[msg_cnt++] = ((uint8_t*)(&fpgama->N_points))[0];
-            msg[msg_cnt++] = ((uint8_t*)(&fpgama->N_points))[1];
-            break;
-        case FPGA_GET_SWT_SWEEP_CNT:
-            request_info[request_info_len++] = msg[msg_cnt++] = FPGA_GET_SWT_SWEEP_CNT;
-            is_FPGA_readback_reqeust = true;
-            readback_len = 2; // Sweep activation counter is 16bits
-            break;
-        case FPGA_GET_SWT_VOL_LVL:
-                request_info[request_info_len++] = msg[msg_cnt++] = FPGA_GET_SWT_VOL_LVL;
-                request_info[request_info_len++] = msg[msg_cnt++] = fpgama->probe_ID;
-                request_info[request_info_len++] = msg[msg_cnt++] = fpgama->step_ID;
-                readback_len = sizeof(fpgama->voltage_level);
-            if (fpgama->target == GS_FPGA_TARGET) {
-                is_FPGA_readback_reqeust = true;
-            } else if (fpgama->target == GS_FRAM_TARGET) {
-                read_from_FRAM = true;
-            }
-            break;
-        case FPGA_GET_SWT_STEPS:
-            request_info[request_info_len++] = msg[msg_cnt++] = FPGA_GET_SWT_STEPS;
-            is_FPGA_readback_reqeust = true;
-            readback_len = sizeof(fpgama->N_steps);
-            break;
-        case FPGA_GET_SWT_SAMPLES_PER_STEP:
-            request_info[request_info_len++] = msg[msg_cnt++] = FPGA_GET_SWT_SAMPLES_PER_STEP;
-            is_FPGA_readback_reqeust = true;
-            readback_len = sizeof(fpgama->N_samples_per_step);
-            break;
-        case FPGA_GET_SWT_SAMPLE_SKIP:
-            request_info[request_info_len++] = msg[msg_cnt++] = FPGA_GET_SWT_SAMPLE_SKIP;
-            is_FPGA_readback_reqeust = true;
-            readback_len = sizeof(fpgama->N_skip);
-            break;
-        case FPGA_GET_SWT_SAMPLES_PER_POINT:
-            request_info[request_info_len++] = msg[msg_cnt++] = FPGA_GET_SWT_SAMPLES_PER_POINT;
-            is_FPGA_readback_reqeust = true;
-            readback_len = sizeof(fpgama->N_f);
-            break;
-        case FPGA_GET_SWT_NPOINTS:
-            request_info[request_info_len++] = msg[msg_cnt++] = FPGA_GET_SWT_NPOINTS;
-            is_FPGA_readback_reqeust = true;
-            readback_len = sizeof(fpgama->N_points);
-            break;
+    if (desc->flags & FPGA_FUNC_SC_EN) {
+        enable_scientific_data_callback();
+    }
+    if (desc->flags & FPGA_FUNC_SC_DIS) {
+        disable_scientific_data_callback();
     }
 
-    msg[msg_cnt++] = FPGA_MSG_POSTAMBLE;
-
-    //SPP_UART_transmit_DMA(msg, msg_cnt); return;
-
-
-    if (save_to_FRAM) {
+    if (FRAM_target && !(desc->flags & FPGA_FUNC_READBACK)) {
         save_sweep_table_value_FRAM(fpgama->probe_ID, fpgama->step_ID, fpgama->voltage_level);
 
-    } else if (read_from_FRAM) {
+    } else if (FRAM_target) {
         uint16_t value = read_sweep_table_value_FRAM(fpgama->probe_ID, fpgama->step_ID);
         memcpy(readback_data, request_info, request_info_len);
         memcpy(readback_data + request_info_len, (uint8_t*) &value, sizeof(value));
         send_readback_ground(readback_data, readback_len + request_info_len);
 
+    } else if (desc->flags & FPGA_FUNC_READBACK) {
+        // GETs are served from the configuration mirror unless the value is unknown or
+        // verify mode is on, in which case the FPGA is asked and compared against the mirror.
+        // While scientific data is streamed UART5 belongs to its circular DMA and the FPGA
+        // cannot be asked, so such GETs are refused.
+        uint16_t value = 0;
+        bool success = !FPGA_mirror_verify && FPGA_mirror_lookup(desc->reg, fpgama, &value);
+        if (!success) {
+            if (sc_data_en) {
+                return SPP_PUS8_ERROR;
+            }
+            success = transceive_FPGA_readback(msg, msg_cnt, readback_len, &value);
+            if (!success) {
+                return SPP_PUS8_ERROR;
+            }
+            FPGA_mirror_compare(desc->reg, fpgama, value);
+        }
+        memcpy(readback_data, request_info, request_info_len);
+        memcpy(readback_data + request_info_len, (uint8_t*) &value, readback_len);
+        send_readback_ground(readback_data, request_info_len + readback_len);
+
     } else {
-        FPGA_Transmit_Binary(msg, msg_cnt);
+        if (FPGA_Transmit_Binary(msg, msg_cnt) == HAL_OK) {
+            FPGA_mirror_store_set(desc->reg, fpgama);
+        }
+    }
+    return SPP_OK;
+};
+
+
+// Reads a register back from the FPGA into the mirror. Returns false if the FPGA did not answer.
+static bool readback_to_mirror(const FPGA_func_desc_t* desc, FPGA_msg_arg_t* fpgama, bool* match) {
+    uint8_t  msg[3 + (FPGA_FUNC_MAX_ARGS * 2) + 1];
+    uint8_t  msg_cnt = encode_FPGA_langmuir_msg(desc, fpgama, msg);
+    uint16_t value;
+
+    if (!transceive_FPGA_readback(msg, msg_cnt, desc->readback_len, &value)) {
+        return false;
+    }
+    *match = FPGA_mirror_compare(desc->reg, fpgama, value);
+    return true;
+}
 
-        if (is_FPGA_readback_reqeust) {
-        	bool success = wait_for_readback(request_info, request_info_len, readback_data, readback_len);
-        	if (success) {
-            	send_readback_ground(readback_data, request_info_len + readback_len);
-        	}
-    	}
 
+/*  Background refresh of the mirror, only while no scientific data is streamed, since the
+ *  readback shares UART5 with the scientific data. Every GET blocks until the FPGA answers or
+ *  the UART times out, so at most one is sent per call to keep the main loop responsive.
+ *  A pending bulk refresh of the CB voltages and sweep tables reads one register per call and
+ *  is dropped when the FPGA does not answer. Otherwise one scalar register is read back per
+ *  FPGA_MIRROR_REFRESH_INTV. A scalar that differs from the mirror means the FPGA lost the
+ *  configuration it was given, so the whole mirror is invalidated and reloaded.
+ */
+void refresh_FPGA_config_mirror(uint32_t current_ticks) {
+    static uint32_t last_refresh_tick = 0;
+    static uint8_t  next_idx = 0;
+    uint8_t  func_id;
+    bool     match;
+    FPGA_msg_arg_t fpgama;
+
+    if (sc_data_en) {
+        return;
     }
 
-};
+    if (FPGA_mirror_next_refresh(&func_id, &fpgama)) {
+        if (!readback_to_mirror(get_FPGA_func_desc(func_id), &fpgama, &match)) {
+            FPGA_mirror_stop_refresh();
+        }
+        return;
+    }
+
+    if ((current_ticks - last_refresh_tick) < FPGA_MIRROR_REFRESH_INTV) {
+        return;
+    }
+    last_refresh_tick = current_ticks;
+
+    // Next GET function without arguments that reads a mirrored register.
+    for (uint8_t i = 0; i < NOF_FPGA_FUNCS; i++) {
+        const FPGA_func_desc_t* desc = &FPGA_func_desc[next_idx];
+        next_idx = (next_idx + 1) % NOF_FPGA_FUNCS;
+
+        if ((desc->flags & FPGA_FUNC_READBACK) && desc->reg != FPGA_REG_NONE && desc->N_args == 0) {
+            memset(&fpgama, 0, sizeof(fpgama));
+            if (readback_to_mirror(desc, &fpgama, &match) && !match) {
+                FPGA_mirror_invalidate();
+            }
+            break;
+        }
+    }
+}
 
 void copy_full_sweep_table_FRAM_to_FPGA(uint8_t fram_table_id, uint8_t fpga_table_id) {
     for(int i = 0; i < 256; i++) {
@@ -450,15 +413,106 @@ void copy_full_sweep_table_FRAM_to_FPGA(uint8_t fram_table_id, uint8_t fpga_tabl
 
         send_FPGA_langmuir_msg(FPGA_SET_SWT_VOL_LVL, &fpga_msg_args);
     }
+    SWT_set_table_ID(fpga_table_id, fram_table_id);
 }
 
-bool is_langmuir_func(uint8_t func_id) {
-    bool result = false;
-    for(uint8_t i = 0; i < NOF_FPGA_FUNCS; i++) {
-        if (func_id == FPGA_supported_msg_IDs[i]) {
-            result = true;
-            break;
+// Decodes the PUS 8 argument list (argument ID followed by its value) of a Langmuir function.
+// Returns a pointer to the first byte after the arguments.
+uint8_t* decode_FPGA_msg_args(uint8_t N_args, uint8_t* data, FPGA_msg_arg_t* fpgama) {
+    *fpgama = (FPGA_msg_arg_t) {
+        .probe_ID       = 0xFF,
+        .step_ID        = 0xFF,
+        .voltage_level  = 0x0000,
+        .N_steps        = 0x00,
+        .N_skip         = 0x0000,
+        .N_f            = 0x0000, // Samples per points
+        .N_points       = 0x0000,
+        .target     = 0xFF,
+        .N_samples_per_step = 0x0000,
+    };
+
+    for(int i = 0; i < N_args; i++) {
+        uint8_t arg_ID = *data++;
+        switch(arg_ID) {
+            case PROBE_ID_ARG_ID:
+                fpgama->probe_ID = *data++;
+                break;
+            case STEP_ID_ARG_ID:
+                fpgama->step_ID = *data++;
+                break;
+            case VOL_LVL_ARG_ID:
+                memcpy((uint8_t*)&fpgama->voltage_level, data, sizeof(fpgama->voltage_level));
+                data += sizeof(fpgama->voltage_level);
+                break;
+            case N_STEPS_ARG_ID:
+                fpgama->N_steps = *data++;
+                break;
+            case N_SKIP_ARG_ID:
+                memcpy((uint8_t*)&fpgama->N_skip, data, sizeof(fpgama->N_skip));
+                data += sizeof(fpgama->N_skip);
+                break;
+            case N_F_ARG_ID:
+                memcpy((uint8_t*)&fpgama->N_f, data, sizeof(fpgama->N_f));
+                data += sizeof(fpgama->N_f);
+                break;
+            case N_POINTS_ARG_ID:
+                memcpy((uint8_t*)&fpgama->N_points, data, sizeof(fpgama->N_points));
+                data += sizeof(fpgama->N_points);
+                break;
+            case GS_TARGET_ARG_ID:
+                // "sizeof" cannot be used here as .target is an enum type whose length cannot specified(at least in <C23).
+                // If "sizeof" is used, it returns 4, which is incorrect as the target is only a single byte value.
+                // This bug does not cause problems if the target argument is the last one in the message but would
+                // mess up the alignment if it is in the beginning or middle of the message.
+                memcpy((uint8_t*)&fpgama->target, data, 1);
+                data += 1;
+                break;
+            case N_SAMPLES_PER_STEP_ARG_ID:
+                memcpy((uint8_t*)&fpgama->N_samples_per_step, data, sizeof(fpgama->N_samples_per_step));
+                data += sizeof(fpgama->N_samples_per_step);
+                break;
+            default:
+                data += FPGA_arg_width(arg_ID);
+                break;
         }
     }
-    return result;
+    return data;
+}
+
+
+// Length in bytes of an encoded argument list, 0 if it contains an argument of unknown width.
+uint16_t FPGA_msg_args_len(uint8_t N_args, uint8_t* data) {
+    uint16_t len = 0;
+    for (int i = 0; i < N_args; i++) {
+        uint8_t width = FPGA_arg_width(data[len]);
+        if (width == 0) {
+            return 0;
+        }
+        len += 1 + width;
+    }
+    return len;
+}
+
+
+void write_sweep_table_FPGA(uint8_t fpga_table_id, uint16_t* values, uint16_t N_values) {
+    for(uint16_t i = 0; i < N_values && i < 256; i++) {
+        FPGA_msg_arg_t fpga_msg_args;
+        fpga_msg_args.probe_ID = fpga_table_id;
+        fpga_msg_args.step_ID = i;
+        fpga_msg_args.voltage_level = values[i];
+        fpga_msg_args.target = GS_FPGA_TARGET;
+
+        send_FPGA_langmuir_msg(FPGA_SET_SWT_VOL_LVL, &fpga_msg_args);
+    }
+}
+
+bool is_langmuir_func(uint8_t func_id) {
+    return FPGA_func_lookup[func_id] != 0;
+}
+
+uint8_t FPGA_arg_width(uint8_t arg_ID) {
+    if (arg_ID >= sizeof(FPGA_arg_widths)) {
+        return 0;
+    }
+    return FPGA_arg_widths[arg_ID];
 }
@@ -34,7 +34,12 @@
 #include "COBS.h"
 #include "Space_Packet_Protocol.h"
 #include "langmuir_probe_bias.h"
+#include "scientific_data.h"
+#include "on_board_time.h"
+#include "downlink_scheduler.h"
 #include "device_state.h"
+#include "storage_manager.h"
+#include "command_sequence.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -94,7 +99,7 @@ uint8_t ffuID = 0;
 uint8_t SPP_OBC_message_received = 0;
 uint8_t SPP_DEBUG_message_received = 0;
 
-uint16_t ADCBuffer[11];		// Buffer for ADC values
+DMA_BUFFER uint16_t ADCBuffer[11];		// Buffer for ADC values
 uint16_t ADCValues[11];		// Current ADC values
 float temperature = 0;
 float uc3v = 0;
@@ -125,6 +130,7 @@ void StartDefaultTask(void const * argument);
 
 static void MX_NVIC_Init(void);
 /* USER CODE BEGIN PFP */
+static void MPU_Config(void);
 
 /* USER CODE END PFP */
 
@@ -140,7 +146,12 @@ static void MX_NVIC_Init(void);
 int main(void)
 {
   /* USER CODE BEGIN 1 */
+  MPU_Config();
 
+#if CPU_CACHE_ENABLE
+  SCB_EnableICache();
+  SCB_EnableDCache();
+#endif
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -738,8 +749,7 @@ void HAL_SRAM_DMA_XferCpltCallback(DMA_HandleTypeDef *hdma) {
 //bool msg_from_FPGA = false;
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
 	if (huart == &huart5) {
-        handle_scientific_data_packet();
-        volatile int i = 0;
+        SC_DMA_half_callback();
 	} else if (huart == &SPP_DEBUG_UART) {
         *(DEBUGRxBuffer + SPP_DEBUG_recv_count) = SPP_DEBUG_recv_char;
         if (SPP_DEBUG_recv_char == 0x00) {
@@ -763,6 +773,18 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
 
 }
 
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart) {
+	if (huart == &huart5) {
+        SC_DMA_half_callback();
+	}
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+	if (huart == &huart5) {
+        SC_DMA_error_callback();
+	}
+}
+
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
     memcpy(ADCValues, ADCBuffer, 22);
 
@@ -791,6 +813,42 @@ int _write(int file, char *ptr, int len)
 }
 
 
+/*  The FMC bank 1 window is Normal memory in the default map, so the core may read it
+ *  speculatively and with the D-cache enabled it would also be cached. Reads of the FPGA
+ *  buffer have side effects, so the bank is made Strongly-ordered and not executable.
+ */
+static void MPU_Config(void) {
+	MPU_Region_InitTypeDef region = {0};
+
+	HAL_MPU_Disable();
+
+	region.Enable = MPU_REGION_ENABLE;
+	region.Number = MPU_REGION_NUMBER0;
+	region.BaseAddress = 0x60000000;
+	region.Size = MPU_REGION_SIZE_256MB;
+	region.SubRegionDisable = 0x00;
+	region.TypeExtField = MPU_TEX_LEVEL0;
+	region.AccessPermission = MPU_REGION_FULL_ACCESS;
+	region.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+	region.IsShareable = MPU_ACCESS_SHAREABLE;
+	region.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+	region.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+	HAL_MPU_ConfigRegion(&region);
+
+	HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+}
+
+// Writes back the cache lines covering a buffer before a peripheral reads it by DMA.
+void DCache_clean(const void* addr, uint32_t len) {
+	uint32_t start = (uint32_t) addr & ~0x1FU;
+	SCB_CleanDCache_by_Addr((uint32_t*) start, len + ((uint32_t) addr - start));
+}
+
+// Discards the cache lines covering a buffer written by DMA. The buffer must start and end on a
+// 32-byte line boundary, otherwise unrelated data sharing the first or last line is lost.
+void DCache_invalidate(void* addr, uint32_t len) {
+	SCB_InvalidateDCache_by_Addr((uint32_t*) addr, len);
+}
 
 /* USER CODE END 4 */
 
@@ -812,18 +870,38 @@ void StartDefaultTask(void const * argument)
     *  REFER TO: ARM® CoreSight ™Architecture Specification v3.0
     *  REFER TO: Arm® v7-M Architecture Reference Manual
     */
-  	//__disable_irq();
-  	//CoreDebug->DEMCR &= ~CoreDebug_DEMCR_TRCENA_Msk; // Disable
-  	//DWT->LAR = 0xC5ACCE55; // Unlock DWT reg for editing
-  	//DWT->CYCCNT = 0; // Reset counter
-  	//DWT->CTRL &= ~DWT_CTRL_CYCCNTENA_Msk; // Disable Counter
-  	//__enable_irq();
+  	// Cycle counter, used for profiling and as the on-board time base.
+  	__disable_irq();
+  	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Enable trace
+  	DWT->LAR = 0xC5ACCE55; // Unlock DWT reg for editing
+  	DWT->CYCCNT = 0; // Reset counter
+  	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; // Enable Counter
+  	__enable_irq();
 
     // Initialize SD card
     HAL_GPIO_WritePin(LED3_GPIO_Port, LED3_Pin, GPIO_PIN_SET);
     //BSP_SD_Init();
     //f_mount(&FatFs, (TCHAR const*) SDPath, 0);
 
+#if SD_BOOT_BENCHMARK
+    // Sequential write benchmark of the SD card at the trained bus speed, needs the mounted volume
+    if (SDFatFS.fs_type != 0) {
+        uint32_t totalUs = 0;
+        uint32_t worstUs = 0;
+        char str[128];
+        FRESULT result = SD_benchmark(1, &totalUs, &worstUs);
+
+        if (result == FR_OK && totalUs != 0) {
+            uint32_t rate = (uint32_t) ((uint64_t) SD_BENCH_BUFFERS * SD_BUFFER_SIZE * 100 / totalUs);
+            sprintf(str, "SD speed level %u: %lu.%02lu MB/s, worst write %lu us\r\n",
+                    BSP_SD_GetSpeed(), rate / 100, rate % 100, worstUs);
+        } else {
+            sprintf(str, "SD benchmark failed: error %d\r\n", result);
+        }
+        SPP_DLog(str);
+    }
+#endif
+
 
     //HAL_UART_Receive_DMA(&huart5, &FPGA_byte_recv, 1);
     HAL_UART_Receive_DMA(&SPP_DEBUG_UART, &SPP_DEBUG_recv_char, 1);
@@ -839,6 +917,9 @@ void StartDefaultTask(void const * argument)
       SPP_DLog(bcnt);
     }
 
+    // Restore time-based schedule from FRAM. It stays disabled until enabled from ground.
+    SPP_init_TBS_schedule();
+
 /*
     // Read out uC GS identifier from FRAM
     readFRAM(FRAM_GS_ID_UC, &uC_GS_ID, 1);
@@ -916,6 +997,18 @@ void StartDefaultTask(void const * argument)
 
         SPP_collect_HK_data(current_ticks);
 
+        SPP_execute_scheduled_TCs();
+
+        cmd_seq_process(current_ticks);
+
+        process_scientific_data(current_ticks);
+
+        DL_process(current_ticks);
+
+        refresh_FPGA_config_mirror(current_ticks);
+
+        STOR_poll(current_ticks);
+
         if (SPP_DEBUG_message_received) {
             SPP_handle_incoming_TC(DEBUG_TC);
             SPP_DEBUG_message_received = 0;
@@ -1020,7 +1113,9 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
     HAL_IncTick();
   }
   /* USER CODE BEGIN Callback 1 */
-
+  if (htim->Instance == TIM1) {
+    OBT_poll(); // Catches every DWT wrap even while the main loop is blocked
+  }
   /* USER CODE END Callback 1 */
 }
 
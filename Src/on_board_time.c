@@ -0,0 +1,42 @@
+/*
+ * on_board_time.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "on_board_time.h"
+
+static uint32_t OBT_last_cnt = 0;
+static uint32_t OBT_wraps = 0;
+
+
+// Safe to call from interrupts. The counter is enabled at start-up in StartDefaultTask.
+uint64_t OBT_get_cycles() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t cnt = DWT->CYCCNT;
+    if (cnt < OBT_last_cnt) {
+        OBT_wraps++;
+    }
+    OBT_last_cnt = cnt;
+    uint64_t cycles = ((uint64_t) OBT_wraps << 32) | cnt;
+
+    __set_PRIMASK(primask);
+    return cycles;
+}
+
+
+uint64_t OBT_cycles_to_us(uint64_t cycles) {
+    return cycles / (SystemCoreClock / 1000000);
+}
+
+
+uint64_t OBT_get_us() {
+    return OBT_cycles_to_us(OBT_get_cycles());
+}
+
+
+void OBT_poll() {
+    (void) OBT_get_cycles();
+}
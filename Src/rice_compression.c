@@ -0,0 +1,323 @@
+/*
+ * rice_compression.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "rice_compression.h"
+#include <stdbool.h>
+
+#define RICE_X_MAX      ((1UL << RICE_N_BITS) - 1)
+#define RICE_SE_MAX_SUM 255 // Largest pair sum coded with the second extension
+
+typedef struct {
+    uint8_t* buf;
+    size_t   len;       // Buffer length in bytes
+    size_t   bit_pos;
+    bool     overflow;
+} Rice_bit_stream_t;
+
+
+static void put_bits(Rice_bit_stream_t* bs, uint32_t value, uint8_t N_bits) {
+    for (int i = N_bits - 1; i >= 0; i--) {
+        size_t byte = bs->bit_pos >> 3;
+        if (byte >= bs->len) {
+            bs->overflow = true;
+            return;
+        }
+        uint8_t mask = 0x80 >> (bs->bit_pos & 0x07);
+        if ((value >> i) & 0x01) {
+            bs->buf[byte] |= mask;
+        } else {
+            bs->buf[byte] &= ~mask;
+        }
+        bs->bit_pos++;
+    }
+}
+
+static uint32_t get_bits(Rice_bit_stream_t* bs, uint8_t N_bits) {
+    uint32_t value = 0;
+    for (int i = 0; i < N_bits; i++) {
+        size_t byte = bs->bit_pos >> 3;
+        if (byte >= bs->len) {
+            bs->overflow = true;
+            return 0;
+        }
+        value = (value << 1) | ((bs->buf[byte] >> (7 - (bs->bit_pos & 0x07))) & 0x01);
+        bs->bit_pos++;
+    }
+    return value;
+}
+
+// Fundamental sequence codeword: value zeros followed by a one.
+static void put_FS(Rice_bit_stream_t* bs, uint32_t value) {
+    while (value-- > 0 && !bs->overflow) {
+        put_bits(bs, 0, 1);
+    }
+    put_bits(bs, 1, 1);
+}
+
+static uint32_t get_FS(Rice_bit_stream_t* bs) {
+    uint32_t value = 0;
+    while (!bs->overflow && get_bits(bs, 1) == 0) {
+        value++;
+    }
+    return value;
+}
+
+
+// Unit-delay predictor and prediction error mapper (CCSDS 121.0 section 4).
+static uint16_t map_residual(uint16_t x, uint16_t prediction) {
+    int32_t delta = (int32_t) x - (int32_t) prediction;
+    uint32_t theta = (prediction < RICE_X_MAX - prediction) ? prediction : RICE_X_MAX - prediction;
+
+    if (delta >= 0 && (uint32_t) delta <= theta) {
+        return 2 * delta;
+    }
+    if (delta < 0 && (uint32_t)(-delta) <= theta) {
+        return 2 * (-delta) - 1;
+    }
+    return theta + (delta >= 0 ? delta : -delta);
+}
+
+static uint16_t unmap_residual(uint32_t mapped, uint16_t prediction) {
+    uint32_t theta = (prediction < RICE_X_MAX - prediction) ? prediction : RICE_X_MAX - prediction;
+
+    if (mapped <= 2 * theta) {
+        if (mapped & 0x01) {
+            return prediction - ((mapped + 1) >> 1);
+        }
+        return prediction + (mapped >> 1);
+    }
+    // Outside of the symmetric range only one direction is possible.
+    if (theta == prediction) {
+        return mapped;
+    }
+    return RICE_X_MAX - mapped;
+}
+
+
+static void encode_block(Rice_bit_stream_t* bs, const uint16_t* delta, uint8_t N, bool has_reference, uint16_t reference) {
+    // Cost of each option in bits, without the ID.
+    uint32_t FS_len = 0;
+    for (uint8_t i = 0; i < N; i++) {
+        FS_len += delta[i] + 1;
+    }
+
+    uint8_t  best_k = 0;
+    uint32_t best_len = FS_len;
+    for (uint8_t k = 1; k <= RICE_MAX_K; k++) {
+        uint32_t len = 0;
+        for (uint8_t i = 0; i < N; i++) {
+            len += (delta[i] >> k) + 1 + k;
+        }
+        if (len < best_len) {
+            best_len = len;
+            best_k = k;
+        }
+    }
+
+    // Second extension pairs values, a reference block pairs a leading zero with the first
+    // value. An odd count is completed with a zero. Only worth it for very small values.
+    uint32_t SE_len = 1;
+    uint16_t pairs[(RICE_BLOCK_LEN / 2) + 1];
+    uint8_t  N_SE = has_reference ? N + 1 : N;
+    N_SE += N_SE & 0x01;
+    for (uint8_t i = 0; i < N_SE; i += 2) {
+        uint8_t  j = has_reference ? i : i + 1; // Index of the second value of the pair in delta
+        uint32_t a = (j == 0 || j - 1 >= N) ? 0 : delta[j - 1];
+        uint32_t b = (j >= N) ? 0 : delta[j];
+        if (a + b > RICE_SE_MAX_SUM) {
+            SE_len = UINT32_MAX;
+            break;
+        }
+        uint32_t gamma = ((a + b) * (a + b + 1)) / 2 + b;
+        pairs[i / 2] = gamma;
+        SE_len += gamma + 1;
+    }
+
+    uint32_t NC_len = (uint32_t) N * RICE_N_BITS;
+
+    if (SE_len < best_len && SE_len < NC_len) {
+        put_bits(bs, RICE_ID_SECOND_EXT, RICE_ID_BITS);
+        put_bits(bs, 1, 1);
+        if (has_reference) {
+            put_bits(bs, reference, RICE_N_BITS);
+        }
+        for (uint8_t i = 0; i < N_SE / 2; i++) {
+            put_FS(bs, pairs[i]);
+        }
+
+    } else if (best_len < NC_len) {
+        put_bits(bs, RICE_ID_FS + best_k, RICE_ID_BITS);
+        if (has_reference) {
+            put_bits(bs, reference, RICE_N_BITS);
+        }
+        for (uint8_t i = 0; i < N; i++) {
+            put_FS(bs, delta[i] >> best_k);
+        }
+        for (uint8_t i = 0; i < N && best_k > 0; i++) {
+            put_bits(bs, delta[i], best_k);
+        }
+
+    } else {
+        put_bits(bs, RICE_ID_NO_COMP, RICE_ID_BITS);
+        if (has_reference) {
+            put_bits(bs, reference, RICE_N_BITS);
+        }
+        for (uint8_t i = 0; i < N; i++) {
+            put_bits(bs, delta[i], RICE_N_BITS);
+        }
+    }
+}
+
+
+/** Compress samples with the CCSDS 121.0 adaptive Rice coder
+	@param samples Input samples
+	@param N Number of samples to compress
+	@param stride Distance between consecutive samples in the input, 1 for a plain array
+	@param out Output buffer
+	@param out_max Output buffer size in bytes
+	@return Compressed length in bytes, 0 if the output does not fit out_max
+	@note The last byte is zero padded
+*/
+size_t rice_encode(const uint16_t* samples, size_t N, size_t stride, uint8_t* out, size_t out_max) {
+    Rice_bit_stream_t bs = { .buf = out, .len = out_max, .bit_pos = 0, .overflow = false };
+    if (N == 0) {
+        return 0;
+    }
+
+    uint16_t prediction = samples[0];
+    size_t   i = 1;
+    bool     first = true;
+
+    while ((first || i < N) && !bs.overflow) {
+        uint16_t delta[RICE_BLOCK_LEN];
+        uint8_t  block_len = first ? RICE_BLOCK_LEN - 1 : RICE_BLOCK_LEN;
+        uint8_t  N_block = 0;
+
+        while (N_block < block_len && i < N) {
+            uint16_t x = samples[i * stride];
+            delta[N_block++] = map_residual(x, prediction);
+            prediction = x;
+            i++;
+        }
+        // Last block may be short, the decoder knows N.
+        encode_block(&bs, delta, N_block, first, samples[0]);
+        first = false;
+    }
+
+    if (bs.overflow) {
+        return 0;
+    }
+    // Zero fill of the last partial byte.
+    if (bs.bit_pos & 0x07) {
+        put_bits(&bs, 0, 8 - (bs.bit_pos & 0x07));
+    }
+    return bs.bit_pos >> 3;
+}
+
+
+/** Decompress a stream made by rice_encode
+	@param in Compressed input
+	@param in_len Input length in bytes
+	@param samples Output samples
+	@param N Number of samples that were compressed
+	@param stride Distance between consecutive samples in the output
+	@return Number of input bytes consumed, 0 on a malformed or truncated stream
+*/
+size_t rice_decode(const uint8_t* in, size_t in_len, uint16_t* samples, size_t N, size_t stride) {
+    Rice_bit_stream_t bs = { .buf = (uint8_t*) in, .len = in_len, .bit_pos = 0, .overflow = false };
+    if (N == 0) {
+        return 0;
+    }
+
+    uint16_t prediction = 0;
+    size_t   i = 0;
+    bool     first = true;
+
+    while ((first || i < N) && !bs.overflow) {
+        uint32_t delta[RICE_BLOCK_LEN + 2];
+        uint8_t  block_len = first ? RICE_BLOCK_LEN - 1 : RICE_BLOCK_LEN;
+        size_t   remaining = first ? N - 1 : N - i;
+        if (remaining < block_len) {
+            block_len = remaining;
+        }
+        uint8_t  ID = get_bits(&bs, RICE_ID_BITS);
+
+        if (ID == RICE_ID_SECOND_EXT && get_bits(&bs, 1) == 0) {
+            return 0; // Zero-block option is never produced by the encoder.
+        }
+        if (first) {
+            prediction = get_bits(&bs, RICE_N_BITS);
+            samples[0] = prediction;
+            i = 1;
+        }
+
+        if (ID == RICE_ID_SECOND_EXT) {
+            uint8_t N_SE = first ? block_len + 1 : block_len;
+            N_SE += N_SE & 0x01;
+            for (uint8_t j = 0; j < N_SE; j += 2) {
+                uint32_t gamma = get_FS(&bs);
+                uint32_t beta = 0;
+                while ((beta + 1) * (beta + 2) / 2 <= gamma) {
+                    beta++;
+                }
+                uint32_t b = gamma - beta * (beta + 1) / 2;
+                delta[j] = beta - b;
+                delta[j + 1] = b;
+            }
+            if (first) {
+                for (uint8_t j = 0; j < block_len; j++) {
+                    delta[j] = delta[j + 1]; // Drop the leading zero paired with the reference.
+                }
+            }
+        } else if (ID == RICE_ID_NO_COMP) {
+            for (uint8_t j = 0; j < block_len; j++) {
+                delta[j] = get_bits(&bs, RICE_N_BITS);
+            }
+        } else {
+            uint8_t k = ID - RICE_ID_FS;
+            for (uint8_t j = 0; j < block_len; j++) {
+                delta[j] = get_FS(&bs) << k;
+            }
+            for (uint8_t j = 0; j < block_len && k > 0; j++) {
+                delta[j] |= get_bits(&bs, k);
+            }
+        }
+
+        for (uint8_t j = 0; j < block_len && i < N; j++) {
+            prediction = unmap_residual(delta[j], prediction);
+            samples[i * stride] = prediction;
+            i++;
+        }
+        first = false;
+    }
+
+    if (bs.overflow) {
+        return 0;
+    }
+    return (bs.bit_pos + 7) >> 3;
+}
+
+
+/** Decompress the per-channel streams of interleaved samples, the layout of SC_FORMAT_RICE
+    science packets: the stream of channel 0 followed by the stream of channel 1 and so on
+	@param in Compressed input
+	@param in_len Input length in bytes
+	@param samples Output samples, N_channels values per sample
+	@param N Number of samples per channel
+	@param N_channels Number of channels
+	@return Number of input bytes consumed, 0 on a malformed or truncated stream
+*/
+size_t rice_decode_channels(const uint8_t* in, size_t in_len, uint16_t* samples, size_t N, size_t N_channels) {
+    size_t pos = 0;
+    for (size_t c = 0; c < N_channels; c++) {
+        size_t used = rice_decode(in + pos, in_len - pos, samples + c, N, N_channels);
+        if (used == 0) {
+            return 0;
+        }
+        pos += used;
+    }
+    return pos;
+}
@@ -0,0 +1,464 @@
+/*
+ * scientific_data.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "scientific_data.h"
+#include "langmuir_probe_bias.h"
+#include "rice_compression.h"
+#include "CB_filter.h"
+#include "sweep_data.h"
+#include "CB_trigger.h"
+#include "on_board_time.h"
+
+extern UART_HandleTypeDef huart5;
+
+/*  Constant bias scientific data pipeline.
+ *
+ *  UART5 DMA -> circular buffer -> frame parser -> packetizer -> OBC.
+ *
+ *  Constant bias frames go through the event trigger at full rate and through the CB filter
+ *  and packetizer, sweep frames are assembled into sweep records by sweep_data.c.
+ *
+ *  The circular DMA buffer is the ring. The DMA is the only producer and the half/complete
+ *  callbacks only count finished halves, the main loop is the only consumer. Positions are
+ *  kept as free running byte counters, so no locking is needed between the two.
+ */
+DMA_BUFFER static uint8_t sc_dma_buf[SC_DMA_BUF_LEN];
+static volatile uint32_t sc_dma_halves = 0;     // Written only by the UART5 DMA callbacks
+static uint32_t          sc_read_total = 0;     // Written only by the main loop
+static volatile bool     sc_restart_pending = false; // Set by the UART5 error callback
+
+/*  Time references of the stream, pairs of a stream position and the on-board time at which
+ *  that byte was received. The DMA half/complete callbacks and the UART5 IDLE interrupt, which
+ *  marks the end of every burst, add references to a small ring. A frame is timed from the
+ *  first reference at or after its last byte, going back at the UART byte rate. The FPGA
+ *  sends back-to-back within a burst and every burst ends with a reference, so no idle gap
+ *  lies between a frame and its reference. Frames received after the newest reference are
+ *  timed from the DMA position read by the main loop, see process_scientific_data().
+ */
+typedef struct {
+    uint32_t pos;                               // Stream position of the byte
+    uint64_t cycles;                            // On-board time in cycles at which it was received
+} SC_time_ref_t;
+
+static SC_time_ref_t     sc_refs[SC_TIME_REFS];
+static volatile uint32_t sc_refs_written = 0;   // Written only by the UART5 interrupts
+static uint32_t          sc_refs_read = 0;      // Written only by the main loop
+static SC_time_ref_t     sc_now_ref = {0};      // Last byte available to the main loop
+static uint32_t          sc_frame_end_pos = 0;  // Stream position of the last byte of the current frame
+
+static uint8_t  sc_frame[SC_MAX_FRAME_LEN];
+static uint8_t  sc_frame_len = 0;
+static uint8_t  sc_frame_expected_len = 0;
+
+static uint8_t  cb_packet_data[SC_CB_PACKET_HEADER_LEN + SC_CB_MAX_SAMPLES_PER_PACKET * SC_CB_SAMPLE_LEN];
+static uint8_t  cb_packet_samples = 0;
+static uint16_t cb_next_sample_seq = 0;
+static uint32_t cb_packet_start_tick = 0;
+static uint8_t  cb_samples_per_packet = SC_CB_DEF_SAMPLES_PER_PACKET;
+static uint16_t cb_flush_timeout = SC_CB_DEF_FLUSH_TIMEOUT;
+uint16_t        cb_sc_seq_count = 0;
+
+bool sc_data_en = false;
+SC_pipeline_stats_t SC_stats = {0};
+
+// Compression selection per science APID.
+static struct {
+    uint16_t APID;
+    bool     enabled;
+} SC_compression[] = {
+    { .APID = CB_SC_DATA_APID,  .enabled = false },
+    { .APID = SWT_SC_DATA_APID, .enabled = false },
+};
+#define NOF_SC_COMPRESSION_APIDS    (sizeof(SC_compression) / sizeof(SC_compression[0]))
+
+static void send_CB_packet();
+
+
+void enable_scientific_data_callback() {
+    // CB and sweep mode share the stream, enabling it again must not restart the DMA.
+    if (sc_data_en) {
+        return;
+    }
+    sc_dma_halves = 0;
+    sc_read_total = 0;
+    sc_frame_len = 0;
+    cb_packet_samples = 0;
+    CB_filter_reset();
+    CB_trigger_reset();
+    SWT_record_reset();
+    sc_data_en = true;
+    sc_restart_pending = false;
+    sc_refs_read = sc_refs_written;
+    HAL_UART_Receive_DMA(&huart5, sc_dma_buf, SC_DMA_BUF_LEN);
+    __HAL_UART_CLEAR_IDLEFLAG(&huart5);
+    __HAL_UART_ENABLE_IT(&huart5, UART_IT_IDLE);
+}
+
+
+void disable_scientific_data_callback() {
+    if (sc_data_en) {
+        process_scientific_data(xTaskGetTickCount());
+        if (cb_packet_samples > 0) {
+            send_CB_packet();
+        }
+        CB_trigger_flush();
+        SWT_flush();
+    }
+    sc_data_en = false;
+    __HAL_UART_DISABLE_IT(&huart5, UART_IT_IDLE);
+    HAL_UART_AbortReceive(&huart5);
+}
+
+
+static uint32_t get_write_total();
+
+
+// Interrupts of different priority add references, so the slot and the count are updated together.
+static void add_time_ref(uint32_t pos, uint64_t cycles) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t n = sc_refs_written;
+    sc_refs[n % SC_TIME_REFS].pos = pos;
+    sc_refs[n % SC_TIME_REFS].cycles = cycles;
+    __DMB();
+    sc_refs_written = n + 1;
+
+    __set_PRIMASK(primask);
+}
+
+
+// Called from both the half and full transfer complete callbacks of UART5.
+void SC_DMA_half_callback() {
+    uint64_t cycles = OBT_get_cycles();
+    sc_dma_halves++;
+    add_time_ref(sc_dma_halves * SC_DMA_HALF_LEN - 1, cycles);
+}
+
+
+// Called from the UART5 interrupt when the line went idle, one character after the last byte.
+void SC_UART_idle_callback() {
+    if (!sc_data_en) {
+        return;
+    }
+    uint64_t cycles = OBT_get_cycles() - (uint64_t) SC_UART_BITS_PER_BYTE * SystemCoreClock / SC_UART_BAUD;
+    add_time_ref(get_write_total() - 1, cycles);
+}
+
+
+// UART errors stop the DMA. Reception is restarted from the main loop, which owns the parser state.
+void SC_DMA_error_callback() {
+    if (sc_data_en) {
+        sc_restart_pending = true;
+    }
+}
+
+
+// Restarts reception after a UART error, the parser resynchronises on the next preamble.
+static void restart_reception() {
+    __HAL_UART_DISABLE_IT(&huart5, UART_IT_IDLE);
+    HAL_UART_AbortReceive(&huart5);
+    sc_restart_pending = false;
+    sc_dma_halves = 0;
+    sc_read_total = 0;
+    sc_frame_len = 0;
+    sc_refs_read = sc_refs_written;
+    SC_stats.sync_errors++;
+    HAL_UART_Receive_DMA(&huart5, sc_dma_buf, SC_DMA_BUF_LEN);
+    __HAL_UART_CLEAR_IDLEFLAG(&huart5);
+    __HAL_UART_ENABLE_IT(&huart5, UART_IT_IDLE);
+}
+
+
+// Total number of bytes written by the DMA since reception was started.
+static uint32_t get_write_total() {
+    uint32_t halves, remaining;
+    do {
+        halves = sc_dma_halves;
+        remaining = __HAL_DMA_GET_COUNTER(huart5.hdmarx);
+    } while (halves != sc_dma_halves);
+
+    int32_t offset = (int32_t)(SC_DMA_BUF_LEN - remaining) - (int32_t)((halves & 1) * SC_DMA_HALF_LEN);
+    if (offset < 0) {
+        offset += SC_DMA_BUF_LEN; // Buffer wrapped, complete callback not handled yet.
+    }
+    return halves * SC_DMA_HALF_LEN + offset;
+}
+
+
+// On-board time in us at which the last byte of the frame being parsed was received.
+uint64_t SC_frame_time_us() {
+    SC_time_ref_t ref = sc_now_ref;
+
+    // References before the frame belong to earlier frames and are dropped.
+    while (sc_refs_read != sc_refs_written) {
+        uint32_t written = sc_refs_written;
+        if (written - sc_refs_read > SC_TIME_REFS) {
+            sc_refs_read = written - SC_TIME_REFS; // Overwritten before the main loop got to them
+        }
+        SC_time_ref_t next = sc_refs[sc_refs_read % SC_TIME_REFS];
+        __DMB();
+        if (sc_refs_written - sc_refs_read > SC_TIME_REFS) {
+            continue; // Overwritten while being read
+        }
+        if ((int32_t)(next.pos - sc_frame_end_pos) >= 0) {
+            ref = next;
+            break;
+        }
+        sc_refs_read++;
+    }
+
+    uint32_t bytes_before_ref = ref.pos - sc_frame_end_pos;
+    uint64_t offset_us = (uint64_t) bytes_before_ref * SC_UART_BITS_PER_BYTE * 1000000 / SC_UART_BAUD;
+    return OBT_cycles_to_us(ref.cycles) - offset_us;
+}
+
+
+bool SC_compression_enabled(uint16_t APID) {
+    for (int i = 0; i < NOF_SC_COMPRESSION_APIDS; i++) {
+        if (SC_compression[i].APID == APID) {
+            return SC_compression[i].enabled;
+        }
+    }
+    return false;
+}
+
+
+/*  Compresses N two-channel samples (probe 0, probe 1, little-endian) into out. The channels
+ *  are compressed as two consecutive streams, channel 0 first. Returns the compressed length,
+ *  or 0 if it is not smaller than the raw data.
+ */
+uint16_t SC_compress_samples(uint8_t* raw, uint16_t N, uint8_t* out) {
+    uint16_t samples[SC_MAX_COMPRESS_SAMPLES * 2];
+    uint16_t raw_len = N * 2 * sizeof(uint16_t);
+    if (N > SC_MAX_COMPRESS_SAMPLES) {
+        return 0;
+    }
+    memcpy(samples, raw, raw_len);
+
+    size_t len0 = rice_encode(samples, N, 2, out, raw_len);
+    if (len0 == 0) {
+        return 0;
+    }
+    size_t len1 = rice_encode(samples + 1, N, 2, out + len0, raw_len - len0);
+    if (len1 == 0) {
+        return 0;
+    }
+    return (len0 + len1 < raw_len) ? len0 + len1 : 0;
+}
+
+
+static void send_CB_packet() {
+    uint8_t* data = cb_packet_data;
+    uint16_t data_len = SC_CB_PACKET_HEADER_LEN + cb_packet_samples * SC_CB_SAMPLE_LEN;
+    uint8_t  compressed[SC_CB_PACKET_HEADER_LEN + SC_CB_MAX_SAMPLES_PER_PACKET * SC_CB_SAMPLE_LEN];
+
+    cb_packet_data[2] = cb_packet_samples;
+    cb_packet_data[3] = SC_FORMAT_RAW;
+
+    if (SC_compression_enabled(CB_SC_DATA_APID)) {
+        uint16_t comp_len = SC_compress_samples(cb_packet_data + SC_CB_PACKET_HEADER_LEN, cb_packet_samples,
+                                                compressed + SC_CB_PACKET_HEADER_LEN);
+        if (comp_len > 0) {
+            memcpy(compressed, cb_packet_data, SC_CB_PACKET_HEADER_LEN);
+            compressed[3] = SC_FORMAT_RICE;
+            data = compressed;
+            data_len = SC_CB_PACKET_HEADER_LEN + comp_len;
+        }
+    }
+
+    SPP_header_t SC_SPP_header = SPP_make_header(
+        SPP_VERSION,
+        SPP_PACKET_TYPE_TM,
+        0,
+        CB_SC_DATA_APID,
+        SPP_SEQUENCE_SEG_UNSEG,
+        cb_sc_seq_count,
+        data_len + CRC_BYTE_LEN - 1
+    );
+    SPP_send_TM(&SC_SPP_header, NULL, data, data_len);
+    cb_sc_seq_count = (cb_sc_seq_count + 1) & 0x3FFF; // 14-bit packet sequence count
+    cb_packet_samples = 0;
+    SC_stats.packets_out++;
+}
+
+
+static void add_CB_sample(CB_sample_t* sample) {
+    uint16_t sample_seq = sample->seq;
+
+    // A gap in the FPGA sequence numbers starts a new packet.
+    if (cb_packet_samples > 0 && sample_seq != cb_next_sample_seq) {
+        send_CB_packet();
+    }
+    if (cb_packet_samples == 0) {
+        uint64_t sample_time = SC_frame_time_us();
+        memcpy(cb_packet_data, &sample_seq, sizeof(sample_seq));
+        memcpy(cb_packet_data + 4, &sample_time, sizeof(sample_time));
+        cb_packet_start_tick = xTaskGetTickCount();
+    }
+
+    memcpy(cb_packet_data + SC_CB_PACKET_HEADER_LEN + (cb_packet_samples * SC_CB_SAMPLE_LEN), sample->value, SC_CB_SAMPLE_LEN);
+    cb_packet_samples++;
+    // Decimated samples advance the FPGA sequence number by the decimation ratio.
+    cb_next_sample_seq = sample_seq + CB_filter_decimation();
+
+    if (cb_packet_samples >= cb_samples_per_packet) {
+        send_CB_packet();
+    }
+}
+
+
+static void parse_byte(uint8_t byte, uint32_t pos) {
+    if (sc_frame_len == 0) {
+        switch (byte) {
+            case SCIENTIFIC_DATA_PREAMBLE:
+                sc_frame_expected_len = SC_CB_FRAME_LEN;
+                break;
+            case SWT_SC_DATA_PREAMBLE:
+                sc_frame_expected_len = SC_SWT_FRAME_LEN;
+                break;
+            default:
+                SC_stats.sync_errors++;
+                return;
+        }
+    }
+    sc_frame[sc_frame_len++] = byte;
+    if (sc_frame_len < sc_frame_expected_len) {
+        return;
+    }
+    sc_frame_len = 0;
+    sc_frame_end_pos = pos;
+    SC_stats.samples_in++;
+
+    if (sc_frame[0] == SCIENTIFIC_DATA_PREAMBLE) {
+        // Frame: preamble, FPGA sequence number (2), probe 0 (2), probe 1 (2)
+        CB_sample_t in, out;
+        memcpy(&in.seq, sc_frame + 1, sizeof(in.seq));
+        memcpy(in.value, sc_frame + 3, sizeof(in.value));
+        CB_trigger_push(&in);
+        if (CB_filter_push(&in, &out)) {
+            add_CB_sample(&out);
+        }
+    } else {
+        // Frame: preamble, sweep counter (2), step ID, probe 0 (2), probe 1 (2)
+        uint16_t sweep_cnt;
+        uint16_t value[2];
+        memcpy(&sweep_cnt, sc_frame + 1, sizeof(sweep_cnt));
+        memcpy(value, sc_frame + 4, sizeof(value));
+        SWT_add_sample(sweep_cnt, sc_frame[3], value);
+    }
+}
+
+
+// Called from the main loop. Consumes everything the DMA has written since the last call
+// and flushes a partially filled packet once its oldest sample is cb_flush_timeout old.
+void process_scientific_data(uint32_t current_ticks) {
+    if (!sc_data_en) {
+        return;
+    }
+    if (sc_restart_pending) {
+        restart_reception();
+    }
+    // The newest byte arrived at most one character before now, otherwise the IDLE
+    // interrupt has already added a reference for it.
+    sc_now_ref.cycles = OBT_get_cycles();
+    uint32_t write_total = get_write_total();
+    uint32_t available = write_total - sc_read_total;
+    sc_now_ref.pos = write_total - 1;
+
+    // Consumer fell behind, the oldest bytes are (about to be) overwritten by the DMA.
+    if (available > SC_DMA_BUF_LEN - SC_DMA_GUARD_LEN) {
+        uint32_t skip = available - (SC_DMA_BUF_LEN - SC_DMA_GUARD_LEN);
+        SC_stats.bytes_dropped += skip;
+        sc_read_total += skip;
+        sc_frame_len = 0;
+        available -= skip;
+    }
+
+    while (available > 0) {
+        uint32_t pos = sc_read_total % SC_DMA_BUF_LEN;
+        uint32_t chunk = SC_DMA_BUF_LEN - pos;
+        if (chunk > available) {
+            chunk = available;
+        }
+        for (uint32_t i = 0; i < chunk; i++) {
+            parse_byte(sc_dma_buf[pos + i], sc_read_total + i);
+        }
+        sc_read_total += chunk;
+        available -= chunk;
+    }
+    if (cb_packet_samples > 0 && (current_ticks - cb_packet_start_tick) >= cb_flush_timeout) {
+        send_CB_packet();
+    }
+    SWT_process(current_ticks);
+}
+
+
+// Samples per packet (SC_N_SAMPLES_ARG_ID) and flush timeout in ms (FLUSH_TIMEOUT_MS_ARG_ID).
+SPP_error set_CB_packing(uint8_t N_args, uint8_t* data) {
+    uint8_t  N_samples = cb_samples_per_packet;
+    uint16_t flush_timeout = cb_flush_timeout;
+
+    for (int i = 0; i < N_args; i++) {
+        uint8_t arg_ID = *data++;
+        switch (arg_ID) {
+            case SC_N_SAMPLES_ARG_ID:
+                N_samples = *data++;
+                break;
+            case FLUSH_TIMEOUT_MS_ARG_ID:
+                memcpy(&flush_timeout, data, sizeof(flush_timeout));
+                data += sizeof(flush_timeout);
+                break;
+            default:
+                data += FPGA_arg_width(arg_ID);
+                break;
+        }
+    }
+    if (N_samples == 0 || N_samples > SC_CB_MAX_SAMPLES_PER_PACKET) {
+        return SPP_PUS8_ERROR;
+    }
+
+    // Packet in progress is sent with the old settings.
+    if (cb_packet_samples > 0) {
+        send_CB_packet();
+    }
+    cb_samples_per_packet = N_samples;
+    cb_flush_timeout = flush_timeout;
+    return SPP_OK;
+}
+
+
+// Enables or disables compression (ENABLE_ARG_ID) of a science APID (APID_ARG_ID).
+SPP_error set_SC_compression(uint8_t N_args, uint8_t* data) {
+    uint16_t APID = 0xFFFF;
+    uint8_t  enable = 0xFF;
+
+    for (int i = 0; i < N_args; i++) {
+        uint8_t arg_ID = *data++;
+        switch (arg_ID) {
+            case APID_ARG_ID:
+                memcpy(&APID, data, sizeof(APID));
+                data += sizeof(APID);
+                break;
+            case ENABLE_ARG_ID:
+                enable = *data++;
+                break;
+            default:
+                data += FPGA_arg_width(arg_ID);
+                break;
+        }
+    }
+    if (enable == 0xFF) {
+        return SPP_PUS8_ERROR;
+    }
+    for (int i = 0; i < NOF_SC_COMPRESSION_APIDS; i++) {
+        if (SC_compression[i].APID == APID) {
+            SC_compression[i].enabled = (enable != 0);
+            return SPP_OK;
+        }
+    }
+    return SPP_PUS8_ERROR;
+}
@@ -73,9 +73,21 @@ See BSP_SD_ErrorCallback() and BSP_SD_AbortCallback() below
  * Notice: This is applicable only for cortex M7 based platform.
  */
 /* USER CODE BEGIN enableSDDmaCacheMaintenance */
-/* #define ENABLE_SD_DMA_CACHE_MAINTENANCE  1 */
+#if CPU_CACHE_ENABLE
+#define ENABLE_SD_DMA_CACHE_MAINTENANCE  1
+#endif
 /* USER CODE BEGIN enableSDDmaCacheMaintenance */
 
+/*
+* With cache maintenance, a read buffer is invalidated after the transfer, which is only
+* safe on whole cache lines. Read buffers not 32-byte aligned go through the scratch buffer.
+*/
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+#define SD_READ_ALIGN_MASK 0x1F
+#else
+#define SD_READ_ALIGN_MASK 0x3
+#endif
+
 /*
 * Some DMA requires 4-Byte aligned address buffer to correctly read/wite data,
 * in FatFs some accesses aren't thus we need a 4-byte aligned scratch buffer to correctly
@@ -234,10 +246,16 @@ DRESULT SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
   }
 
 #if defined(ENABLE_SCRATCH_BUFFER)
-  if (!((uint32_t)buff & 0x3))
+  if (!((uint32_t)buff & SD_READ_ALIGN_MASK))
   {
 #endif
     /* Fast path cause destination buffer is correctly aligned */
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+    /*
+    * Drop any cached lines of the buffer, so none is evicted over the data during the transfer
+    */
+    SCB_InvalidateDCache_by_Addr((uint32_t*)buff, count*BLOCKSIZE);
+#endif
     uint8_t ret = BSP_SD_ReadBlocks_DMA((uint32_t*)buff, (uint32_t)(sector), count);
 
     if (ret == MSD_OK) {
@@ -330,11 +348,11 @@ DRESULT SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
 #endif
 #if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
     /*
-    * Invalidate the chache before writting into the buffer.
+    * Clean the cache before the DMA reads the buffer, so it sends the data written by the CPU.
     * This is not needed if the memory region is configured as W/T.
     */
     alignedAddr = (uint32_t)buff & ~0x1F;
-    SCB_InvalidateDCache_by_Addr((uint32_t*)alignedAddr, count*BLOCKSIZE + ((uint32_t)buff - alignedAddr));
+    SCB_CleanDCache_by_Addr((uint32_t*)alignedAddr, count*BLOCKSIZE + ((uint32_t)buff - alignedAddr));
 #endif
     if(BSP_SD_WriteBlocks_DMA((uint32_t*)buff,
                               (uint32_t) (sector),
@@ -366,24 +384,25 @@ DRESULT SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
     /* Slow path, fetch each sector a part and memcpy to destination buffer */
     int i;
     uint8_t ret;
-#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
-    /*
-    * invalidate the scratch buffer before the next write to get the actual data instead of the cached one
-    */
-    SCB_InvalidateDCache_by_Addr((uint32_t*)scratch, BLOCKSIZE);
-#endif
 
     for (i = 0; i < count; i++) {
+      /* copy the sector into the scratch buffer before it is sent */
+      memcpy((void *)scratch, (const void *)buff, BLOCKSIZE);
+      buff += BLOCKSIZE;
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+      /*
+      * clean the scratch buffer so the DMA sends the copied data instead of stale memory
+      */
+      SCB_CleanDCache_by_Addr((uint32_t*)scratch, BLOCKSIZE);
+#endif
       ret = BSP_SD_WriteBlocks_DMA((uint32_t*)scratch, (uint32_t)sector++, 1);
       if (ret == MSD_OK) {
         /* wait for a message from the queue or a timeout */
         event = osMessageGet(SDQueueID, SD_TIMEOUT);
 
-        if (event.status == osEventMessage) {
-          if (event.value.v == WRITE_CPLT_MSG) {
-            memcpy((void *)buff, (void *)scratch, BLOCKSIZE);
-            buff += BLOCKSIZE;
-          }
+        if (event.status != osEventMessage || event.value.v != WRITE_CPLT_MSG) {
+          ret = MSD_ERROR;
+          break;
         }
       }
       else
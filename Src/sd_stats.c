@@ -0,0 +1,49 @@
+/*
+ * sd_stats.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "sd_stats.h"
+#include <string.h>
+
+SD_writer_stats_t SD_stats = {0};
+
+
+uint8_t SDS_bucket(uint32_t us) {
+    uint8_t bucket = 0;
+    while (us >= SDS_HIST_BASE_US && bucket < SDS_HIST_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+
+// Lowest latency that falls into a bucket
+uint32_t SDS_bucket_floor_us(uint8_t bucket) {
+    return (bucket == 0) ? 0 : ((uint32_t) SDS_HIST_BASE_US << (bucket - 1));
+}
+
+
+// Operations are far shorter than the ~20 s wrap of the 32-bit counter, the difference is exact.
+void SDS_record(SDS_hist_t* hist, uint32_t start_cycles) {
+    uint32_t us = (DWT->CYCCNT - start_cycles) / (SystemCoreClock / 1000000);
+
+    hist->count++;
+    hist->total_us += us;
+    if (us > hist->max_us) {
+        hist->max_us = us;
+    }
+    hist->buckets[SDS_bucket(us)]++;
+}
+
+
+uint32_t SDS_mean_us(const SDS_hist_t* hist) {
+    return (hist->count == 0) ? 0 : (uint32_t)(hist->total_us / hist->count);
+}
+
+
+void SDS_reset() {
+    memset(&SD_stats, 0, sizeof(SD_stats));
+}
@@ -25,6 +25,7 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "FPGA_Data_Saving.h"
+#include "scientific_data.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -364,7 +365,11 @@ void UART4_IRQHandler(void)
 void UART5_IRQHandler(void)
 {
   /* USER CODE BEGIN UART5_IRQn 0 */
-
+  // End of a burst from the FPGA, timestamps the last received byte. Not handled by the HAL.
+  if (__HAL_UART_GET_IT(&huart5, UART_IT_IDLE) && __HAL_UART_GET_IT_SOURCE(&huart5, UART_IT_IDLE)) {
+    __HAL_UART_CLEAR_IDLEFLAG(&huart5);
+    SC_UART_idle_callback();
+  }
   /* USER CODE END UART5_IRQn 0 */
   HAL_UART_IRQHandler(&huart5);
   /* USER CODE BEGIN UART5_IRQn 1 */
@@ -0,0 +1,226 @@
+/*
+ * storage_manager.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "storage_manager.h"
+#include "FPGA_Data_Saving.h"
+#include "uC_Data_Saving.h"
+#include "FRAM.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+extern uint8_t ffuID;
+extern uint8_t unitID;
+
+STOR_config_t STOR_config = {
+    .max_size       = {STOR_DEF_FPGA_MAX_SIZE, STOR_DEF_UC_MAX_SIZE},
+    .max_age        = {STOR_DEF_FPGA_MAX_AGE, STOR_DEF_UC_MAX_AGE},
+    .low_watermark  = STOR_DEF_LOW_WATERMARK,
+    .high_watermark = STOR_DEF_HIGH_WATERMARK,
+};
+
+STOR_stats_t STOR_stats = {0};
+
+static const char* series_names[NOF_STOR_SERIES] = {"FPGA", "UC"};
+
+// Number and opening tick of the file currently written in each series
+static uint32_t current_file_no[NOF_STOR_SERIES] = {0};
+static uint32_t opened_tick[NOF_STOR_SERIES] = {0};
+static uint8_t  has_current[NOF_STOR_SERIES] = {0};
+
+// Next file number of each series, valid once checked against the card
+static uint32_t next_file_no[NOF_STOR_SERIES] = {0};
+static uint8_t  next_file_no_valid[NOF_STOR_SERIES] = {0};
+
+static uint32_t last_poll_tick = 0;
+
+
+static const char* unit_name() {
+    switch (unitID) {
+        case 0x1A:
+            return "CU";
+        case 0x1B:
+            return "EMU_CONTROL";
+        case 0x1C:
+            return "EMU_SCIENCE";
+        case 0x1D:
+            return "SMILE";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+
+void STOR_file_name(char* out, uint8_t series, uint32_t file_no, const char* ext) {
+    sprintf(out, "/FFU%d_%s_%s_%" PRIu32 "%s", ffuID, unit_name(), series_names[series], file_no, ext);
+}
+
+
+// Finds the lowest and highest file number of a series on the card. Returns 0 if it has no files.
+uint8_t STOR_find_series(uint8_t series, uint32_t* lowest, uint32_t* highest) {
+    char prefix[48];
+    char pattern[sizeof(prefix) + 5];
+    DIR dir;
+    FILINFO fno;
+    uint8_t found = 0;
+
+    snprintf(prefix, sizeof(prefix), "FFU%d_%s_%s_", ffuID, unit_name(), series_names[series]);
+    snprintf(pattern, sizeof(pattern), "%s*.bin", prefix);
+    size_t prefix_len = strlen(prefix);
+
+    FRESULT res = f_findfirst(&dir, &fno, "/", pattern);
+    while (res == FR_OK && fno.fname[0] != 0) {
+        char* end;
+        uint32_t file_no = strtoul(fno.fname + prefix_len, &end, 10);
+
+        if (end != fno.fname + prefix_len && strcmp(end, ".bin") == 0) {
+            if (!found || file_no < *lowest) {
+                *lowest = file_no;
+            }
+            if (!found || file_no > *highest) {
+                *highest = file_no;
+            }
+            found = 1;
+        }
+        res = f_findnext(&dir, &fno);
+    }
+    f_closedir(&dir);
+    return found;
+}
+
+
+static uint32_t load_next_file_no(uint8_t series) {
+    uint32_t record[2] = {0, 0};
+
+    if (readFRAM(FRAM_FILE_NO_SECTION_START + series * FRAM_FILE_NO_SIZE, (uint8_t*) record, sizeof(record)) != HAL_OK ||
+        record[1] != ~record[0]) {
+        return 0;
+    }
+    return record[0];
+}
+
+
+static void save_next_file_no(uint8_t series, uint32_t file_no) {
+    uint32_t record[2] = {file_no, ~file_no};
+    writeFRAM(FRAM_FILE_NO_SECTION_START + series * FRAM_FILE_NO_SIZE, (uint8_t*) record, sizeof(record));
+}
+
+
+/*  Returns the number of a new file of a series and makes it the current one, which is never
+ *  deleted. The counter is advanced in FRAM before the file is created, a failed f_open only
+ *  skips a number.
+ */
+uint32_t STOR_new_file(uint8_t series, uint32_t current_ticks) {
+    if (!next_file_no_valid[series]) {
+        uint32_t lowest = 0;
+        uint32_t highest = 0;
+
+        next_file_no[series] = load_next_file_no(series);
+        if (STOR_find_series(series, &lowest, &highest) && highest >= next_file_no[series]) {
+            next_file_no[series] = highest + 1;
+        }
+        next_file_no_valid[series] = 1;
+    }
+
+    uint32_t file_no = next_file_no[series]++;
+    save_next_file_no(series, next_file_no[series]);
+
+    if (has_current[series]) {
+        STOR_stats.rotations++;
+    }
+    current_file_no[series] = file_no;
+    opened_tick[series] = current_ticks;
+    has_current[series] = 1;
+    return file_no;
+}
+
+
+// Whether the current file of a series has to be closed before another size bytes are added to it.
+uint8_t STOR_rotation_due(uint8_t series, FSIZE_t size, uint32_t current_ticks) {
+    uint32_t max_size = STOR_config.max_size[series];
+    uint32_t max_age = STOR_config.max_age[series];
+
+    return (max_size != 0 && size > max_size) ||
+           (max_age != 0 && current_ticks - opened_tick[series] >= max_age);
+}
+
+
+FRESULT STOR_update_usage() {
+    FATFS* fs;
+    DWORD free_clusters;
+
+    FRESULT res = f_getfree("", &free_clusters, &fs);
+    if (res == FR_OK) {
+        // Cluster size in kB, sectors are _MAX_SS bytes
+        uint32_t cluster_kB = fs->csize * _MAX_SS / 1024;
+        STOR_stats.total_kB = (fs->n_fatent - 2) * cluster_kB;
+        STOR_stats.free_kB = free_clusters * cluster_kB;
+    }
+    return res;
+}
+
+
+// Deletes the oldest closed file, FPGA files first. Returns 0 if there was nothing left to delete.
+static uint8_t delete_oldest() {
+    for (uint8_t series = 0; series < NOF_STOR_SERIES; series++) {
+        uint32_t lowest = 0;
+        uint32_t highest = 0;
+        char file_name[64];
+        FILINFO fno;
+
+        if (!STOR_find_series(series, &lowest, &highest)) {
+            continue;
+        }
+        if (has_current[series] && lowest == current_file_no[series]) {
+            continue;
+        }
+
+        STOR_file_name(file_name, series, lowest, ".bin");
+        if (f_stat((const TCHAR*) file_name, &fno) != FR_OK || f_unlink((const TCHAR*) file_name) != FR_OK) {
+            // Stops reclaiming rather than deleting newer files around a file that cannot be deleted
+            return 0;
+        }
+        STOR_stats.files_deleted++;
+        STOR_stats.kB_reclaimed += (uint32_t)(fno.fsize / 1024);
+
+        if (series == STOR_SERIES_FPGA) {
+            STOR_file_name(file_name, series, lowest, ".idx");
+            f_unlink((const TCHAR*) file_name);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+
+/*  Called from the main loop. Does nothing while no data file is open, the card may not even be
+ *  mounted then. Deleting a large file walks its whole cluster chain, so only one file is deleted
+ *  per call to keep the main loop responsive.
+ */
+void STOR_poll(uint32_t current_ticks) {
+    if (!FPGAFileOpen && !uCFileOpen) {
+        return;
+    }
+
+    if (!STOR_stats.reclaiming) {
+        if (current_ticks - last_poll_tick < STOR_POLL_INTERVAL) {
+            return;
+        }
+        last_poll_tick = current_ticks;
+
+        if (STOR_update_usage() != FR_OK) {
+            return;
+        }
+        STOR_stats.reclaiming = (STOR_stats.free_kB < STOR_config.low_watermark);
+        return;
+    }
+
+    if (!delete_oldest() || STOR_update_usage() != FR_OK || STOR_stats.free_kB >= STOR_config.high_watermark) {
+        STOR_stats.reclaiming = 0;
+        last_poll_tick = current_ticks;
+    }
+}
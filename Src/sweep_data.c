@@ -0,0 +1,460 @@
+/*
+ * sweep_data.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "sweep_data.h"
+#include "FPGA_config_mirror.h"
+#include "IV_analysis.h"
+#include "uC_Data_Saving.h"
+
+/*  Sweep mode scientific data.
+ *
+ *  Every sample of a sweep frame is accumulated into the step it belongs to. A sweep is
+ *  closed when its last step has received all of its samples, when a sample of the next
+ *  sweep arrives, or after SWT_RECORD_TIMEOUT without samples. The closed sweep is
+ *  serialised into a record and written to the SD card.
+ *
+ *  With averaging off every record is downlinked and analysed. With averaging on, the step
+ *  means of swt_avg_N consecutive sweeps are summed into the accumulator and only their
+ *  mean curve is downlinked and analysed.
+ */
+typedef struct {
+    uint16_t sweep_cnt;
+    uint64_t start_time;        // On-board time of the first sample [us]
+    uint16_t N_steps;
+    uint16_t samples_per_step;  // 0 if unknown
+    uint8_t  N_sweeps;
+    uint8_t  status;
+    uint32_t step_bitmap[SWT_MAX_STEPS / 32];
+} SWT_record_info_t;
+
+static struct {
+    bool     active;
+    SWT_record_info_t info;
+    uint16_t steps_complete;
+    uint32_t last_sample_tick;
+    uint16_t N_samples[SWT_MAX_STEPS];
+    uint32_t sum[SWT_MAX_STEPS][2];
+} swt_rec;
+
+static struct {
+    SWT_record_info_t info;     // info.N_sweeps is the number of sweeps accumulated so far
+    uint8_t  N[SWT_MAX_STEPS];  // Sweeps that contained the step
+    uint32_t sum[SWT_MAX_STEPS][2];
+    uint64_t sum_sq[SWT_MAX_STEPS][2];
+} swt_avg;
+
+static uint8_t  swt_avg_N = 1;
+static bool     swt_avg_sigma = false;
+
+// FRAM table last copied into each FPGA sweep table.
+static uint8_t  swt_table_id[FPGA_MIRROR_N_PROBES] = {SWT_TABLE_ID_UNKNOWN, SWT_TABLE_ID_UNKNOWN};
+static uint8_t  swt_record[SWT_RECORD_MAX_LEN];
+uint16_t        swt_sc_seq_count = 0;
+
+
+void SWT_record_reset() {
+    swt_rec.active = false;
+    swt_avg.info.N_sweeps = 0;
+}
+
+
+void SWT_set_table_ID(uint8_t FPGA_table_id, uint8_t FRAM_table_id) {
+    if (FPGA_table_id < FPGA_MIRROR_N_PROBES) {
+        swt_table_id[FPGA_table_id] = FRAM_table_id;
+    }
+}
+
+
+// Sweep geometry is taken from the FPGA configuration mirror when it is known.
+static void start_record(uint16_t sweep_cnt) {
+    FPGA_msg_arg_t fpgama = {0};
+    uint16_t value;
+
+    memset(&swt_rec, 0, sizeof(swt_rec));
+    swt_rec.active = true;
+    swt_rec.info.sweep_cnt = sweep_cnt;
+    swt_rec.info.start_time = SC_frame_time_us();
+    swt_rec.info.N_sweeps = 1;
+
+    if (FPGA_mirror_lookup(FPGA_REG_SWT_STEPS, &fpgama, &value)) {
+        swt_rec.info.N_steps = (value == 0 || value > SWT_MAX_STEPS) ? SWT_MAX_STEPS : value;
+    } else {
+        swt_rec.info.N_steps = SWT_MAX_STEPS;
+        swt_rec.info.status |= SWT_STATUS_NO_CONFIG;
+    }
+    if (FPGA_mirror_lookup(FPGA_REG_SWT_SAMPLES_PER_STEP, &fpgama, &value)) {
+        swt_rec.info.samples_per_step = value;
+    } else {
+        swt_rec.info.status |= SWT_STATUS_NO_CONFIG;
+    }
+}
+
+
+static bool step_received(SWT_record_info_t* info, uint16_t step) {
+    return (info->step_bitmap[step >> 5] >> (step & 0x1F)) & 0x01;
+}
+
+
+static uint16_t count_missing_steps(SWT_record_info_t* info) {
+    uint16_t missing = 0;
+    for (uint16_t step = 0; step < info->N_steps; step++) {
+        if (!step_received(info, step)) {
+            missing++;
+        }
+    }
+    return missing;
+}
+
+
+// Serialises a record into swt_record. sigma may be NULL. Returns the record length.
+static uint16_t build_record(SWT_record_info_t* info, uint16_t* means, uint16_t* sigma) {
+    uint16_t missing = count_missing_steps(info);
+    uint8_t* out = swt_record;
+
+    memcpy(out, &info->sweep_cnt, sizeof(info->sweep_cnt));
+    out += sizeof(info->sweep_cnt);
+    memcpy(out, &info->start_time, sizeof(info->start_time));
+    out += sizeof(info->start_time);
+    *out++ = swt_table_id[0];
+    *out++ = swt_table_id[1];
+    memcpy(out, &info->N_steps, sizeof(info->N_steps));
+    out += sizeof(info->N_steps);
+    memcpy(out, &info->samples_per_step, sizeof(info->samples_per_step));
+    out += sizeof(info->samples_per_step);
+    *out++ = info->N_sweeps;
+    *out++ = info->status;
+    memcpy(out, &missing, sizeof(missing));
+    out += sizeof(missing);
+    uint8_t* format = out++;
+    memcpy(out, info->step_bitmap, sizeof(info->step_bitmap));
+    out += sizeof(info->step_bitmap);
+
+    uint16_t data_len = info->N_steps * SC_CB_SAMPLE_LEN;
+    uint16_t comp_len = 0;
+    if (SC_compression_enabled(SWT_SC_DATA_APID)) {
+        comp_len = SC_compress_samples((uint8_t*) means, info->N_steps, out);
+    }
+    if (comp_len > 0) {
+        *format = SC_FORMAT_RICE;
+        out += comp_len;
+    } else {
+        *format = SC_FORMAT_RAW;
+        memcpy(out, means, data_len);
+        out += data_len;
+    }
+    if (sigma != NULL) {
+        *format |= SWT_FORMAT_SIGMA;
+        memcpy(out, sigma, data_len);
+        out += data_len;
+    }
+    return out - swt_record;
+}
+
+
+static void send_SWT_record(uint16_t sweep_cnt, uint16_t record_len) {
+    uint8_t TM_data[SWT_SEGMENT_HEADER_LEN + SWT_SEGMENT_DATA_LEN];
+
+    for (uint16_t offset = 0; offset < record_len; offset += SWT_SEGMENT_DATA_LEN) {
+        uint16_t seg_len = record_len - offset;
+        if (seg_len > SWT_SEGMENT_DATA_LEN) {
+            seg_len = SWT_SEGMENT_DATA_LEN;
+        }
+        bool first = (offset == 0);
+        bool last = (offset + seg_len == record_len);
+        uint8_t seq_flags = (first && last) ? SPP_SEQUENCE_SEG_UNSEG :
+                            first           ? SPP_SEQUENCE_SEG_FIRST :
+                            last            ? SPP_SEQUENCE_SEG_LAST  : SPP_SEQUENCE_SEG_CONT;
+
+        memcpy(TM_data, &sweep_cnt, sizeof(sweep_cnt));
+        memcpy(TM_data + 2, &offset, sizeof(offset));
+        memcpy(TM_data + SWT_SEGMENT_HEADER_LEN, swt_record + offset, seg_len);
+
+        SPP_header_t SPP_header = SPP_make_header(
+            SPP_VERSION,
+            SPP_PACKET_TYPE_TM,
+            0,
+            SWT_SC_DATA_APID,
+            seq_flags,
+            swt_sc_seq_count,
+            SWT_SEGMENT_HEADER_LEN + seg_len + CRC_BYTE_LEN - 1
+        );
+        SPP_send_TM(&SPP_header, NULL, TM_data, SWT_SEGMENT_HEADER_LEN + seg_len);
+        swt_sc_seq_count = (swt_sc_seq_count + 1) & 0x3FFF;
+        SC_stats.packets_out++;
+    }
+}
+
+
+static void save_SWT_record(uint16_t record_len) {
+    if (!uCFileOpen) {
+        return;
+    }
+    uint16_t sync = SWT_RECORD_SYNC;
+    UINT written;
+    if (rotateUCDataFile(sizeof(sync) + sizeof(record_len) + record_len) != FR_OK) {
+        return;
+    }
+    f_write(&uCDataFile, &sync, sizeof(sync), &written);
+    f_write(&uCDataFile, &record_len, sizeof(record_len), &written);
+    f_write(&uCDataFile, swt_record, record_len, &written);
+    f_sync(&uCDataFile);
+}
+
+
+// Runs the I-V analysis on the received steps of each probe whose bias table is mirrored.
+static void analyze_SWT_record(SWT_record_info_t* info, uint16_t* means) {
+    uint16_t bias[SWT_MAX_STEPS];
+    uint16_t current[SWT_MAX_STEPS];
+
+    for (uint8_t probe = 0; probe < FPGA_MIRROR_N_PROBES; probe++) {
+        uint16_t N = 0;
+        bool bias_known = true;
+
+        for (uint16_t step = 0; step < info->N_steps && bias_known; step++) {
+            if (!step_received(info, step)) {
+                continue;
+            }
+            FPGA_msg_arg_t fpgama = {.probe_ID = probe, .step_ID = step};
+            bias_known = FPGA_mirror_lookup(FPGA_REG_SWT_VOL_LVL, &fpgama, &bias[N]);
+            current[N++] = means[step * 2 + probe];
+        }
+        if (!bias_known || N == 0) {
+            continue;
+        }
+        IV_result_t result;
+        analyze_IV_curve(bias, current, N, &result);
+        send_IV_parameters(info->sweep_cnt, probe, &result);
+    }
+}
+
+
+static void downlink_SWT_record(SWT_record_info_t* info, uint16_t* means, uint16_t* sigma) {
+    uint16_t record_len = build_record(info, means, sigma);
+    send_SWT_record(info->sweep_cnt, record_len);
+    analyze_SWT_record(info, means);
+}
+
+
+static uint32_t isqrt64(uint64_t x) {
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t) root;
+}
+
+
+/*  Standard deviation of n values from their sum and sum of squares, rounded to the nearest
+ *  LSB. Near mid-scale both moments are ~1e9 and a float difference of them loses every
+ *  variance of a few LSB, so n^2 var = n sum_sq - sum^2 is formed exactly in 64 bits and
+ *  sigma = sqrt(n^2 var) / n is rounded up when (2 sigma_floor + 1)^2 n^2 <= 4 n^2 var.
+ */
+static uint16_t step_sigma(uint8_t n, uint32_t sum, uint64_t sum_sq) {
+    uint64_t n2_var = n * sum_sq - (uint64_t) sum * sum;
+    uint64_t n2 = (uint64_t) n * n;
+    uint64_t root = isqrt64(n2_var / n2);
+
+    if ((2 * root + 1) * (2 * root + 1) * n2 <= 4 * n2_var) {
+        root++;
+    }
+    return (uint16_t) root;
+}
+
+
+// Downlinks the mean curve of the accumulated sweeps. Steps missing from some of the
+// sweeps are averaged over the sweeps that contained them.
+static void send_average() {
+    uint16_t means[SWT_MAX_STEPS * 2];
+    uint16_t sigma[SWT_MAX_STEPS * 2];
+    SWT_record_info_t* info = &swt_avg.info;
+
+    if (info->N_sweeps == 0) {
+        return;
+    }
+    for (uint16_t step = 0; step < info->N_steps; step++) {
+        uint8_t n = swt_avg.N[step];
+        for (uint8_t probe = 0; probe < 2; probe++) {
+            uint16_t i = step * 2 + probe;
+            if (n == 0) {
+                means[i] = 0;
+                sigma[i] = 0;
+                continue;
+            }
+            means[i] = (swt_avg.sum[step][probe] + n / 2) / n;
+            if (swt_avg_sigma) {
+                sigma[i] = step_sigma(n, swt_avg.sum[step][probe], swt_avg.sum_sq[step][probe]);
+            }
+        }
+    }
+    downlink_SWT_record(info, means, swt_avg_sigma ? sigma : NULL);
+    info->N_sweeps = 0;
+}
+
+
+static void accumulate_sweep(SWT_record_info_t* info, uint16_t* means) {
+    // A change of sweep geometry ends the average early.
+    if (swt_avg.info.N_sweeps > 0 &&
+        (info->N_steps != swt_avg.info.N_steps || info->samples_per_step != swt_avg.info.samples_per_step)) {
+        send_average();
+    }
+    if (swt_avg.info.N_sweeps == 0) {
+        memset(&swt_avg, 0, sizeof(swt_avg));
+        swt_avg.info.sweep_cnt = info->sweep_cnt;
+        swt_avg.info.start_time = info->start_time;
+        swt_avg.info.N_steps = info->N_steps;
+        swt_avg.info.samples_per_step = info->samples_per_step;
+    }
+    swt_avg.info.N_sweeps++;
+    swt_avg.info.status |= info->status;
+
+    for (uint16_t step = 0; step < info->N_steps; step++) {
+        if (!step_received(info, step)) {
+            continue;
+        }
+        swt_avg.info.step_bitmap[step >> 5] |= 1UL << (step & 0x1F);
+        swt_avg.N[step]++;
+        for (uint8_t probe = 0; probe < 2; probe++) {
+            uint32_t value = means[step * 2 + probe];
+            swt_avg.sum[step][probe] += value;
+            swt_avg.sum_sq[step][probe] += value * value;
+        }
+    }
+
+    if (swt_avg.info.N_sweeps >= swt_avg_N) {
+        send_average();
+    }
+}
+
+
+static void close_record() {
+    uint16_t means[SWT_MAX_STEPS * 2];
+    SWT_record_info_t* info = &swt_rec.info;
+
+    for (uint16_t step = 0; step < info->N_steps; step++) {
+        uint16_t n = swt_rec.N_samples[step];
+        if (n == 0) {
+            means[step * 2] = 0;
+            means[step * 2 + 1] = 0;
+            continue;
+        }
+        if (info->samples_per_step != 0 && n < info->samples_per_step) {
+            info->status |= SWT_STATUS_SHORT_STEPS;
+        }
+        means[step * 2] = (swt_rec.sum[step][0] + n / 2) / n;
+        means[step * 2 + 1] = (swt_rec.sum[step][1] + n / 2) / n;
+    }
+    bool missing = count_missing_steps(info) > 0;
+    if (missing) {
+        info->status |= SWT_STATUS_MISSING_STEPS;
+    }
+
+    // Every sweep is kept on the SD card, averaging only reduces the downlink.
+    save_SWT_record(build_record(info, means, NULL));
+
+    if (swt_avg_N > 1) {
+        accumulate_sweep(info, means);
+    } else {
+        downlink_SWT_record(info, means, NULL);
+    }
+
+    SC_stats.sweeps_out++;
+    if (missing || (info->status & SWT_STATUS_SHORT_STEPS)) {
+        SC_stats.sweeps_incomplete++;
+    }
+    swt_rec.active = false;
+}
+
+
+// Sample of a sweep frame. value holds probe 0 and probe 1.
+void SWT_add_sample(uint16_t sweep_cnt, uint8_t step_ID, uint16_t* value) {
+    if (swt_rec.active && sweep_cnt != swt_rec.info.sweep_cnt) {
+        close_record();
+    }
+    if (!swt_rec.active) {
+        start_record(sweep_cnt);
+    }
+    swt_rec.last_sample_tick = xTaskGetTickCount();
+
+    if (step_ID >= swt_rec.info.N_steps) {
+        swt_rec.info.status |= SWT_STATUS_OUT_OF_RANGE;
+        return;
+    }
+    swt_rec.info.step_bitmap[step_ID >> 5] |= 1UL << (step_ID & 0x1F);
+    swt_rec.sum[step_ID][0] += value[0];
+    swt_rec.sum[step_ID][1] += value[1];
+    if (swt_rec.N_samples[step_ID] < UINT16_MAX) {
+        swt_rec.N_samples[step_ID]++;
+    }
+
+    if (swt_rec.info.samples_per_step != 0 && swt_rec.N_samples[step_ID] == swt_rec.info.samples_per_step) {
+        swt_rec.steps_complete++;
+        if (swt_rec.steps_complete == swt_rec.info.N_steps) {
+            close_record();
+        }
+    }
+}
+
+
+// Called from the main loop, closes a sweep that stopped receiving samples.
+void SWT_process(uint32_t current_ticks) {
+    if (swt_rec.active && (current_ticks - swt_rec.last_sample_tick) >= SWT_RECORD_TIMEOUT) {
+        swt_rec.info.status |= SWT_STATUS_TIMEOUT;
+        close_record();
+    }
+}
+
+
+// Closes the sweep in progress and downlinks a partial average.
+void SWT_flush() {
+    if (swt_rec.active) {
+        close_record();
+    }
+    send_average();
+}
+
+
+/*  Sweeps averaged per downlinked curve (N_AVG_SWEEPS_ARG_ID, 1 downlinks every sweep) and
+ *  whether the standard deviation of every step over those sweeps is included (SIGMA_ARG_ID).
+ */
+SPP_error set_SWT_averaging(uint8_t N_args, uint8_t* data) {
+    uint8_t N_sweeps = swt_avg_N;
+    uint8_t sigma = swt_avg_sigma;
+
+    for (int i = 0; i < N_args; i++) {
+        uint8_t arg_ID = *data++;
+        switch (arg_ID) {
+            case N_AVG_SWEEPS_ARG_ID:
+                N_sweeps = *data++;
+                break;
+            case SIGMA_ARG_ID:
+                sigma = *data++;
+                break;
+            default:
+                data += FPGA_arg_width(arg_ID);
+                break;
+        }
+    }
+    if (N_sweeps == 0) {
+        return SPP_PUS8_ERROR;
+    }
+
+    // Average in progress is sent with the old settings.
+    send_average();
+    swt_avg_N = N_sweeps;
+    swt_avg_sigma = (sigma != 0);
+    return SPP_OK;
+}
@@ -0,0 +1,198 @@
+/*
+ * sweep_profile.c
+ *
+ *  Created on: 2026. gada 18. okt.
+ */
+
+#include "sweep_profile.h"
+#include "sweep_data.h"
+#include <math.h>
+
+#define NO_TABLE_ID     0xFF
+
+
+// Linear interpolation between two points, rounded to the nearest voltage level.
+static uint16_t interpolate(uint16_t from, uint16_t to, uint16_t pos, uint16_t len) {
+    if (len == 0) {
+        return from;
+    }
+    int32_t diff = (int32_t) to - (int32_t) from;
+    int32_t num = diff * pos;
+    int32_t half = (num >= 0) ? (len / 2) : -(int32_t)(len / 2);
+    return (uint16_t)((int32_t) from + (num + half) / (int32_t) len);
+}
+
+
+static void generate_linear(Sweep_profile_t* profile, uint16_t* out_table) {
+    uint16_t last = profile->N_steps - 1;
+    for (uint16_t i = 0; i < profile->N_steps; i++) {
+        out_table[i] = interpolate(profile->start_voltage, profile->stop_voltage, i, last);
+    }
+}
+
+
+// Distance from the start level grows as (range + 1)^(i / (N - 1)) - 1, so the steps
+// are dense close to the start level and sparse towards the stop level.
+static void generate_log(Sweep_profile_t* profile, uint16_t* out_table) {
+    int32_t range = (int32_t) profile->stop_voltage - (int32_t) profile->start_voltage;
+    float   log_range = logf((float) abs(range) + 1.0f);
+    float   last = (float)(profile->N_steps - 1);
+
+    for (uint16_t i = 0; i < profile->N_steps; i++) {
+        float distance = (last > 0.0f) ? (expf(log_range * ((float) i / last)) - 1.0f) : 0.0f;
+        int32_t offset = (int32_t) lroundf(distance);
+        out_table[i] = (uint16_t)((int32_t) profile->start_voltage + ((range >= 0) ? offset : -offset));
+    }
+}
+
+
+// Needs at least 3 steps, with fewer the stop level or the return to start is never reached.
+static SPP_error generate_triangle(Sweep_profile_t* profile, uint16_t* out_table) {
+    if (profile->N_steps < 3) {
+        return SPP_PUS8_ERROR;
+    }
+    uint16_t up_steps = (profile->N_steps + 1) / 2;
+    uint16_t down_steps = profile->N_steps - up_steps;
+
+    for (uint16_t i = 0; i < up_steps; i++) {
+        out_table[i] = interpolate(profile->start_voltage, profile->stop_voltage, i, up_steps - 1);
+    }
+    for (uint16_t i = 0; i < down_steps; i++) {
+        out_table[up_steps + i] = interpolate(profile->stop_voltage, profile->start_voltage, i + 1, down_steps);
+    }
+    return SPP_OK;
+}
+
+
+// Breakpoints are expected in ascending step order. Steps before the first and after the
+// last breakpoint hold the voltage of that breakpoint.
+static SPP_error generate_custom(Sweep_profile_t* profile, uint16_t* out_table) {
+    Sweep_breakpoint_t* bp = profile->breakpoints;
+    uint8_t N_bp = profile->N_breakpoints;
+
+    if (N_bp == 0) {
+        return SPP_PUS8_ERROR;
+    }
+    for (uint8_t i = 1; i < N_bp; i++) {
+        if (bp[i].step_ID <= bp[i - 1].step_ID) {
+            return SPP_PUS8_ERROR;
+        }
+    }
+
+    uint8_t seg = 0;
+    for (uint16_t i = 0; i < profile->N_steps; i++) {
+        while (seg < N_bp - 1 && i >= bp[seg + 1].step_ID) {
+            seg++;
+        }
+        if (i <= bp[0].step_ID) {
+            out_table[i] = bp[0].voltage_level;
+        } else if (seg == N_bp - 1) {
+            out_table[i] = bp[N_bp - 1].voltage_level;
+        } else {
+            out_table[i] = interpolate(bp[seg].voltage_level, bp[seg + 1].voltage_level,
+                                       i - bp[seg].step_ID, bp[seg + 1].step_ID - bp[seg].step_ID);
+        }
+    }
+    return SPP_OK;
+}
+
+
+SPP_error generate_sweep_profile(Sweep_profile_t* profile, uint16_t* out_table) {
+    if (profile->N_steps == 0 || profile->N_steps > SWEEP_TABLE_LEN) {
+        return SPP_PUS8_ERROR;
+    }
+
+    switch (profile->shape) {
+        case SWEEP_SHAPE_LINEAR:
+            generate_linear(profile, out_table);
+            break;
+        case SWEEP_SHAPE_LOG:
+            generate_log(profile, out_table);
+            break;
+        case SWEEP_SHAPE_TRIANGLE:
+            return generate_triangle(profile, out_table);
+        case SWEEP_SHAPE_CUSTOM:
+            return generate_custom(profile, out_table);
+        default:
+            return SPP_PUS8_ERROR;
+    }
+    return SPP_OK;
+}
+
+
+/*  Generates a sweep table on board from a compact profile description and writes it to
+ *  a FRAM sweep table (FRAM_TABLE_ID_ARG_ID) and/or an FPGA sweep table (PROBE_ID_ARG_ID).
+ *  N_STEPS_ARG_ID is the number of steps to generate, 0 meaning the full 256 step table.
+ */
+SPP_error generate_sweep_table(uint8_t N_args, uint8_t* data) {
+    Sweep_profile_t profile = {
+        .shape          = SWEEP_SHAPE_LINEAR,
+        .start_voltage  = 0x0000,
+        .stop_voltage   = 0x0000,
+        .N_steps        = SWEEP_TABLE_LEN,
+        .N_breakpoints  = 0,
+    };
+    uint8_t FPGA_table_id = NO_TABLE_ID;
+    uint8_t FRAM_table_id = NO_TABLE_ID;
+
+    for (int i = 0; i < N_args; i++) {
+        uint8_t arg_ID = *data++;
+        switch (arg_ID) {
+            case PROBE_ID_ARG_ID:
+                FPGA_table_id = *data++;
+                break;
+            case FRAM_TABLE_ID_ARG_ID:
+                FRAM_table_id = *data++;
+                break;
+            case SWEEP_SHAPE_ARG_ID:
+                profile.shape = *data++;
+                break;
+            case N_STEPS_ARG_ID:
+                profile.N_steps = (*data == 0) ? SWEEP_TABLE_LEN : *data;
+                data++;
+                break;
+            case START_VOL_LVL_ARG_ID:
+                memcpy((uint8_t*)&profile.start_voltage, data, sizeof(profile.start_voltage));
+                data += sizeof(profile.start_voltage);
+                break;
+            case STOP_VOL_LVL_ARG_ID:
+                memcpy((uint8_t*)&profile.stop_voltage, data, sizeof(profile.stop_voltage));
+                data += sizeof(profile.stop_voltage);
+                break;
+            case BREAKPOINT_ARG_ID:
+                if (profile.N_breakpoints >= SWEEP_MAX_BREAKPOINTS) {
+                    return SPP_PUS8_ERROR;
+                }
+                Sweep_breakpoint_t* bp = &profile.breakpoints[profile.N_breakpoints++];
+                bp->step_ID = *data++;
+                memcpy((uint8_t*)&bp->voltage_level, data, sizeof(bp->voltage_level));
+                data += sizeof(bp->voltage_level);
+                break;
+            default:
+                data += FPGA_arg_width(arg_ID);
+                break;
+        }
+    }
+
+    if (FPGA_table_id == NO_TABLE_ID && FRAM_table_id == NO_TABLE_ID) {
+        return SPP_PUS8_ERROR;
+    }
+
+    uint16_t table[SWEEP_TABLE_LEN];
+    SPP_error err = generate_sweep_profile(&profile, table);
+    if (err != SPP_OK) {
+        return err;
+    }
+
+    if (FRAM_table_id != NO_TABLE_ID) {
+        err = save_sweep_table_FRAM(FRAM_table_id, table, profile.N_steps);
+        if (err != SPP_OK) {
+            return err;
+        }
+    }
+    if (FPGA_table_id != NO_TABLE_ID) {
+        write_sweep_table_FPGA(FPGA_table_id, table, profile.N_steps);
+        SWT_set_table_ID(FPGA_table_id, FRAM_table_id);
+    }
+    return SPP_OK;
+}
@@ -0,0 +1,23 @@
+/*
+ * FPGA_UART.h
+ *
+ *  Host stand-in, only what the SD writer uses from the FPGA UART.
+ */
+
+#ifndef FPGA_UART_H_HOST_
+#define FPGA_UART_H_HOST_
+
+#include "main.h"
+#include "cmsis_os.h"
+#include "uC_Data_Saving.h"
+#include "sd_stats.h"
+#include "storage_manager.h"
+#include <fatfs.h>
+
+#define FPGA_MESSAGE_FLOW_CONTROL   0x58
+
+extern uint8_t console_enabled;
+
+HAL_StatusTypeDef FPGA_Transmit_Binary(uint8_t* tx_data, size_t length);
+
+#endif /* FPGA_UART_H_HOST_ */
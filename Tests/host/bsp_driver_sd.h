@@ -0,0 +1,17 @@
+/*
+ * bsp_driver_sd.h
+ *
+ *  Host stand-in, the card is the RAM disk of host_disk.c.
+ */
+
+#ifndef BSP_DRIVER_SD_H_HOST_
+#define BSP_DRIVER_SD_H_HOST_
+
+#include <stdint.h>
+
+#define MSD_OK                      0
+#define MSD_ERROR                   1
+
+uint8_t BSP_SD_Init(void);
+
+#endif /* BSP_DRIVER_SD_H_HOST_ */
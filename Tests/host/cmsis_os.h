@@ -0,0 +1,15 @@
+/*
+ * cmsis_os.h
+ *
+ *  Host stand-in, the FatFs sync object type and the tick counter.
+ */
+
+#ifndef CMSIS_OS_H_HOST_
+#define CMSIS_OS_H_HOST_
+
+#include <stdint.h>
+
+typedef void* osSemaphoreId;
+uint32_t xTaskGetTickCount(void);
+
+#endif /* CMSIS_OS_H_HOST_ */
@@ -0,0 +1,2 @@
+/* Host stand-in, disk_*() are implemented directly by host_disk.c. */
+#include "diskio.h"
@@ -0,0 +1,115 @@
+/*
+ * host_disk.c
+ *
+ *  RAM disk behind FatFs for the host tests, with injectable card failures.
+ */
+
+#include "host_disk.h"
+#include "bsp_driver_sd.h"
+#include "cmsis_os.h"
+#include "diskio.h"
+#include "fatfs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int host_card_down = 0;
+int host_failing_writes = 0;
+
+char SDPath[4] = "0:/";
+FATFS SDFatFS;
+
+static uint8_t* disk = NULL;
+
+
+void host_disk_format_and_mount() {
+    static BYTE work[4096];
+
+    if (disk == NULL) {
+        disk = calloc(HOST_DISK_SECTORS, 512);
+    }
+    if (f_mkfs("", FM_FAT32, 0, work, sizeof(work)) != FR_OK || f_mount(&SDFatFS, SDPath, 1) != FR_OK) {
+        fprintf(stderr, "Cannot format the RAM disk\n");
+        exit(1);
+    }
+}
+
+
+uint8_t BSP_SD_Init(void) {
+    return host_card_down ? MSD_ERROR : MSD_OK;
+}
+
+
+DSTATUS disk_initialize(BYTE pdrv) {
+    return 0;
+}
+
+
+DSTATUS disk_status(BYTE pdrv) {
+    return 0;
+}
+
+
+DRESULT disk_read(BYTE pdrv, BYTE* buff, DWORD sector, UINT count) {
+    if (host_card_down) {
+        return RES_ERROR;
+    }
+    memcpy(buff, disk + (size_t) sector * 512, (size_t) count * 512);
+    return RES_OK;
+}
+
+
+DRESULT disk_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count) {
+    if (host_card_down) {
+        return RES_ERROR;
+    }
+    if (host_failing_writes > 0) {
+        host_failing_writes--;
+        return RES_ERROR;
+    }
+    memcpy(disk + (size_t) sector * 512, buff, (size_t) count * 512);
+    return RES_OK;
+}
+
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void* buff) {
+    switch (cmd) {
+        case GET_SECTOR_COUNT:
+            *(DWORD*) buff = HOST_DISK_SECTORS;
+            break;
+        case GET_SECTOR_SIZE:
+            *(WORD*) buff = 512;
+            break;
+        case GET_BLOCK_SIZE:
+            *(DWORD*) buff = 1;
+            break;
+        default:
+            break;
+    }
+    return RES_OK;
+}
+
+
+DWORD get_fattime(void) {
+    return 0;
+}
+
+
+// Single task, the volume needs no locking
+int ff_cre_syncobj(BYTE vol, osSemaphoreId* sobj) {
+    return 1;
+}
+
+
+int ff_del_syncobj(osSemaphoreId sobj) {
+    return 1;
+}
+
+
+int ff_req_grant(osSemaphoreId sobj) {
+    return 1;
+}
+
+
+void ff_rel_grant(osSemaphoreId sobj) {
+}
@@ -0,0 +1,19 @@
+/*
+ * host_disk.h
+ *
+ *  RAM disk behind FatFs for the host tests, with injectable card failures.
+ */
+
+#ifndef HOST_DISK_H_
+#define HOST_DISK_H_
+
+#include <stdint.h>
+
+#define HOST_DISK_SECTORS           (64UL * 1024 * 1024 / 512)
+
+extern int host_card_down;          // Every access fails and the card does not initialise
+extern int host_failing_writes;     // Number of following writes that fail on an answering card
+
+void host_disk_format_and_mount();
+
+#endif /* HOST_DISK_H_ */
@@ -0,0 +1,55 @@
+/*
+ * host_hal.c
+ *
+ *  Host stand-ins for the HAL, RTOS and board globals used by the modules under test.
+ */
+
+#include "main.h"
+#include "cmsis_os.h"
+#include <stdint.h>
+#include <string.h>
+
+uint32_t host_ticks = 0;
+DWT_Type host_DWT = {0};
+uint32_t SystemCoreClock = 216000000;
+SRAM_HandleTypeDef hsram1;
+
+uint8_t ffuID = 1;
+uint8_t unitID = 0x1A;
+
+static uint8_t FRAM[0x2000];
+
+
+uint32_t xTaskGetTickCount(void) {
+    return host_ticks;
+}
+
+
+uint64_t OBT_get_us() {
+    return (uint64_t) host_ticks * 1000;
+}
+
+
+HAL_StatusTypeDef HAL_SRAM_Read_DMA(SRAM_HandleTypeDef* hsram, uint32_t* addr, uint32_t* dst, uint32_t len) {
+    return HAL_OK;
+}
+
+
+void DCache_clean(const void* addr, uint32_t len) {
+}
+
+
+void DCache_invalidate(void* addr, uint32_t len) {
+}
+
+
+HAL_StatusTypeDef readFRAM(uint16_t addr, uint8_t* buf, uint32_t size) {
+    memcpy(buf, FRAM + addr, size);
+    return HAL_OK;
+}
+
+
+HAL_StatusTypeDef writeFRAM(uint16_t addr, uint8_t* data, uint32_t size) {
+    memcpy(FRAM + addr, data, size);
+    return HAL_OK;
+}
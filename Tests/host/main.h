@@ -0,0 +1,51 @@
+/*
+ * main.h
+ *
+ *  Host stand-in for Inc/main.h, just enough of the HAL for the modules under test.
+ */
+
+#ifndef MAIN_H_HOST_
+#define MAIN_H_HOST_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+typedef int HAL_StatusTypeDef;
+#define HAL_OK                      0
+#define HAL_ERROR                   1
+
+typedef struct { int unused; } SRAM_HandleTypeDef;
+typedef struct { int unused; } UART_HandleTypeDef;
+typedef struct { int unused; } I2C_HandleTypeDef;
+
+#define __ALIGNED(x)                __attribute__((aligned(x)))
+#define __DMB()                     __sync_synchronize()
+
+typedef struct { volatile uint32_t CYCCNT; } DWT_Type;
+extern DWT_Type host_DWT;
+#define DWT                         (&host_DWT)
+extern uint32_t SystemCoreClock;
+
+#define LED3_GPIO_Port              0
+#define LED4_GPIO_Port              0
+#define LED3_Pin                    0
+#define LED4_Pin                    0
+#define GPIO_PIN_SET                1
+#define GPIO_PIN_RESET              0
+#define HAL_GPIO_WritePin(port, pin, state) ((void) 0)
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+// CMSIS dual 16-bit multiply accumulate, for building the DSP code paths on the host
+static inline uint32_t __SMLAD(uint32_t x, uint32_t y, uint32_t acc) {
+    return acc + (int32_t) (int16_t) x * (int16_t) y + (int32_t) (int16_t) (x >> 16) * (int16_t) (y >> 16);
+}
+#endif
+
+HAL_StatusTypeDef HAL_SRAM_Read_DMA(SRAM_HandleTypeDef* hsram, uint32_t* addr, uint32_t* dst, uint32_t len);
+void DCache_clean(const void* addr, uint32_t len);
+void DCache_invalidate(void* addr, uint32_t len);
+
+#endif /* MAIN_H_HOST_ */
@@ -0,0 +1 @@
+/* Host stand-in, everything comes from cmsis_os.h and main.h. */
@@ -0,0 +1,118 @@
+/*
+ * iv_reference.c
+ *
+ *  Double precision reference of the on-board I-V curve analysis. Follows the steps of
+ *  Src/IV_analysis.c, with centred two-pass line fits so that its own rounding error is
+ *  negligible next to the single precision flight code.
+ */
+
+#include "iv_reference.h"
+#include "IV_analysis.h"
+#include <math.h>
+
+#define ELEMENTARY_CHARGE   1.602176634e-19
+#define ION_MASS_KG         (16.0 * 1.66053907e-27)
+
+
+// Least squares line through points first..last-1 that pass the filter, false below IV_MIN_FIT_POINTS.
+static int fit_line(const double* x, const double* y, const uint8_t* use, int first, int last,
+                    double* slope, double* intercept) {
+    double mx = 0, my = 0, sxx = 0, sxy = 0;
+    int n = 0;
+
+    for (int i = first; i < last; i++) {
+        if (use[i]) {
+            mx += x[i];
+            my += y[i];
+            n++;
+        }
+    }
+    if (n < IV_MIN_FIT_POINTS) {
+        return 0;
+    }
+    mx /= n;
+    my /= n;
+    for (int i = first; i < last; i++) {
+        if (use[i]) {
+            sxx += (x[i] - mx) * (x[i] - mx);
+            sxy += (x[i] - mx) * (y[i] - my);
+        }
+    }
+    if (sxx == 0) {
+        return 0;
+    }
+    *slope = sxy / sxx;
+    *intercept = my - *slope * mx;
+    return 1;
+}
+
+
+uint8_t IV_reference_analyze(const uint16_t* bias, const uint16_t* current, uint16_t N, IV_reference_t* result) {
+    double  V[IV_MAX_POINTS], I[IV_MAX_POINTS], y[IV_MAX_POINTS];
+    uint8_t use[IV_MAX_POINTS];
+
+    *result = (IV_reference_t) {0};
+    if (N > IV_MAX_POINTS) {
+        N = IV_MAX_POINTS;
+    }
+    for (int i = 0; i < N; i++) {
+        V[i] = ((int32_t) bias[i] - IV_DEFAULT_BIAS_OFFSET_LSB) * (double) IV_DEFAULT_BIAS_V_PER_LSB;
+        I[i] = ((int32_t) current[i] - IV_DEFAULT_CURRENT_OFFSET_LSB) * (double) IV_DEFAULT_CURRENT_A_PER_LSB;
+    }
+
+    int vf_idx = -1;
+    for (int i = 1; i < N && vf_idx < 0; i++) {
+        if (I[i - 1] < 0 && I[i] >= 0) {
+            result->V_f = V[i - 1] + (-I[i - 1] / (I[i] - I[i - 1])) * (V[i] - V[i - 1]);
+            vf_idx = i;
+        }
+    }
+    if (vf_idx < 0) {
+        result->status = IV_STATUS_NO_VF | IV_STATUS_NO_ION_FIT | IV_STATUS_NO_TE | IV_STATUS_NO_NE;
+        return result->status;
+    }
+
+    double V_ion_limit = V[0] + (V[N - 1] - V[0]) * (double) IV_ION_FIT_FRACTION;
+    double ion_slope = 0, ion_intercept = 0;
+    int ion_end = 0;
+    while (ion_end < vf_idx && V[ion_end] <= V_ion_limit) {
+        use[ion_end++] = 1;
+    }
+    if (fit_line(V, I, use, 0, ion_end, &ion_slope, &ion_intercept)) {
+        result->I_is = ion_slope * result->V_f + ion_intercept;
+    } else {
+        ion_slope = ion_intercept = 0;
+        result->status |= IV_STATUS_NO_ION_FIT;
+    }
+
+    int vp_idx = vf_idx;
+    double max_didv = 0;
+    for (int i = vf_idx; i < N - 1; i++) {
+        double dV = V[i + 1] - V[i];
+        if (dV > 0 && (I[i + 1] - I[i]) / dV > max_didv) {
+            max_didv = (I[i + 1] - I[i]) / dV;
+            vp_idx = i + 1;
+        }
+    }
+    result->V_p = V[vp_idx];
+
+    for (int i = vf_idx; i < vp_idx; i++) {
+        double I_e = I[i] - (ion_slope * V[i] + ion_intercept);
+        use[i] = (I_e > 0);
+        y[i] = use[i] ? log(I_e) : 0;
+    }
+    double te_slope, te_intercept;
+    if (fit_line(V, y, use, vf_idx, vp_idx, &te_slope, &te_intercept) && te_slope > 0) {
+        result->T_e = 1 / te_slope;
+    } else {
+        result->status |= IV_STATUS_NO_TE;
+    }
+
+    if (!(result->status & (IV_STATUS_NO_TE | IV_STATUS_NO_ION_FIT)) && result->I_is < 0) {
+        double v_bohm = sqrt(ELEMENTARY_CHARGE * result->T_e / ION_MASS_KG);
+        result->n_e = -result->I_is / (0.61 * ELEMENTARY_CHARGE * (double) IV_DEFAULT_PROBE_AREA_M2 * v_bohm);
+    } else {
+        result->status |= IV_STATUS_NO_NE;
+    }
+    return result->status;
+}
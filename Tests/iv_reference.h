@@ -0,0 +1,24 @@
+/*
+ * iv_reference.h
+ *
+ *  Double precision reference of the on-board I-V curve analysis, for the host tests and for
+ *  checking flight results on ground.
+ */
+
+#ifndef IV_REFERENCE_H_
+#define IV_REFERENCE_H_
+
+#include <stdint.h>
+
+typedef struct {
+    double  V_f;
+    double  V_p;
+    double  I_is;
+    double  T_e;
+    double  n_e;
+    uint8_t status;         // Same flags as IV_result_t
+} IV_reference_t;
+
+uint8_t IV_reference_analyze(const uint16_t* bias, const uint16_t* current, uint16_t N, IV_reference_t* result);
+
+#endif /* IV_REFERENCE_H_ */
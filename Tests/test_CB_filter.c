@@ -0,0 +1,168 @@
+/*
+ * test_CB_filter.c
+ *
+ *  Checks the CB mode FIR against a plain scalar FIR on a ring buffer, sample for sample, and
+ *  times both. Built once as is and once with the dual 16-bit MAC path of FIR_dot enabled.
+ *  Also checks that set_CB_filter rejects tap sets that could overflow the Q30 accumulator.
+ */
+
+#include "CB_filter.h"
+#include "langmuir_probe_bias.h"
+#include <time.h>
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+#define N_SAMPLES       200000
+
+static int failures = 0;
+
+
+uint8_t FPGA_arg_width(uint8_t arg_ID) {
+    return 1;
+}
+
+
+// Builds and applies a FILTER_MODE / DECIMATION / FIR_TAP argument list
+static SPP_error configure(uint8_t mode, uint8_t decimation, const int16_t* taps, uint8_t N_taps) {
+    uint8_t args[4 + 3 * CB_FILTER_MAX_TAPS + 3];
+    uint8_t* p = args;
+
+    *p++ = FILTER_MODE_ARG_ID;
+    *p++ = mode;
+    *p++ = DECIMATION_ARG_ID;
+    *p++ = decimation;
+    for (uint8_t i = 0; i < N_taps; i++) {
+        *p++ = FIR_TAP_ARG_ID;
+        memcpy(p, &taps[i], sizeof(int16_t));
+        p += sizeof(int16_t);
+    }
+    return set_CB_filter(2 + N_taps, args);
+}
+
+
+/*  Scalar reference: ring buffer indexed modulo the tap count, one multiply per tap, same
+ *  rounding and saturation as the Q30 to offset binary conversion in CB_filter.c.
+ */
+typedef struct {
+    int16_t  history[CB_FILTER_N_CHANNELS][CB_FILTER_MAX_TAPS];
+    uint8_t  pos;
+    uint8_t  fill;
+    uint8_t  decim_count;
+} scalar_FIR_t;
+
+static bool scalar_FIR_push(scalar_FIR_t* f, const int16_t* taps, uint8_t N_taps, uint8_t decimation,
+                            const CB_sample_t* in, CB_sample_t* out) {
+    for (uint8_t ch = 0; ch < CB_FILTER_N_CHANNELS; ch++) {
+        f->history[ch][f->pos] = (int16_t) (in->value[ch] ^ 0x8000);
+    }
+    f->pos = (f->pos + 1) % N_taps;
+    if (f->fill < N_taps) {
+        f->fill++;
+    }
+    if (++f->decim_count < decimation || f->fill < N_taps) {
+        return false;
+    }
+    f->decim_count = 0;
+
+    out->seq = in->seq;
+    for (uint8_t ch = 0; ch < CB_FILTER_N_CHANNELS; ch++) {
+        int64_t acc = 0;
+        for (uint8_t k = 0; k < N_taps; k++) {
+            // taps[k] applies to the sample k steps before the newest one
+            acc += (int32_t) taps[k] * f->history[ch][(f->pos + N_taps - 1 - k) % N_taps];
+        }
+        acc = (acc + (1 << 14)) >> 15;
+        acc = acc > INT16_MAX ? INT16_MAX : (acc < INT16_MIN ? INT16_MIN : acc);
+        out->value[ch] = (uint16_t) ((int16_t) acc ^ 0x8000);
+    }
+    return true;
+}
+
+
+static CB_sample_t input[N_SAMPLES];
+
+
+// Runs both filters over the input, returns the number of mismatching outputs
+static int compare(const char* name, const int16_t* taps, uint8_t N_taps, uint8_t decimation) {
+    static scalar_FIR_t ref;
+    CB_sample_t out, ref_out;
+    int mismatches = 0;
+    uint32_t outputs = 0;
+
+    CHECK(configure(CB_FILTER_FIR, decimation, taps, N_taps) == SPP_OK);
+    memset(&ref, 0, sizeof(ref));
+
+    // The padding tap of an odd tap count is zero, the reference runs on the padded set as well
+    int16_t padded[CB_FILTER_MAX_TAPS] = {0};
+    memcpy(padded, taps, N_taps * sizeof(int16_t));
+    uint8_t N_padded = N_taps + (N_taps & 0x01);
+
+    clock_t start = clock();
+    for (uint32_t i = 0; i < N_SAMPLES; i++) {
+        outputs += CB_filter_push(&input[i], &out);
+    }
+    clock_t filter_time = clock() - start;
+
+    start = clock();
+    for (uint32_t i = 0; i < N_SAMPLES; i++) {
+        outputs -= scalar_FIR_push(&ref, padded, N_padded, decimation, &input[i], &ref_out);
+    }
+    clock_t scalar_time = clock() - start;
+    CHECK(outputs == 0);
+
+    // Second pass comparing every output
+    CB_filter_reset();
+    memset(&ref, 0, sizeof(ref));
+    for (uint32_t i = 0; i < N_SAMPLES; i++) {
+        bool ready = CB_filter_push(&input[i], &out);
+        bool ref_ready = scalar_FIR_push(&ref, padded, N_padded, decimation, &input[i], &ref_out);
+        if (ready != ref_ready || (ready && memcmp(&out, &ref_out, sizeof(out)) != 0)) {
+            mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+
+    printf("  %-22s %2u taps R=%-2u  CB_filter %6.1f ns/sample, scalar %6.1f ns/sample\n", name, N_taps,
+           decimation, 1e9 * filter_time / CLOCKS_PER_SEC / N_SAMPLES, 1e9 * scalar_time / CLOCKS_PER_SEC / N_SAMPLES);
+    return mismatches;
+}
+
+
+int main() {
+    srand(35);
+    for (uint32_t i = 0; i < N_SAMPLES; i++) {
+        input[i].seq = (uint16_t) i;
+        input[i].value[0] = (uint16_t) rand();
+        input[i].value[1] = (i & 0x40) ? 0xFFFF : 0x0000;
+    }
+
+    static const int16_t lowpass[16] = { 512, 1024, 1536, 2048, 2560, 3072, 3072, 2560,
+                                         2048, 1536, 1024, 512, 256, 128, 64, 64 };
+    static const int16_t odd[5] = { 8192, -4096, 16384, -4096, 8192 };
+    // Sum of |taps| just below 2.0, the full scale steps saturate the output
+    static const int16_t max_gain[4] = { 32767, -32767, 1, 0 };
+
+    compare("low pass", lowpass, 16, 1);
+    compare("low pass decimated", lowpass, 16, 7);
+    compare("odd tap count", odd, 5, 3);
+    compare("maximum gain", max_gain, 4, 1);
+
+    // Tap sets that could overflow the accumulator are refused
+    static const int16_t just_below[2] = { 32767, -32767 + 1 };
+    static const int16_t too_much[3] = { INT16_MIN, 16384, 16384 };
+    static const int16_t many[16] = { [0 ... 15] = 8192 };
+    CHECK(configure(CB_FILTER_FIR, 1, just_below, 2) == SPP_OK);
+    CHECK(configure(CB_FILTER_FIR, 1, too_much, 3) == SPP_PUS8_ERROR);
+    CHECK(configure(CB_FILTER_FIR, 1, many, 16) == SPP_PUS8_ERROR);
+    CHECK(configure(CB_FILTER_FIR, 1, many, 7) == SPP_OK);
+    CHECK(configure(CB_FILTER_FIR, 1, many, 8) == SPP_PUS8_ERROR);
+
+    printf("test_CB_filter%s: %s\n",
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+           " (dual MAC)",
+#else
+           "",
+#endif
+           failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
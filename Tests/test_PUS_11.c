@@ -0,0 +1,196 @@
+/*
+ * test_PUS_11.c
+ *
+ *  Drives the PUS 11 TC handler with a stubbed on-board time. Checks that time shifts which
+ *  would put an activity at or before now are refused as a whole, and that N entries and
+ *  nested TC lengths are bound to the data length of the enclosing TC.
+ */
+
+#include "Space_Packet_Protocol.h"
+#include "FRAM.h"
+#include "on_board_time.h"
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+#define NOW_MS          10000
+#define TC_LEN          SPP_PUS_TC_MIN_LEN
+
+static int failures = 0;
+static uint8_t summary[256];
+
+DeviceState Current_Global_Device_State = NORMAL_MODE;
+
+
+uint64_t OBT_get_us()                                                           { return (uint64_t) NOW_MS * 1000; }
+HAL_StatusTypeDef writeFRAM(uint16_t addr, uint8_t* data, uint32_t size)        { return HAL_OK; }
+HAL_StatusTypeDef readFRAM(uint16_t addr, uint8_t* buf, uint32_t size)          { return HAL_ERROR; }
+SPP_error SPP_validate_checksum(uint8_t* packet, uint16_t packet_length)        { return SPP_OK; }
+SPP_error SPP_process_TC_packet(uint8_t* packet_buffer)                         { return SPP_OK; }
+void send_succ_acc(SPP_header_t* SPP_h, PUS_TC_header_t* PUS_h)                 {}
+void send_fail_acc(SPP_header_t* SPP_h, PUS_TC_header_t* PUS_h)                 {}
+void send_succ_comp(SPP_header_t* SPP_h, PUS_TC_header_t* PUS_h)                {}
+void send_fail_comp(SPP_header_t* SPP_h, PUS_TC_header_t* PUS_h)                {}
+
+SPP_error SPP_decode_header(uint8_t* raw_header, SPP_header_t* primary_header) {
+    primary_header->packet_type             = (raw_header[0] & 0x10) >> 4;
+    primary_header->secondary_header_flag   = (raw_header[0] & 0x08) >> 3;
+    primary_header->application_process_id  = ((raw_header[0] & 0x03) << 8) | raw_header[1];
+    primary_header->packet_sequence_count   = ((raw_header[2] & 0x3F) << 8) | raw_header[3];
+    primary_header->packet_data_length      = (raw_header[4] << 8) | raw_header[5];
+    return SPP_OK;
+}
+
+SPP_header_t SPP_make_header(uint8_t packet_version_number, uint8_t packet_type, uint8_t secondary_header_flag,
+                             uint16_t application_process_id, uint8_t sequence_flags, uint16_t packet_sequence_count,
+                             uint16_t packet_data_length) {
+    SPP_header_t header = {0};
+    return header;
+}
+
+PUS_TM_header_t PUS_make_TM_header(uint8_t PUS_version_number, uint8_t sc_time_ref_status, uint8_t service_type_id,
+                                   uint8_t message_subtype_id, uint16_t message_type_counter, uint16_t destination_id,
+                                   uint16_t time) {
+    PUS_TM_header_t header = {0};
+    return header;
+}
+
+// Only the 11,13 summary report is sent by these tests
+SPP_error SPP_send_TM(SPP_header_t* resp_SPP_header, PUS_TM_header_t* response_secondary_header, uint8_t* data, uint16_t data_len) {
+    memcpy(summary, data, data_len);
+    return SPP_OK;
+}
+
+
+// Sends a PUS 11 TC with the given application data
+static SPP_error send_TC(uint8_t subtype, uint8_t* data, uint16_t data_len) {
+    SPP_header_t SPP_header = {0};
+    SPP_header.packet_data_length = SPP_PUS_TC_HEADER_LEN_WO_SPARE + data_len + CRC_BYTE_LEN - 1;
+    PUS_TC_header_t PUS_header = {0};
+    PUS_header.service_type_id = TIME_BASED_SCHEDULING_ID;
+    PUS_header.message_subtype_id = subtype;
+    return SPP_handle_TBS_TC(&SPP_header, &PUS_header, data);
+}
+
+// Appends a release time and a minimal test service TC with the given sequence count
+static uint8_t* add_activity(uint8_t* p, uint32_t release_time, uint16_t seq_count) {
+    memcpy(p, &release_time, sizeof(release_time));
+    p += sizeof(release_time);
+    memset(p, 0, TC_LEN);
+    p[0] = 0x18;
+    p[3] = (uint8_t) seq_count;
+    p[5] = TC_LEN - SPP_PRIMARY_HEADER_LEN - 1;
+    p[SPP_PRIMARY_HEADER_LEN + 1] = TEST_SERVICE_ID;
+    return p + TC_LEN;
+}
+
+static uint8_t* add_ID(uint8_t* p, uint16_t seq_count) {
+    uint16_t APID = 0;
+    memcpy(p, &APID, sizeof(APID));
+    memcpy(p + 2, &seq_count, sizeof(seq_count));
+    return p + 4;
+}
+
+// Release time of the activity with the given sequence count from a summary report, 0 if not scheduled
+static uint32_t release_time_of(uint16_t seq_count) {
+    send_TC(TBS_SUMMARY_REPORT_ALL, NULL, 0);
+    for (uint8_t i = 0; i < summary[4]; i++) {
+        uint8_t* entry = summary + 5 + i * 8;
+        uint16_t seq;
+        memcpy(&seq, entry + 6, sizeof(seq));
+        if (seq == seq_count) {
+            uint32_t release_time;
+            memcpy(&release_time, entry, sizeof(release_time));
+            return release_time;
+        }
+    }
+    return 0;
+}
+
+
+int main() {
+    uint8_t data[256];
+    uint8_t* p;
+    int32_t offset;
+
+    SPP_init_TBS_schedule();
+
+    p = data;
+    *p++ = 2;
+    p = add_activity(p, NOW_MS + 1000, 1);
+    p = add_activity(p, NOW_MS + 2000, 2);
+    CHECK(send_TC(TBS_INSERT_ACTIVITIES, data, p - data) == SPP_OK);
+    CHECK(release_time_of(1) == NOW_MS + 1000);
+    CHECK(release_time_of(2) == NOW_MS + 2000);
+
+    // Activity 1 would land in the past, so activity 2 is not shifted either
+    p = data;
+    offset = -1500;
+    memcpy(p, &offset, sizeof(offset));
+    p += sizeof(offset);
+    *p++ = 2;
+    p = add_ID(p, 2);
+    p = add_ID(p, 1);
+    CHECK(send_TC(TBS_TIME_SHIFT_ACTIVITIES, data, p - data) == SPP_PUS11_ERROR);
+    CHECK(release_time_of(1) == NOW_MS + 1000);
+    CHECK(release_time_of(2) == NOW_MS + 2000);
+
+    // A shift that keeps every listed activity in the future applies once per activity
+    p = data;
+    offset = -500;
+    memcpy(p, &offset, sizeof(offset));
+    p += sizeof(offset);
+    *p++ = 2;
+    p = add_ID(p, 2);
+    p = add_ID(p, 2);
+    CHECK(send_TC(TBS_TIME_SHIFT_ACTIVITIES, data, p - data) == SPP_OK);
+    CHECK(release_time_of(2) == NOW_MS + 1500);
+
+    // Shifting everything onto now is refused, just short of it is accepted
+    offset = -1000;
+    memcpy(data, &offset, sizeof(offset));
+    CHECK(send_TC(TBS_TIME_SHIFT_ALL, data, sizeof(offset)) == SPP_PUS11_ERROR);
+    CHECK(release_time_of(1) == NOW_MS + 1000);
+    offset = -999;
+    memcpy(data, &offset, sizeof(offset));
+    CHECK(send_TC(TBS_TIME_SHIFT_ALL, data, sizeof(offset)) == SPP_OK);
+    CHECK(release_time_of(1) == NOW_MS + 1);
+    CHECK(release_time_of(2) == NOW_MS + 501);
+
+    // Time offset cut short
+    CHECK(send_TC(TBS_TIME_SHIFT_ALL, data, sizeof(offset) - 1) == SPP_PUS11_ERROR);
+    CHECK(release_time_of(1) == NOW_MS + 1);
+
+    // N larger than the entries in the packet
+    p = data;
+    offset = 1000;
+    memcpy(p, &offset, sizeof(offset));
+    p += sizeof(offset);
+    *p++ = 3;
+    p = add_ID(p, 1);
+    CHECK(send_TC(TBS_TIME_SHIFT_ACTIVITIES, data, p - data) == SPP_PUS11_ERROR);
+    CHECK(release_time_of(1) == NOW_MS + 1);
+
+    p = data;
+    *p++ = 2;
+    p = add_ID(p, 1);
+    CHECK(send_TC(TBS_DELETE_ACTIVITIES, data, p - data) == SPP_PUS11_ERROR);
+    CHECK(release_time_of(1) == NOW_MS + 1);
+
+    // Second activity of an insert is missing, then a nested TC cut short
+    p = data;
+    *p++ = 2;
+    p = add_activity(p, NOW_MS + 3000, 3);
+    p = add_activity(p, NOW_MS + 4000, 4);
+    CHECK(send_TC(TBS_INSERT_ACTIVITIES, data, 1 + sizeof(uint32_t) + TC_LEN) == SPP_PUS11_ERROR);
+    CHECK(release_time_of(3) == NOW_MS + 3000);
+    CHECK(release_time_of(4) == 0);
+
+    p = data;
+    *p++ = 1;
+    p = add_activity(p, NOW_MS + 4000, 4);
+    CHECK(send_TC(TBS_INSERT_ACTIVITIES, data, p - data - 1) == SPP_PUS11_ERROR);
+    CHECK(release_time_of(4) == 0);
+
+    printf("test_PUS_11: %s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
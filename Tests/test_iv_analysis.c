@@ -0,0 +1,131 @@
+/*
+ * test_iv_analysis.c
+ *
+ *  Runs the on-board I-V analysis on synthetic sweeps of known plasmas and checks it against
+ *  the plasma parameters and against the double precision reference in iv_reference.c.
+ */
+
+#include "IV_analysis.h"
+#include "iv_reference.h"
+#include <math.h>
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+#define N_POINTS            256
+#define ELECTRON_MASS_KG    9.1093837e-31
+#define E_CHARGE            1.602176634e-19
+#define O_ION_MASS_KG       (16.0 * 1.66053907e-27)
+
+static int failures = 0;
+
+
+SPP_header_t SPP_make_header(uint8_t packet_version_number, uint8_t packet_type, uint8_t secondary_header_flag,
+                             uint16_t application_process_id, uint8_t sequence_flags, uint16_t packet_sequence_count,
+                             uint16_t packet_data_length) {
+    SPP_header_t header = {0};
+    return header;
+}
+
+
+SPP_error SPP_send_TM(SPP_header_t* resp_SPP_header, PUS_TM_header_t* response_secondary_header, uint8_t* data, uint16_t data_len) {
+    return SPP_OK;
+}
+
+
+/*  Test vectors, plasmas with O+ ions as seen by the probe with the default calibration.
+ *  The sweep covers the whole bias range in N_POINTS steps of ~78 mV. V_f lies ~4.7 T_e below
+ *  V_p, and the vectors keep the ion fit region (up to -5 V) at least 4 T_e below V_f, where
+ *  the electron current no longer bends the ion saturation line.
+ */
+static const struct {
+    double n_e;     // m^-3
+    double T_e;     // eV
+    double V_p;     // V
+} vectors[] = {
+    { 5.0e10, 1.0,  4.0 },
+    { 1.0e11, 0.5,  0.0 },
+    { 2.0e10, 0.8,  3.0 },
+    { 1.0e11, 0.2, -1.0 },
+    { 2.0e11, 0.3,  1.5 },
+};
+
+
+static double ion_saturation(double n_e, double T_e) {
+    return 0.61 * E_CHARGE * n_e * IV_DEFAULT_PROBE_AREA_M2 * sqrt(E_CHARGE * T_e / O_ION_MASS_KG);
+}
+
+
+static double electron_saturation(double n_e, double T_e) {
+    return E_CHARGE * n_e * IV_DEFAULT_PROBE_AREA_M2 * sqrt(E_CHARGE * T_e / (2 * M_PI * ELECTRON_MASS_KG));
+}
+
+
+// Ideal probe: constant ion saturation current, Boltzmann electrons below V_p, saturated above.
+static void make_sweep(double n_e, double T_e, double V_p, uint16_t* bias, uint16_t* current) {
+    double I_is = ion_saturation(n_e, T_e);
+    double I_es = electron_saturation(n_e, T_e);
+
+    for (int i = 0; i < N_POINTS; i++) {
+        bias[i] = i * (65536 / N_POINTS);
+        double V = ((int32_t) bias[i] - IV_DEFAULT_BIAS_OFFSET_LSB) * (double) IV_DEFAULT_BIAS_V_PER_LSB;
+        double I = -I_is + (V < V_p ? I_es * exp((V - V_p) / T_e) : I_es);
+        double raw = round(I / IV_DEFAULT_CURRENT_A_PER_LSB) + IV_DEFAULT_CURRENT_OFFSET_LSB;
+        current[i] = raw < 0 ? 0 : (raw > 65535 ? 65535 : (uint16_t) raw);
+    }
+}
+
+
+static int close_to(double value, double expected, double rel_tol) {
+    return fabs(value - expected) <= rel_tol * fabs(expected);
+}
+
+
+int main() {
+    uint16_t bias[N_POINTS], current[N_POINTS];
+    IV_result_t    result;
+    IV_reference_t ref;
+    const double   step_V = (65536 / N_POINTS) * (double) IV_DEFAULT_BIAS_V_PER_LSB;
+
+    for (size_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++) {
+        double n_e = vectors[v].n_e, T_e = vectors[v].T_e, V_p = vectors[v].V_p;
+        double V_f = V_p + T_e * log(ion_saturation(n_e, T_e) / electron_saturation(n_e, T_e));
+
+        make_sweep(n_e, T_e, V_p, bias, current);
+        CHECK(analyze_IV_curve(bias, current, N_POINTS, &result) == 0);
+        CHECK(IV_reference_analyze(bias, current, N_POINTS, &ref) == 0);
+
+        // Against the plasma, limited by the bias step and the current quantisation
+        CHECK(fabs(result.V_f - V_f) < step_V);
+        CHECK(fabs(result.V_p - V_p) <= step_V);
+        CHECK(close_to(-result.I_is, ion_saturation(n_e, T_e), 0.05));
+        CHECK(close_to(result.T_e, T_e, 0.05));
+        CHECK(close_to(result.n_e, n_e, 0.10));
+
+        // Against the reference, limited by single precision
+        CHECK(fabs(result.V_f - ref.V_f) < 1.0e-3);
+        CHECK(result.V_p == (float) ref.V_p);
+        CHECK(close_to(result.I_is, ref.I_is, 1.0e-3));
+        CHECK(close_to(result.T_e, ref.T_e, 1.0e-3));
+        CHECK(close_to(result.n_e, ref.n_e, 1.0e-3));
+
+        printf("  n_e %.2e T_e %.2f V_p %+.2f: V_f %+.3f (%+.3f) T_e %.3f n_e %.3e\n",
+               n_e, T_e, V_p, result.V_f, V_f, result.T_e, result.n_e);
+    }
+
+    // No floating potential in the sweep, nothing can be derived
+    for (int i = 0; i < N_POINTS; i++) {
+        bias[i] = i * (65536 / N_POINTS);
+        current[i] = IV_DEFAULT_CURRENT_OFFSET_LSB - 100;
+    }
+    uint8_t all = IV_STATUS_NO_VF | IV_STATUS_NO_ION_FIT | IV_STATUS_NO_TE | IV_STATUS_NO_NE;
+    CHECK(analyze_IV_curve(bias, current, N_POINTS, &result) == all);
+    CHECK(IV_reference_analyze(bias, current, N_POINTS, &ref) == all);
+
+    // Floating potential below the ion fit region's end leaves too few points for the ion fit
+    make_sweep(1.0e11, 1.0, -9.0, bias, current);
+    CHECK(analyze_IV_curve(bias, current, N_POINTS, &result) & IV_STATUS_NO_ION_FIT);
+    CHECK(result.status == IV_reference_analyze(bias, current, N_POINTS, &ref));
+
+    printf("test_iv_analysis: %s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
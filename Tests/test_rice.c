@@ -0,0 +1,128 @@
+/*
+ * test_rice.c
+ *
+ *  Round trip of the CCSDS 121.0 Rice coder over signals that exercise every coding option,
+ *  block boundary and the predictor mapping at both ends of the sample range.
+ */
+
+#include "rice_compression.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_N       1000
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static int failures = 0;
+
+typedef uint16_t (*signal_fn)(size_t i);
+
+static uint16_t constant(size_t i)      { return 0x1234; }
+static uint16_t ramp(size_t i)          { return (uint16_t) (i * 3); }
+static uint16_t small_noise(size_t i)   { return 2048 + (rand() % 3) - 1; }
+static uint16_t medium_noise(size_t i)  { return 30000 + (rand() % 200) - 100; }
+static uint16_t full_noise(size_t i)    { return (uint16_t) rand(); }
+static uint16_t extremes(size_t i)      { return (i & 1) ? 0xFFFF : 0x0000; }
+static uint16_t near_top(size_t i)      { return 0xFFFF - (rand() % 4); }
+static uint16_t near_bottom(size_t i)   { return rand() % 4; }
+static uint16_t triangle(size_t i)     { return 32768 + (int16_t) ((i % 64) < 32 ? (i % 32) * 900 : (32 - (i % 32)) * 900); }
+
+static const struct {
+    const char* name;
+    signal_fn   fn;
+} signals[] = {
+    { "constant",     constant },
+    { "ramp",         ramp },
+    { "small noise",  small_noise },
+    { "medium noise", medium_noise },
+    { "full noise",   full_noise },
+    { "extremes",     extremes },
+    { "near top",     near_top },
+    { "near bottom",  near_bottom },
+    { "triangle",     triangle },
+};
+
+// Lengths around the first block (reference + 15) and the following 16-sample blocks
+static const size_t lengths[] = { 1, 2, 3, 14, 15, 16, 17, 31, 32, 33, 47, 48, 255, 256, MAX_N };
+
+
+// Encodes N samples with the given stride and decodes them back into a zeroed buffer.
+static void round_trip(const char* name, const uint16_t* raw, size_t N, size_t stride) {
+    static uint8_t  compressed[MAX_N * 2 * 2 + 64];
+    static uint16_t decoded[MAX_N * 2];
+    size_t out_max = N * stride * 2 + 64;
+
+    memset(decoded, 0, sizeof(decoded));
+    size_t len = rice_encode(raw, N, stride, compressed, out_max);
+    CHECK(len > 0);
+    if (len == 0) {
+        printf("  %s N=%zu stride=%zu: encoding failed\n", name, N, stride);
+        return;
+    }
+
+    size_t used = rice_decode(compressed, len, decoded, N, stride);
+    CHECK(used == len);
+    for (size_t i = 0; i < N; i++) {
+        if (decoded[i * stride] != raw[i * stride]) {
+            printf("FAIL %s N=%zu stride=%zu: sample %zu is %u, expected %u\n", name, N, stride, i,
+                   decoded[i * stride], raw[i * stride]);
+            failures++;
+            return;
+        }
+    }
+}
+
+
+int main() {
+    static uint16_t raw[MAX_N * 2];
+    static uint8_t  compressed[MAX_N * 2 + 64];
+    srand(121);
+
+    for (size_t s = 0; s < sizeof(signals) / sizeof(signals[0]); s++) {
+        for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+            size_t N = lengths[l];
+            for (size_t i = 0; i < N; i++) {
+                raw[i] = signals[s].fn(i);
+            }
+            round_trip(signals[s].name, raw, N, 1);
+
+            // Interleaved channels as in the CB packets, each compressed on its own
+            for (size_t i = 0; i < N; i++) {
+                raw[2 * i] = signals[s].fn(i);
+                raw[2 * i + 1] = ~signals[s].fn(i);
+            }
+            round_trip(signals[s].name, raw, N, 2);
+            round_trip(signals[s].name, raw + 1, N, 2);
+        }
+    }
+
+    // Packet layout: probe 0 stream followed by the probe 1 stream, decoded back interleaved
+    for (size_t i = 0; i < 58; i++) {
+        raw[2 * i] = medium_noise(i);
+        raw[2 * i + 1] = small_noise(i);
+    }
+    size_t len0 = rice_encode(raw, 58, 2, compressed, sizeof(compressed));
+    size_t len1 = rice_encode(raw + 1, 58, 2, compressed + len0, sizeof(compressed) - len0);
+    uint16_t decoded[2 * 58];
+    CHECK(rice_decode_channels(compressed, len0 + len1, decoded, 58, 2) == len0 + len1);
+    CHECK(memcmp(decoded, raw, sizeof(decoded)) == 0);
+    CHECK(rice_decode_channels(compressed, len0, decoded, 58, 2) == 0);
+
+    // Compressible data must actually shrink, noise may not grow by more than the block IDs
+    for (size_t i = 0; i < MAX_N; i++) {
+        raw[i] = small_noise(i);
+    }
+    CHECK(rice_encode(raw, MAX_N, 1, compressed, sizeof(compressed)) < MAX_N * 2 / 4);
+    for (size_t i = 0; i < MAX_N; i++) {
+        raw[i] = full_noise(i);
+    }
+    CHECK(rice_encode(raw, MAX_N, 1, compressed, sizeof(compressed)) <= MAX_N * 2 + (MAX_N / 16 + 1) + 2);
+
+    // Output that does not fit is reported, truncated input is rejected
+    CHECK(rice_encode(raw, MAX_N, 1, compressed, 100) == 0);
+    size_t len = rice_encode(raw, 64, 1, compressed, sizeof(compressed));
+    CHECK(rice_decode(compressed, len / 2, raw + MAX_N, 64, 1) == 0);
+
+    printf("test_rice: %s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * test_sd_recovery.c
+ *
+ *  Runs the FPGA SD writer against a RAM disk whose card drops out and comes back, and checks
+ *  that the writer returns to RUNNING, drains its queue and leaves a recoverable data file.
+ */
+
+#include "FPGA_Data_Saving.h"
+#include "FPGA_UART.h"
+#include "data_block.h"
+#include "scientific_data.h"
+#include "storage_manager.h"
+#include "host_disk.h"
+#include <stdlib.h>
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+extern uint32_t host_ticks;
+
+uint8_t console_enabled = 0;
+static int backpressure_messages = 0;
+static int failures = 0;
+
+// FPGA stream of CB frames cut into staging buffers, and the first full frame of every buffer
+static uint32_t stream_pos = 0;
+static uint32_t first_sample_seq[64];
+static uint32_t buffers_produced = 0;
+
+
+HAL_StatusTypeDef FPGA_Transmit_Binary(uint8_t* tx_data, size_t length) {
+    backpressure_messages++;
+    return HAL_OK;
+}
+
+
+// Stream byte at pos, frames of preamble, sequence number and two probe values. The sequence
+// numbers start where their high byte equals the preamble, to exercise the frame detection.
+static uint8_t stream_byte(uint32_t pos) {
+    uint16_t seq = 0x8300 + pos / SC_CB_FRAME_LEN;
+    uint8_t frame[SC_CB_FRAME_LEN] = { SCIENTIFIC_DATA_PREAMBLE, seq & 0xFF, seq >> 8, 0x83, 0x84, 0x83, 0x83 };
+    return frame[pos % SC_CB_FRAME_LEN];
+}
+
+
+// Fills n staging buffers as the FPGA DMA would
+static void produce(int n) {
+    for (int i = 0; i < n; i++) {
+        uint8_t* buffer = SD_buffer(SD_buffer_selection);
+        uint32_t first_frame = (stream_pos + SC_CB_FRAME_LEN - 1) / SC_CB_FRAME_LEN;
+        first_sample_seq[buffers_produced++] = (uint16_t) (0x8300 + first_frame);
+        for (uint32_t b = 0; b < SD_BUFFER_SIZE; b++) {
+            buffer[b] = stream_byte(stream_pos++);
+        }
+        for (int t = 0; t < TRANSFERS_BEFORE_SWITCH; t++) {
+            FPGADMATransferCplt();
+        }
+        host_ticks += 5;
+    }
+}
+
+
+// Reads the header of an index file and counts its entries
+static uint8_t read_index(const char* path, DBLK_index_header_t* header, uint32_t* N_entries) {
+    FIL fp;
+    UINT read = 0;
+
+    if (f_open(&fp, path, FA_READ) != FR_OK) {
+        return 0;
+    }
+    f_read(&fp, header, sizeof(*header), &read);
+    *N_entries = (f_size(&fp) - sizeof(*header)) / sizeof(DBLK_index_entry_t);
+    f_close(&fp);
+    return read == sizeof(*header) && header->magic == DBLK_INDEX_MAGIC;
+}
+
+
+static void run(int n) {
+    for (int i = 0; i < n; i++) {
+        HandleFPGAStream();
+        host_ticks += 10;
+    }
+}
+
+
+int main() {
+    host_disk_format_and_mount();
+    FPGAFastCapture = 0;
+    CHECK(openFPGADataFile() == FR_OK);
+    FPGAFileOpen = 1;
+    CHECK(openUCDataFile() == FR_OK);
+    uCFileOpen = 1;
+
+    produce(3);
+    run(10);
+    CHECK(FPGAWriterState == SD_WRITER_RUNNING);
+    CHECK(writeQueueCount() == 0);
+    CHECK(FPGAWriteErrors == 0);
+
+    // Card gone, the writer keeps retrying and asks the FPGA to hold off
+    host_card_down = 1;
+    produce(SD_BUFFERS - 1);
+    run(200);
+    CHECK(FPGAWriterState != SD_WRITER_RUNNING);
+    CHECK(FPGAWriteErrors > 0);
+    CHECK(writeQueueCount() > 0);
+    CHECK(FPGABackpressure == 1 && backpressure_messages == 1);
+
+    // Card back, the stale FIL must not keep the file locked
+    host_card_down = 0;
+    run(200);
+    produce(2);
+    run(50);
+    CHECK(FPGAWriterState == SD_WRITER_RUNNING);
+    CHECK(writeQueueCount() == 0);
+    CHECK(FPGABackpressure == 0 && backpressure_messages == 2);
+
+    // Card back but the first write fails, closing the stale FIL fails and the volume is remounted
+    host_card_down = 1;
+    produce(1);
+    run(5);
+    host_card_down = 0;
+    host_failing_writes = 1;
+    run(200);
+    produce(2);
+    run(50);
+    CHECK(FPGAWriterState == SD_WRITER_RUNNING);
+    CHECK(writeQueueCount() == 0);
+    CHECK(uCFileOpen == 1);
+
+    // Once the sync interval has passed, the size on the card covers every block written
+    FILINFO info;
+    host_ticks += SD_SYNC_INTERVAL;
+    produce(1);
+    run(5);
+    CHECK(f_stat("/FFU1_CU_FPGA_0.bin", &info) == FR_OK);
+    CHECK(info.fsize == f_size(&FPGADataFile));
+
+    CHECK(closeFPGADataFile() == FR_OK);
+
+    DBLK_scan_t scan;
+    CHECK(DBLK_recover("/FFU1_CU_FPGA_0.bin", "/FFU1_CU_FPGA_0.idx", 1, &scan) == FR_OK);
+    // Every buffer is in the file except the one given up after repeated write errors
+    CHECK(scan.stop_reason == DBLK_SCAN_END);
+    CHECK(scan.first_sequence == 0);
+    CHECK(scan.blocks + scan.missing == 14);
+    CHECK(scan.missing == FPGALostBytes() / SD_BUFFER_SIZE);
+    CHECK(scan.valid_len == scan.file_len);
+
+    // Every block carries the sequence number of its first full frame, as does the index entry
+    FIL fp;
+    DBLK_header_t header;
+    UINT read;
+    uint8_t sector[DBLK_HEADER_LEN];
+    CHECK(f_open(&fp, "/FFU1_CU_FPGA_0.bin", FA_READ) == FR_OK);
+    for (uint32_t b = 0; b < scan.blocks; b++) {
+        CHECK(f_lseek(&fp, (FSIZE_t) b * SD_BLOCK_LEN) == FR_OK);
+        CHECK(f_read(&fp, sector, sizeof(sector), &read) == FR_OK && DBLK_check_header(sector, &header));
+        CHECK(header.sequence < buffers_produced && header.sample_seq == first_sample_seq[header.sequence]);
+    }
+    f_close(&fp);
+
+    DBLK_index_entry_t entry;
+    uint32_t N_entries;
+    CHECK(DBLK_index_find("/FFU1_CU_FPGA_0.idx", 0, &entry, &N_entries) == FR_OK);
+    CHECK(entry.sequence == 0 && entry.sample_seq == first_sample_seq[0]);
+
+    // Nothing that looks like a frame sequence, no sample sequence number
+    memset(sector, SCIENTIFIC_DATA_PREAMBLE, sizeof(sector));
+    CHECK(DBLK_first_sample_seq(sector, sizeof(sector)) == DBLK_NO_SAMPLE_SEQ);
+
+    // A rotation that cannot open the next file must leave the closed file and its index alone
+    // and continue in the next file once it can be created
+    DBLK_index_header_t index_header;
+    uint32_t recovered_blocks = scan.blocks;
+    CHECK(openFPGADataFile() == FR_OK);
+    produce(2);
+    host_ticks += SD_SYNC_INTERVAL;
+    run(5);
+    CHECK(FPGAWriterState == SD_WRITER_RUNNING);
+
+    STOR_config.max_size[STOR_SERIES_FPGA] = 2 * SD_BLOCK_LEN;
+    CHECK(f_mkdir("/FFU1_CU_FPGA_2.bin") == FR_OK); // The next data file cannot be opened
+    produce(1);
+    run(5);
+    CHECK(FPGAWriterState != SD_WRITER_RUNNING);
+    CHECK(f_unlink("/FFU1_CU_FPGA_2.bin") == FR_OK);
+    run(200);
+    CHECK(FPGAWriterState == SD_WRITER_RUNNING);
+    CHECK(writeQueueCount() == 0);
+    STOR_config.max_size[STOR_SERIES_FPGA] = 0;
+    CHECK(closeFPGADataFile() == FR_OK);
+
+    // The index is checked as written, a recovery scan would rebuild it
+    CHECK(read_index("/FFU1_CU_FPGA_1.idx", &index_header, &N_entries));
+    CHECK(index_header.file_ID == 1 && N_entries == 1);
+    CHECK(DBLK_index_find("/FFU1_CU_FPGA_1.idx", 0, &entry, &N_entries) == FR_OK);
+    CHECK(DBLK_recover("/FFU1_CU_FPGA_1.bin", NULL, 1, &scan) == FR_OK);
+    CHECK(scan.blocks == 2 && scan.file_ID == 1);
+    CHECK(entry.sequence == scan.first_sequence && entry.offset == 0);
+    CHECK(read_index("/FFU1_CU_FPGA_2.idx", &index_header, &N_entries));
+    CHECK(index_header.file_ID == 2 && N_entries == 1);
+    CHECK(DBLK_recover("/FFU1_CU_FPGA_2.bin", "/FFU1_CU_FPGA_2.idx", 1, &scan) == FR_OK);
+    CHECK(scan.stop_reason == DBLK_SCAN_END && scan.blocks == 1 && scan.file_ID == 2);
+
+    printf("test_sd_recovery: %s (%lu blocks recovered, %lu write errors)\n", failures ? "FAILED" : "OK",
+           (unsigned long) recovered_blocks, (unsigned long) FPGAWriteErrors);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * test_sweep_sigma.c
+ *
+ *  Averages sweeps with a small known spread around mid-scale and checks the standard
+ *  deviation of every step in the downlinked record against the exact value.
+ */
+
+#include "sweep_data.h"
+#include "FPGA_config_mirror.h"
+#include "IV_analysis.h"
+#include "uC_Data_Saving.h"
+#include <math.h>
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+#define N_STEPS     4
+#define N_SWEEPS    8
+
+static int failures = 0;
+static uint8_t record[SWT_RECORD_MAX_LEN];
+static uint16_t record_len = 0;
+
+SC_pipeline_stats_t SC_stats;
+FIL uCDataFile;
+uint8_t uCFileOpen = 0;
+
+
+// Sweep geometry from the mirror, no bias tables so no I-V analysis
+bool FPGA_mirror_lookup(uint8_t reg, FPGA_msg_arg_t* fpgama, uint16_t* value) {
+    switch (reg) {
+        case FPGA_REG_SWT_STEPS:            *value = N_STEPS; return true;
+        case FPGA_REG_SWT_SAMPLES_PER_STEP: *value = 1;       return true;
+        default:                            return false;
+    }
+}
+
+uint8_t FPGA_arg_width(uint8_t arg_ID)                                      { return 1; }
+uint64_t SC_frame_time_us()                                                 { return 0; }
+bool SC_compression_enabled(uint16_t APID)                                  { return false; }
+uint16_t SC_compress_samples(uint8_t* raw, uint16_t N, uint8_t* out)        { return 0; }
+FRESULT rotateUCDataFile(UINT len)                                          { return FR_OK; }
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw)              { return FR_OK; }
+FRESULT f_sync(FIL* fp)                                                     { return FR_OK; }
+void send_IV_parameters(uint16_t sweep_seq, uint8_t probe_ID, IV_result_t* result) {}
+uint8_t analyze_IV_curve(const uint16_t* bias, const uint16_t* current, uint16_t N, IV_result_t* result) { return 0; }
+
+SPP_header_t SPP_make_header(uint8_t packet_version_number, uint8_t packet_type, uint8_t secondary_header_flag,
+                             uint16_t application_process_id, uint8_t sequence_flags, uint16_t packet_sequence_count,
+                             uint16_t packet_data_length) {
+    SPP_header_t header = {0};
+    return header;
+}
+
+
+// Reassembles the record from its segments
+SPP_error SPP_send_TM(SPP_header_t* resp_SPP_header, PUS_TM_header_t* response_secondary_header, uint8_t* data, uint16_t data_len) {
+    uint16_t offset;
+    memcpy(&offset, data + 2, sizeof(offset));
+    memcpy(record + offset, data + SWT_SEGMENT_HEADER_LEN, data_len - SWT_SEGMENT_HEADER_LEN);
+    record_len = offset + data_len - SWT_SEGMENT_HEADER_LEN;
+    return SPP_OK;
+}
+
+
+// Probe 0 spreads by a few LSB around mid-scale, probe 1 by a step dependent amount near the top
+static uint16_t sample(uint8_t sweep, uint8_t step, uint8_t probe) {
+    static const int8_t spread[N_SWEEPS] = { -3, -1, 0, 1, 3, -2, 2, 0 };
+    return probe == 0 ? 32768 + spread[sweep] + step : 60000 + sweep * step;
+}
+
+
+int main() {
+    uint8_t args[] = { N_AVG_SWEEPS_ARG_ID, N_SWEEPS, SIGMA_ARG_ID, 1 };
+    CHECK(set_SWT_averaging(2, args) == SPP_OK);
+
+    for (uint8_t sweep = 0; sweep < N_SWEEPS; sweep++) {
+        for (uint8_t step = 0; step < N_STEPS; step++) {
+            uint16_t value[2] = { sample(sweep, step, 0), sample(sweep, step, 1) };
+            SWT_add_sample(sweep, step, value);
+        }
+    }
+
+    CHECK(record_len == SWT_RECORD_HEADER_LEN + 2 * N_STEPS * SC_CB_SAMPLE_LEN);
+    CHECK(record[SWT_RECORD_HEADER_LEN - (SWT_MAX_STEPS / 8) - 1] == (SC_FORMAT_RAW | SWT_FORMAT_SIGMA));
+
+    const uint8_t* sigma = record + SWT_RECORD_HEADER_LEN + N_STEPS * SC_CB_SAMPLE_LEN;
+    for (uint8_t step = 0; step < N_STEPS; step++) {
+        for (uint8_t probe = 0; probe < 2; probe++) {
+            double sum = 0, sum_sq = 0;
+            for (uint8_t sweep = 0; sweep < N_SWEEPS; sweep++) {
+                double x = sample(sweep, step, probe);
+                sum += x;
+                sum_sq += x * x;
+            }
+            double mean = sum / N_SWEEPS;
+            uint16_t expected = (uint16_t) lround(sqrt(sum_sq / N_SWEEPS - mean * mean));
+            uint16_t value;
+            memcpy(&value, sigma + (step * 2 + probe) * sizeof(value), sizeof(value));
+            if (value != expected) {
+                printf("FAIL step %u probe %u: sigma %u, expected %u\n", step, probe, value, expected);
+                failures++;
+            }
+        }
+    }
+
+    printf("test_sweep_sigma: %s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}